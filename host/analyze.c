@@ -0,0 +1,681 @@
+/**
+ * analyze.c
+ *
+ * Post-mortem analysis of a capture file (see capfile.h). The chunks are
+ * shared out across a pool of threads, each taking the next chunk not yet
+ * claimed and folding it into results of its own, so the threads never
+ * wait on each other and a recording much larger than memory is only ever
+ * streamed through the page cache. The results are merged at the end:
+ *
+ *   statistics   min, max, mean, RMS and standard deviation per channel
+ *   histogram    a count of every 12 bit code per channel
+ *   frequency    from rising crossings of the middle of each chunk's range,
+ *                taken from the index, with hysteresis against noise
+ *   spectrum     averaged Hann windowed FFTs of segments within chunks
+ *
+ * Crossings and FFT segments are only ever looked for within a chunk, so a
+ * gap never joins two stretches of signal that weren't continuous, and the
+ * results don't depend on how the chunks were shared out, beyond rounding
+ * in the order sums of doubles are merged.
+ *
+ * A stretch of the recording can also be exported, as CSV, VCD or WAV,
+ * picked by the file's extension.
+ */
+#define _GNU_SOURCE
+#include "capfile.h"
+#include "defs.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CODES 4096
+// hysteresis either side of the middle, as a fraction of the chunk's range
+#define HYSTERESIS 0.1
+// bins at the bottom of the spectrum left out of the search for its peak
+#define DC_BINS 3
+#define THREADS_MAX 64
+
+typedef struct {
+    usize threads;
+    // FFT size, 0 for no spectrum
+    usize fft;
+    const char *histogram;
+    const char *spectrum;
+    const char *export;
+    double from;
+    double duration;
+    const char *path;
+} Options;
+
+typedef struct {
+    u64 count;
+    u16 min;
+    u16 max;
+    // exact, good for 10^12 samples of 12 bits
+    u64 sum;
+    u64 sum_sq;
+    u64 histogram[CODES];
+    // full cycles between the first and last rising crossings of each
+    // chunk, and the samples they took
+    u64 cycles;
+    double cycle_samples;
+    // summed power of each bin over all segments
+    double *power;
+    u64 segments;
+} ChannelResult;
+
+typedef struct {
+    ChannelResult channels[CAPFILE_CHANNELS_MAX];
+    // FFT scratch
+    double *re;
+    double *im;
+} Result;
+
+typedef struct {
+    const CapFile *file;
+    usize fft;
+    // shared by all threads, the next chunk to claim
+    usize next;
+    // FFT tables, shared read only
+    double *window;
+    double *cos_table;
+    double *sin_table;
+    usize *reverse;
+    double window_sum;
+} Job;
+
+static CapFile CAPTURE;
+static Job JOB;
+static Result RESULTS[THREADS_MAX];
+
+static RC parse_options(int argc, char **argv, Options *opts);
+static void usage(const char *prog);
+static RC fft_init(Job *job, usize n);
+static void *worker(void *arg);
+static void analyze_chunk(const Job *job, usize i, Result *result);
+static void count_cycles(const u16 *samples, usize count, usize stride,
+                         u16 min, u16 max, ChannelResult *out);
+static void accumulate_spectrum(const Job *job, const u16 *samples,
+                                usize count, usize stride, Result *result,
+                                ChannelResult *out);
+static void fft(const Job *job, double *re, double *im);
+static void merge(Result *into, const Result *from, usize channels,
+                  usize bins);
+static void report(const Options *opts, const Result *result, double elapsed);
+static double peak_frequency(const ChannelResult *ch, usize fft, u32 rate);
+static double amplitude(const ChannelResult *ch, usize bin);
+static double volts(usize channel, double sample);
+static int write_histogram(const char *path, const Result *result);
+static int write_spectrum(const char *path, const Result *result, usize fft);
+static int export_range(const Options *opts);
+static const char *extension(const char *path);
+static void put_u16(u8 *out, u16 value);
+static void put_u32(u8 *out, u32 value);
+static double seconds(const struct timespec *start);
+
+int main(int argc, char **argv) {
+    Options opts;
+    if (parse_options(argc, argv, &opts) != RC_OK) {
+        usage(argv[0]);
+        return 1;
+    }
+    RC rc = capfile_open(&CAPTURE, opts.path);
+    if (rc != RC_OK) {
+        fprintf(stderr, "%s: %s\n", opts.path, rcstr(rc));
+        return 1;
+    }
+    if (CAPTURE.recovered) {
+        fprintf(stderr, "%s: no index, rebuilt it from %zu chunks\n",
+                opts.path, CAPTURE.nchunks);
+    }
+    usize channels = CAPTURE.header->channels;
+    usize bins = opts.fft / 2 + 1;
+    JOB.file = &CAPTURE;
+    if (opts.fft > 0 && fft_init(&JOB, opts.fft) != RC_OK) {
+        fprintf(stderr, "can't set up a %zu point FFT\n", opts.fft);
+        return 1;
+    }
+    for (usize t = 0; t < opts.threads; ++t) {
+        for (usize c = 0; c < channels; ++c) {
+            RESULTS[t].channels[c].min = 0xFFFF;
+            if (opts.fft > 0) {
+                RESULTS[t].channels[c].power = calloc(bins, sizeof(double));
+            }
+        }
+        if (opts.fft > 0) {
+            RESULTS[t].re = malloc(opts.fft * sizeof(double));
+            RESULTS[t].im = malloc(opts.fft * sizeof(double));
+        }
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_t threads[THREADS_MAX];
+    for (usize t = 0; t < opts.threads; ++t) {
+        if (pthread_create(&threads[t], NULL, worker, &RESULTS[t])) {
+            fprintf(stderr, "can't start thread %zu\n", t);
+            return 1;
+        }
+    }
+    for (usize t = 0; t < opts.threads; ++t) {
+        pthread_join(threads[t], NULL);
+    }
+    for (usize t = 1; t < opts.threads; ++t) {
+        merge(&RESULTS[0], &RESULTS[t], channels, opts.fft ? bins : 0);
+    }
+    double elapsed = seconds(&start);
+
+    report(&opts, &RESULTS[0], elapsed);
+    int failed = 0;
+    if (opts.histogram != NULL) {
+        failed |= write_histogram(opts.histogram, &RESULTS[0]);
+    }
+    if (opts.spectrum != NULL) {
+        failed |= write_spectrum(opts.spectrum, &RESULTS[0], opts.fft);
+    }
+    if (opts.export != NULL) {
+        failed |= export_range(&opts);
+    }
+    capfile_close(&CAPTURE);
+    return failed;
+}
+
+RC parse_options(int argc, char **argv, Options *opts) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    *opts = (Options){
+        .threads = cores > 0 ? cores : 1,
+        .duration = INFINITY,
+    };
+    int opt;
+    while ((opt = getopt(argc, argv, "j:f:H:S:e:t:d:")) != -1) {
+        switch (opt) {
+        case 'j':
+            opts->threads = strtoul(optarg, NULL, 10);
+            break;
+        case 'f':
+            opts->fft = strtoul(optarg, NULL, 10);
+            break;
+        case 'H':
+            opts->histogram = optarg;
+            break;
+        case 'S':
+            opts->spectrum = optarg;
+            break;
+        case 'e':
+            opts->export = optarg;
+            break;
+        case 't':
+            opts->from = strtod(optarg, NULL);
+            break;
+        case 'd':
+            opts->duration = strtod(optarg, NULL);
+            break;
+        default:
+            return RC_INVALID_OPT;
+        }
+    }
+    if (opts->spectrum != NULL && opts->fft == 0) {
+        opts->fft = 4096;
+    }
+    if (optind != argc - 1 || opts->threads == 0 ||
+        opts->threads > THREADS_MAX || (opts->fft & (opts->fft - 1)) != 0 ||
+        opts->fft == 1 || opts->from < 0 || opts->duration <= 0) {
+        return RC_INVALID_OPT;
+    }
+    if (opts->export != NULL && strcmp(extension(opts->export), "csv") &&
+        strcmp(extension(opts->export), "vcd") &&
+        strcmp(extension(opts->export), "wav")) {
+        return RC_INVALID_OPT;
+    }
+    opts->path = argv[optind];
+    return RC_OK;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-j threads] [-f fft] [-H file] [-S file]\n"
+            "          [-e file] [-t from] [-d duration] capture\n"
+            "  -j  threads, default one per core\n"
+            "  -f  spectrum from FFTs of this many points, a power of two\n"
+            "  -H  write the histogram of codes as CSV\n"
+            "  -S  write the spectrum as CSV, by default from 4096 points\n"
+            "  -e  export samples to a .csv, .vcd or .wav file\n"
+            "  -t  start the export this many seconds in\n"
+            "  -d  export this many seconds\n",
+            prog);
+}
+
+RC fft_init(Job *job, usize n) {
+    job->fft = n;
+    job->window = malloc(n * sizeof(double));
+    job->cos_table = malloc(n / 2 * sizeof(double));
+    job->sin_table = malloc(n / 2 * sizeof(double));
+    job->reverse = malloc(n * sizeof(usize));
+    if (job->window == NULL || job->cos_table == NULL ||
+        job->sin_table == NULL || job->reverse == NULL) {
+        return RC_BUF_LENGTH;
+    }
+    usize bits = 0;
+    while ((1ul << bits) < n) {
+        ++bits;
+    }
+    job->window_sum = 0;
+    for (usize i = 0; i < n; ++i) {
+        job->window[i] = 0.5 - 0.5 * cos(2 * M_PI * i / n);
+        job->window_sum += job->window[i];
+        usize r = 0;
+        for (usize b = 0; b < bits; ++b) {
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        job->reverse[i] = r;
+    }
+    for (usize i = 0; i < n / 2; ++i) {
+        job->cos_table[i] = cos(2 * M_PI * i / n);
+        job->sin_table[i] = -sin(2 * M_PI * i / n);
+    }
+    return RC_OK;
+}
+
+void *worker(void *arg) {
+    Result *result = arg;
+    for (;;) {
+        usize i = __atomic_fetch_add(&JOB.next, 1, __ATOMIC_RELAXED);
+        if (i >= JOB.file->nchunks) {
+            break;
+        }
+        analyze_chunk(&JOB, i, result);
+    }
+    return NULL;
+}
+
+void analyze_chunk(const Job *job, usize i, Result *result) {
+    const CapIndexEntry *entry = &job->file->index[i];
+    const u16 *samples = capfile_samples(job->file, i);
+    usize channels = job->file->header->channels;
+    for (usize c = 0; c < channels; ++c) {
+        ChannelResult *ch = &result->channels[c];
+        const u16 *s = samples + c;
+        // the sums for a chunk fit in integers, so are exact
+        u64 sum = 0, sum_sq = 0;
+        for (usize j = 0; j < entry->count; ++j, s += channels) {
+            u16 v = *s;
+            sum += v;
+            sum_sq += (u32)v * v;
+            ++ch->histogram[v < CODES ? v : CODES - 1];
+        }
+        ch->count += entry->count;
+        ch->sum += sum;
+        ch->sum_sq += sum_sq;
+        // the chunk's range is in the index already
+        ch->min = entry->min[c] < ch->min ? entry->min[c] : ch->min;
+        ch->max = entry->max[c] > ch->max ? entry->max[c] : ch->max;
+        count_cycles(samples + c, entry->count, channels, entry->min[c],
+                     entry->max[c], ch);
+        if (job->fft > 0) {
+            accumulate_spectrum(job, samples + c, entry->count, channels,
+                                result, ch);
+        }
+    }
+}
+
+void count_cycles(const u16 *samples, usize count, usize stride, u16 min,
+                  u16 max, ChannelResult *out) {
+    double mid = (min + max) / 2.0;
+    double low = mid - HYSTERESIS * (max - min);
+    // armed once below the low threshold, a crossing of the middle from
+    // there is rising
+    _Bool armed = 0;
+    usize crossings = 0;
+    double first = 0, last = 0, prev = samples[0];
+    for (usize j = 0; j < count; ++j, samples += stride) {
+        double v = *samples;
+        if (v < low) {
+            armed = 1;
+        } else if (armed && v >= mid) {
+            // where between the two samples it crossed
+            double at = j - (v - mid) / (v - prev);
+            first = crossings == 0 ? at : first;
+            last = at;
+            ++crossings;
+            armed = 0;
+        }
+        prev = v;
+    }
+    if (crossings >= 2) {
+        out->cycles += crossings - 1;
+        out->cycle_samples += last - first;
+    }
+}
+
+void accumulate_spectrum(const Job *job, const u16 *samples, usize count,
+                         usize stride, Result *result, ChannelResult *out) {
+    usize n = job->fft;
+    double *re = result->re, *im = result->im;
+    // two segments at a time, one real and one imaginary, which one FFT
+    // transforms together and symmetry then separates
+    for (usize at = 0; at + n <= count; at += 2 * n) {
+        const u16 *a = samples + at * stride;
+        const u16 *b = a + n * stride;
+        _Bool pair = at + 2 * n <= count;
+        for (usize j = 0; j < n; ++j) {
+            re[job->reverse[j]] = job->window[j] * a[j * stride];
+            im[job->reverse[j]] = pair ? job->window[j] * b[j * stride] : 0;
+        }
+        fft(job, re, im);
+        for (usize k = 0; k <= n / 2; ++k) {
+            usize m = (n - k) & (n - 1);
+            double ar = re[k] + re[m], ai = im[k] - im[m];
+            double br = im[k] + im[m], bi = re[m] - re[k];
+            // both halved, so a quarter of the power
+            out->power[k] += 0.25 * (ar * ar + ai * ai + br * br + bi * bi);
+        }
+        out->segments += 1 + pair;
+    }
+}
+
+void fft(const Job *job, double *re, double *im) {
+    // in place radix 2, the input already in bit reversed order
+    usize n = job->fft;
+    for (usize len = 2; len <= n; len <<= 1) {
+        usize step = n / len;
+        for (usize i = 0; i < n; i += len) {
+            for (usize j = 0; j < len / 2; ++j) {
+                double wr = job->cos_table[j * step];
+                double wi = job->sin_table[j * step];
+                usize a = i + j, b = i + j + len / 2;
+                double tr = re[b] * wr - im[b] * wi;
+                double ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+void merge(Result *into, const Result *from, usize channels, usize bins) {
+    for (usize c = 0; c < channels; ++c) {
+        ChannelResult *a = &into->channels[c];
+        const ChannelResult *b = &from->channels[c];
+        a->count += b->count;
+        a->min = b->min < a->min ? b->min : a->min;
+        a->max = b->max > a->max ? b->max : a->max;
+        a->sum += b->sum;
+        a->sum_sq += b->sum_sq;
+        for (usize i = 0; i < CODES; ++i) {
+            a->histogram[i] += b->histogram[i];
+        }
+        a->cycles += b->cycles;
+        a->cycle_samples += b->cycle_samples;
+        for (usize k = 0; k < bins; ++k) {
+            a->power[k] += b->power[k];
+        }
+        a->segments += b->segments;
+    }
+}
+
+void report(const Options *opts, const Result *result, double elapsed) {
+    const CapHeader *header = CAPTURE.header;
+    u64 bytes = CAPTURE.samples * header->channels * sizeof(u16);
+    u64 span = 0;
+    if (CAPTURE.nchunks > 0) {
+        const CapIndexEntry *last = &CAPTURE.index[CAPTURE.nchunks - 1];
+        span = last->start + last->count - CAPTURE.index[0].start;
+    }
+    printf("%llu samples per channel in %zu chunks, %.3f s at %u Hz "
+           "(%.3f s recorded)\n",
+           (unsigned long long)CAPTURE.samples, CAPTURE.nchunks,
+           (double)span / header->sample_rate, header->sample_rate,
+           (double)CAPTURE.samples / header->sample_rate);
+    for (usize c = 0; c < header->channels; ++c) {
+        const ChannelResult *ch = &result->channels[c];
+        if (ch->count == 0) {
+            continue;
+        }
+        double mean = (double)ch->sum / ch->count;
+        double mean_sq = (double)ch->sum_sq / ch->count;
+        double variance = mean_sq - mean * mean;
+        double scale = header->scale[c];
+        printf("ch%zu: min %.4f V, max %.4f V, mean %.4f V, "
+               "rms %.4f V, std %.4f V",
+               c, volts(c, ch->min), volts(c, ch->max), volts(c, mean),
+               // RMS of the calibrated voltage, offset included
+               sqrt(mean_sq * scale * scale +
+                    2 * header->offset[c] * scale * mean +
+                    header->offset[c] * header->offset[c]),
+               sqrt(variance > 0 ? variance : 0) * fabs(scale));
+        if (ch->cycles > 0) {
+            printf(", freq %.3f Hz",
+                   header->sample_rate * ch->cycles / ch->cycle_samples);
+        }
+        if (ch->segments > 0) {
+            printf(", peak %.3f Hz",
+                   peak_frequency(ch, opts->fft, header->sample_rate));
+        }
+        printf("\n");
+    }
+    printf("%zu threads, %.3f s, %.0f MB/s\n", opts->threads, elapsed,
+           bytes / elapsed / 1e6);
+}
+
+double peak_frequency(const ChannelResult *ch, usize fft, u32 rate) {
+    usize peak = DC_BINS;
+    for (usize k = DC_BINS; k <= fft / 2; ++k) {
+        peak = ch->power[k] > ch->power[peak] ? k : peak;
+    }
+    // between bins from the parabola through the peak and its neighbours
+    double offset = 0;
+    if (peak < fft / 2) {
+        double a = log(ch->power[peak - 1] + 1e-30);
+        double b = log(ch->power[peak] + 1e-30);
+        double c = log(ch->power[peak + 1] + 1e-30);
+        offset = a - 2 * b + c < 0 ? 0.5 * (a - c) / (a - 2 * b + c) : 0;
+    }
+    return (peak + offset) * rate / fft;
+}
+
+double amplitude(const ChannelResult *ch, usize bin) {
+    // peak volts of a sine in the bin, from the mean power over segments,
+    // the bins at 0 and half the rate having no negative twin
+    double twins = bin == 0 || bin == JOB.fft / 2 ? 1 : 2;
+    return twins * sqrt(ch->power[bin] / ch->segments) / JOB.window_sum;
+}
+
+double volts(usize channel, double sample) {
+    return CAPTURE.header->offset[channel] +
+           CAPTURE.header->scale[channel] * sample;
+}
+
+int write_histogram(const char *path, const Result *result) {
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        perror(path);
+        return 1;
+    }
+    usize channels = CAPTURE.header->channels;
+    fprintf(out, "code");
+    for (usize c = 0; c < channels; ++c) {
+        fprintf(out, ",ch%zu", c);
+    }
+    fprintf(out, "\n");
+    for (usize i = 0; i < CODES; ++i) {
+        fprintf(out, "%zu", i);
+        for (usize c = 0; c < channels; ++c) {
+            fprintf(out, ",%llu",
+                    (unsigned long long)result->channels[c].histogram[i]);
+        }
+        fprintf(out, "\n");
+    }
+    if (fclose(out)) {
+        perror(path);
+        return 1;
+    }
+    return 0;
+}
+
+int write_spectrum(const char *path, const Result *result, usize fft) {
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        perror(path);
+        return 1;
+    }
+    usize channels = CAPTURE.header->channels;
+    fprintf(out, "hz");
+    for (usize c = 0; c < channels; ++c) {
+        fprintf(out, ",ch%zu_dbv", c);
+    }
+    fprintf(out, "\n");
+    for (usize k = 0; k <= fft / 2; ++k) {
+        fprintf(out, "%.3f", (double)k * CAPTURE.header->sample_rate / fft);
+        for (usize c = 0; c < channels; ++c) {
+            const ChannelResult *ch = &result->channels[c];
+            double a = ch->segments > 0 ? amplitude(ch, k) : 0;
+            fprintf(out, ",%.2f",
+                    20 * log10(a * fabs(CAPTURE.header->scale[c]) + 1e-12));
+        }
+        fprintf(out, "\n");
+    }
+    if (fclose(out)) {
+        perror(path);
+        return 1;
+    }
+    return 0;
+}
+
+int export_range(const Options *opts) {
+    const CapHeader *header = CAPTURE.header;
+    usize channels = header->channels;
+    double rate = header->sample_rate;
+    u64 from = opts->from * rate;
+    u64 to = isinf(opts->duration) ? UINT64_MAX
+                                   : from + (u64)(opts->duration * rate);
+    usize chunk, at;
+    if (capfile_seek(&CAPTURE, from, &chunk, &at) != RC_OK) {
+        fprintf(stderr, "nothing recorded after %.6f s\n", opts->from);
+        return 1;
+    }
+    const char *format = extension(opts->export);
+    FILE *out = fopen(opts->export, "wb");
+    if (out == NULL) {
+        perror(opts->export);
+        return 1;
+    }
+
+    // a 44 byte header, its sizes filled in once the data is written
+    u8 wav[44] = {0};
+    if (!strcmp(format, "csv")) {
+        fprintf(out, "time");
+        for (usize c = 0; c < channels; ++c) {
+            fprintf(out, ",ch%zu", c);
+        }
+        fprintf(out, "\n");
+    } else if (!strcmp(format, "vcd")) {
+        fprintf(out, "$timescale 1 ns $end\n$scope module scope $end\n");
+        for (usize c = 0; c < channels; ++c) {
+            fprintf(out, "$var real 64 %c ch%zu $end\n", (int)('!' + c), c);
+        }
+        fprintf(out, "$upscope $end\n$enddefinitions $end\n");
+    } else {
+        fwrite(wav, 1, sizeof(wav), out);
+    }
+
+    u64 exported = 0, next = CAPTURE.index[chunk].start + at;
+    u16 last[CAPFILE_CHANNELS_MAX];
+    for (; chunk < CAPTURE.nchunks && CAPTURE.index[chunk].start < to;
+         ++chunk, at = 0) {
+        const CapIndexEntry *entry = &CAPTURE.index[chunk];
+        const u16 *samples = capfile_samples(&CAPTURE, chunk);
+        for (usize j = at; j < entry->count && entry->start + j < to; ++j) {
+            const u16 *s = samples + j * channels;
+            u64 t = entry->start + j;
+            if (!strcmp(format, "csv")) {
+                fprintf(out, "%.9f", t / rate);
+                for (usize c = 0; c < channels; ++c) {
+                    fprintf(out, ",%.4f", volts(c, s[c]));
+                }
+                fprintf(out, "\n");
+            } else if (!strcmp(format, "vcd")) {
+                // only the channels that changed, the first time all
+                _Bool stamped = 0;
+                for (usize c = 0; c < channels; ++c) {
+                    if (exported > 0 && s[c] == last[c]) {
+                        continue;
+                    }
+                    if (!stamped) {
+                        fprintf(out, "#%llu\n",
+                                (unsigned long long)(t * 1000000000ull /
+                                                     header->sample_rate));
+                        stamped = 1;
+                    }
+                    fprintf(out, "r%.4f %c\n", volts(c, s[c]),
+                            (int)('!' + c));
+                    last[c] = s[c];
+                }
+            } else {
+                // WAV has no gaps, so they're filled with silence at
+                // mid scale
+                u8 frame[2 * CAPFILE_CHANNELS_MAX] = {0};
+                for (; next < t; ++next) {
+                    fwrite(frame, 2, channels, out);
+                }
+                for (usize c = 0; c < channels; ++c) {
+                    put_u16(frame + 2 * c, (i16)((s[c] - 2048) * 16));
+                }
+                fwrite(frame, 2, channels, out);
+                next = t + 1;
+            }
+            ++exported;
+        }
+    }
+
+    if (!strcmp(format, "wav")) {
+        u32 data = ftell(out) - sizeof(wav);
+        memcpy(wav, "RIFF", 4);
+        put_u32(wav + 4, 36 + data);
+        memcpy(wav + 8, "WAVEfmt ", 8);
+        put_u32(wav + 16, 16);
+        put_u16(wav + 20, 1);
+        put_u16(wav + 22, channels);
+        put_u32(wav + 24, header->sample_rate);
+        put_u32(wav + 28, header->sample_rate * channels * 2);
+        put_u16(wav + 32, channels * 2);
+        put_u16(wav + 34, 16);
+        memcpy(wav + 36, "data", 4);
+        put_u32(wav + 40, data);
+        fseek(out, 0, SEEK_SET);
+        fwrite(wav, 1, sizeof(wav), out);
+    }
+    if (ferror(out) | fclose(out)) {
+        perror(opts->export);
+        return 1;
+    }
+    printf("exported %llu samples per channel to %s\n",
+           (unsigned long long)exported, opts->export);
+    return 0;
+}
+
+const char *extension(const char *path) {
+    const char *dot = strrchr(path, '.');
+    return dot != NULL ? dot + 1 : "";
+}
+
+void put_u16(u8 *out, u16 value) {
+    out[0] = value;
+    out[1] = value >> 8;
+}
+
+void put_u32(u8 *out, u32 value) {
+    put_u16(out, value);
+    put_u16(out + 2, value >> 16);
+}
+
+double seconds(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec - start->tv_sec + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
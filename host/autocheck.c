@@ -0,0 +1,344 @@
+/**
+ * autocheck.c
+ *
+ * Drives autoset on the host with synthetic signals. A fake capture callback
+ * stands in for the probe, snapping each request to the board's table of ADC
+ * rates as probe_set_rate does and sampling a sine, square or flat signal
+ * with random frequency, amplitude, offset, phase and noise. Each case then
+ * checks the result against the signal that was generated: the frequency
+ * estimate, that the chosen rate puts AUTOSET_PERIODS_MIN to
+ * AUTOSET_PERIODS_MAX periods across the screen, that the scale is the
+ * smallest 1-2-5 step the trace fits under, and that the trigger level sits
+ * at the signal's midpoint and fires on a fresh capture.
+ */
+#include "autoset.h"
+#include "defs.h"
+#include "trigger.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// the board's ADC clock and timings, as src/probe.c builds its rate table
+#define PCLK2 84000000u
+#define ADC_CONVERSION_CYCLES 12
+#define NRATES 16
+#define FULL_SCALE 3.3
+#define ADC_MAX 4095
+// samples autoset captures at each step, SZ / 2 on the board
+#define CAPTURE_SZ 512
+#define SCREEN_MIN 40
+#define SCREEN_MAX 320
+#define AMPLITUDE_MIN 0.1
+// half AUTOSET_NOISE_FLOOR in src/autoset.c, in volts. The hysteresis is at
+// least half the floor on anything taken for a signal, so noise under that
+// can't cross the level both ways and pass for a period
+#define NOISE_MAX (8 * FULL_SCALE / ADC_MAX)
+// frequency estimates further out than this fail
+#define FREQUENCY_TOLERANCE 0.02
+// room src/autoset.c leaves above the peak when it picks a scale, and the
+// crossings it needs to measure a frequency
+#define HEADROOM 1.05
+#define CROSSINGS_MIN 3
+#define PI 3.14159265358979323846
+
+typedef enum {
+    SHAPE_SINE,
+    SHAPE_SQUARE,
+    SHAPE_FLAT,
+    SHAPE_COUNT,
+} Shape;
+
+typedef struct {
+    usize cases;
+    // peak noise added to every sample, in volts
+    double noise;
+    u32 seed;
+} Options;
+
+typedef struct {
+    Shape shape;
+    double frequency;
+    double amplitude;
+    double offset;
+    double noise;
+} Signal;
+
+static const char *SHAPE_NAMES[] = {"sine", "square", "flat"};
+static const u32 PRESCALER_DIVIDERS[] = {4, 8};
+static const u32 SAMPLING_CYCLES[] = {3, 15, 28, 56, 84, 112, 144, 480};
+
+static u32 RNG_STATE;
+static u32 RATES[NRATES];
+static u16 BUF[CAPTURE_SZ];
+
+static RC parse_options(int argc, char **argv, Options *opts);
+static void usage(const char *prog);
+static u32 random_u32(void);
+static double uniform(void);
+static void rates_init(void);
+static RC capture(void *ctx, u32 rate, u16 *buf, usize sz, u32 *actual_rate);
+static u16 to_counts(double volts);
+static double step_below(double scale);
+static int check_case(const Options *opts, usize n, double *worst);
+
+int main(int argc, char **argv) {
+    Options opts;
+    if (parse_options(argc, argv, &opts) != RC_OK) {
+        usage(argv[0]);
+        return 1;
+    }
+    RNG_STATE = opts.seed;
+    rates_init();
+    usize failed = 0;
+    double worst = 0;
+    for (usize n = 0; n < opts.cases; ++n) {
+        failed += check_case(&opts, n, &worst);
+    }
+    printf("%zu of %zu cases passed, worst frequency error %.3f%%\n",
+           opts.cases - failed, opts.cases, 100 * worst);
+    return failed != 0;
+}
+
+RC parse_options(int argc, char **argv, Options *opts) {
+    *opts = (Options){
+        .cases = 1000,
+        .noise = 0.005,
+        .seed = 1,
+    };
+    int opt;
+    while ((opt = getopt(argc, argv, "n:e:x:")) != -1) {
+        switch (opt) {
+        case 'n':
+            opts->cases = strtoul(optarg, NULL, 10);
+            break;
+        case 'e':
+            opts->noise = strtod(optarg, NULL);
+            break;
+        case 'x':
+            opts->seed = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            return RC_INVALID_OPT;
+        }
+    }
+    if (optind != argc || opts->cases == 0 || opts->seed == 0 ||
+        opts->noise < 0 || opts->noise >= NOISE_MAX) {
+        return RC_INVALID_OPT;
+    }
+    return RC_OK;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-n cases] [-e noise] [-x seed]\n"
+            "  -n  signals to autoset and check, default 1000\n"
+            "  -e  peak noise on every sample in volts, default 0.005, under "
+            "%.4f\n",
+            prog, NOISE_MAX);
+}
+
+u32 random_u32(void) {
+    // xorshift32, so runs are repeatable whatever the C library
+    RNG_STATE ^= RNG_STATE << 13;
+    RNG_STATE ^= RNG_STATE >> 17;
+    RNG_STATE ^= RNG_STATE << 5;
+    return RNG_STATE;
+}
+
+double uniform(void) { return random_u32() / 4294967296.0; }
+
+void rates_init(void) {
+    usize n = 0;
+    for (usize p = 0; p < 2; ++p) {
+        for (usize t = 0; t < 8; ++t) {
+            u32 rate = PCLK2 / PRESCALER_DIVIDERS[p] /
+                       (SAMPLING_CYCLES[t] + ADC_CONVERSION_CYCLES);
+            // insertion sort, fastest first
+            usize i = n++;
+            while (i > 0 && RATES[i - 1] < rate) {
+                RATES[i] = RATES[i - 1];
+                --i;
+            }
+            RATES[i] = rate;
+        }
+    }
+}
+
+RC capture(void *ctx, u32 rate, u16 *buf, usize sz, u32 *actual_rate) {
+    Signal *sig = ctx;
+    // the closest rate in the table by ratio, as probe_set_rate picks it
+    usize best = 0;
+    for (usize i = 1; i < NRATES; ++i) {
+        double err = RATES[i] > rate ? (double)RATES[i] / rate
+                                     : (double)rate / RATES[i];
+        double best_err = RATES[best] > rate ? (double)RATES[best] / rate
+                                             : (double)rate / RATES[best];
+        best = err < best_err ? i : best;
+    }
+    *actual_rate = RATES[best];
+
+    // each capture starts somewhere new in the signal, as the board's would
+    double phase = uniform();
+    for (usize i = 0; i < sz; ++i) {
+        double t = phase + sig->frequency * i / *actual_rate;
+        double x = 0;
+        if (sig->shape == SHAPE_SINE) {
+            x = sin(2 * PI * t);
+        } else if (sig->shape == SHAPE_SQUARE) {
+            x = t - floor(t) < 0.5 ? 1 : -1;
+        }
+        double noise = sig->noise * (2 * uniform() - 1);
+        buf[i] = to_counts(sig->offset + sig->amplitude * x + noise);
+    }
+    return RC_OK;
+}
+
+u16 to_counts(double volts) {
+    double counts = volts * ADC_MAX / FULL_SCALE + 0.5;
+    return counts < 0 ? 0 : counts > ADC_MAX ? ADC_MAX : (u16)counts;
+}
+
+double step_below(double scale) {
+    // the 1-2-5 step under scale, or 0 when scale isn't one of them
+    static const double STEPS[] = {1.0, 2.0, 5.0};
+    double below = 0;
+    for (double decade = 0.01; decade <= FULL_SCALE; decade *= 10) {
+        for (usize i = 0; i < sizeof(STEPS) / sizeof(STEPS[0]); ++i) {
+            double step = STEPS[i] * decade;
+            if (fabs(step - scale) < 1e-9 * scale) {
+                return below;
+            }
+            if (step < FULL_SCALE) {
+                below = step;
+            }
+        }
+    }
+    // full scale itself comes after the last step under it
+    return fabs(scale - FULL_SCALE) < 1e-9 ? below : 0;
+}
+
+int check_case(const Options *opts, usize n, double *worst) {
+    usize screen = SCREEN_MIN + random_u32() % (SCREEN_MAX - SCREEN_MIN + 1);
+    // frequencies from where the slowest rate can't fit AUTOSET_PERIODS on
+    // screen up to where the fastest can't either, evenly in log
+    double lo = (double)RATES[NRATES - 1] * AUTOSET_PERIODS / screen / 2;
+    double hi = (double)RATES[0] * AUTOSET_PERIODS / screen * 2;
+    Signal sig = {
+        .shape = random_u32() % SHAPE_COUNT,
+        .frequency = lo * pow(hi / lo, uniform()),
+        .amplitude = AMPLITUDE_MIN +
+                     uniform() * (FULL_SCALE / 2 - AMPLITUDE_MIN -
+                                  opts->noise),
+        .noise = opts->noise,
+    };
+    double room = FULL_SCALE - 2 * (sig.amplitude + sig.noise);
+    sig.offset = sig.amplitude + sig.noise + uniform() * room;
+    if (sig.shape == SHAPE_FLAT) {
+        sig.frequency = 0;
+        sig.amplitude = 0;
+    }
+
+    AutosetConfig cfg = {
+        .rates = RATES,
+        .nrates = NRATES,
+        .screen_samples = screen,
+        .full_scale = FULL_SCALE,
+        .adc_max = ADC_MAX,
+        .buf = BUF,
+        .sz = CAPTURE_SZ,
+    };
+    AutosetResult res;
+    RC rc = autoset_run(&cfg, capture, &sig, &res);
+    char what[128];
+    snprintf(what, sizeof(what),
+             "case %zu: %s %.1fHz, %.3fV about %.3fV, %zu samples wide", n,
+             SHAPE_NAMES[sig.shape], sig.frequency, sig.amplitude,
+             sig.offset, screen);
+    if (rc != RC_OK) {
+        fprintf(stderr, "%s: %s\n", what, rcstr(rc));
+        return 1;
+    }
+
+    // the frequency and the rate chosen from it, or the slowest rate when
+    // there is none
+    double ideal = sig.frequency * screen / AUTOSET_PERIODS;
+    double periods = sig.frequency * screen / res.rate;
+    // a signal too slow for even the slowest capture to hold the crossings
+    // autoset needs, from any phase, can go unmeasured
+    _Bool too_slow = sig.frequency * CAPTURE_SZ / RATES[NRATES - 1] <
+                     CROSSINGS_MIN + 1;
+    if (sig.shape == SHAPE_FLAT ||
+        (too_slow && res.estimate.frequency == 0)) {
+        if (res.estimate.frequency != 0 || res.rate != RATES[NRATES - 1]) {
+            fprintf(stderr, "%s: found %.1fHz at %u samples/s\n", what,
+                    res.estimate.frequency, res.rate);
+            return 1;
+        }
+    } else {
+        double err =
+            fabs(res.estimate.frequency - sig.frequency) / sig.frequency;
+        *worst = err > *worst ? err : *worst;
+        // past either end of the table that end is as close as it gets
+        _Bool rate_ok = periods >= AUTOSET_PERIODS_MIN &&
+                        periods <= AUTOSET_PERIODS_MAX;
+        if (ideal > RATES[0]) {
+            rate_ok = res.rate == RATES[0];
+        } else if (ideal < RATES[NRATES - 1]) {
+            rate_ok = res.rate == RATES[NRATES - 1];
+        }
+        if (err > FREQUENCY_TOLERANCE || !rate_ok) {
+            fprintf(stderr,
+                    "%s: estimated %.1fHz, %u samples/s shows %.2f "
+                    "periods\n",
+                    what, res.estimate.frequency, res.rate, periods);
+            return 1;
+        }
+    }
+
+    // the smallest step the trace fits under, leaving for the noise either
+    // way and for how far below its peaks a sine sampled at the chosen rate
+    // can top out, half a sample either side of them
+    double missed = 0;
+    if (sig.shape == SHAPE_SINE) {
+        missed = sig.amplitude * (1 - cos(PI * sig.frequency / res.rate));
+    }
+    double peak_lo = sig.offset + sig.amplitude - missed - sig.noise;
+    double peak_hi =
+        sig.offset + sig.amplitude + sig.noise + FULL_SCALE / ADC_MAX;
+    double below = step_below(res.scale);
+    _Bool fits = res.scale >= FULL_SCALE || res.scale >= peak_lo;
+    _Bool smallest = below < HEADROOM * peak_hi;
+    // nothing is below the first step, 10mV
+    if ((below == 0 && res.scale != 0.01) || !fits || !smallest) {
+        fprintf(stderr, "%s: scale %gV, step below %gV\n", what, res.scale,
+                below);
+        return 1;
+    }
+
+    // the midpoint to within the noise and the peaks the samples missed, and
+    // a level that fires
+    double mid = sig.offset * ADC_MAX / FULL_SCALE;
+    double slack = (sig.noise + missed / 2) * ADC_MAX / FULL_SCALE + 2;
+    if (res.trigger.edge != TRIGGER_RISING ||
+        fabs(res.trigger.level - mid) > slack) {
+        fprintf(stderr, "%s: trigger level %u, midpoint %.0f\n", what,
+                res.trigger.level, mid);
+        return 1;
+    }
+    if (sig.shape != SHAPE_FLAT) {
+        u32 rate;
+        usize idx;
+        capture(&sig, res.rate, BUF, CAPTURE_SZ, &rate);
+        // a screen's worth plus a period, so an edge is always in reach
+        usize sz = screen + (usize)(rate / sig.frequency) + 2;
+        sz = sz < CAPTURE_SZ ? sz : CAPTURE_SZ;
+        if (trigger_find(&res.trigger, BUF, sz, &idx) != RC_OK) {
+            fprintf(stderr, "%s: level %u with hysteresis %u never fired\n",
+                    what, res.trigger.level, res.trigger.hysteresis);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,259 @@
+/**
+ * boardsim.c
+ *
+ * Stands in for the board in binary stream mode: encodes a synthetic sine
+ * with the firmware's frame encoder and writes it to a pseudo terminal at
+ * roughly the rate the UART would, so host tools can be run against
+ * `/dev/pts/N` without hardware. Frames can be skipped, as the board does
+ * when its serial ring is full, or have a byte corrupted, to exercise a
+ * reader's gap and CRC handling.
+ */
+#define _GNU_SOURCE
+#include "defs.h"
+#include "stream.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+// 8N1, so every byte takes ten bits on the line
+#define BITS_PER_BYTE 10
+
+typedef struct {
+    usize frames;
+    usize samples;
+    u32 rate;
+    // 0 writes as fast as the reader takes it
+    u32 baud;
+    // percentages of frames skipped and corrupted
+    double skip;
+    double corrupt;
+    u32 seed;
+    _Bool compress;
+    const char *out;
+} Options;
+
+static u16 SAMPLES[STREAM_SAMPLES_MAX];
+static u8 FRAME[STREAM_FRAME_MAX];
+static u32 RNG_STATE;
+
+static RC parse_options(int argc, char **argv, Options *opts);
+static void usage(const char *prog);
+static double uniform(void);
+static int open_pty(int *slave);
+static int write_all(int fd, const u8 *bytes, usize sz);
+static void pace(const struct timespec *start, u64 bytes, u32 baud);
+
+int main(int argc, char **argv) {
+    Options opts;
+    if (parse_options(argc, argv, &opts) != RC_OK) {
+        usage(argv[0]);
+        return 1;
+    }
+    RNG_STATE = opts.seed;
+
+    // the slave is held open too, so the master keeps working while no
+    // reader is attached and nothing written is lost before one is
+    int fd, slave = -1;
+    if (opts.out != NULL) {
+        fd = open(opts.out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            perror(opts.out);
+            return 1;
+        }
+    } else {
+        fd = open_pty(&slave);
+        if (fd < 0) {
+            perror("pty");
+            return 1;
+        }
+        fprintf(stderr, "streaming on %s\n", ptsname(fd));
+    }
+
+    StreamEncoder enc;
+    stream_init(&enc, 1, opts.rate);
+    if (opts.compress) {
+        stream_set_coding(&enc, STREAM_CODING_RICE);
+    }
+    usize sent = 0, skipped = 0, corrupted = 0;
+    u64 bytes = 0;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (usize frame = 0; frame < opts.frames; ++frame) {
+        // a 1kHz sine across most of the ADC range, continuous between
+        // frames whether or not they are sent
+        for (usize i = 0; i < opts.samples; ++i) {
+            double t = (double)(frame * opts.samples + i) / opts.rate;
+            SAMPLES[i] = 2048 + lround(1800 * sin(2 * M_PI * 1000 * t));
+        }
+        u32 timestamp = frame * opts.samples * 1000ull / opts.rate;
+        if (100 * uniform() < opts.skip) {
+            stream_skip(&enc);
+            ++skipped;
+            continue;
+        }
+        usize len;
+        stream_encode(&enc, SAMPLES, opts.samples, timestamp, FRAME,
+                      sizeof(FRAME), &len);
+        if (100 * uniform() < opts.corrupt) {
+            // past the sync and header so the frame is still found, and
+            // only its CRC can tell
+            usize at = STREAM_HEADER_SZ + uniform() * (len - STREAM_HEADER_SZ);
+            FRAME[at] ^= 1 << (usize)(8 * uniform());
+            ++corrupted;
+        }
+        if (write_all(fd, FRAME, len)) {
+            perror("write");
+            return 1;
+        }
+        ++sent;
+        bytes += len;
+        pace(&start, bytes, opts.baud);
+    }
+
+    if (slave >= 0) {
+        // closing the master hangs up on the reader, so let it catch up
+        int queued;
+        while (ioctl(slave, FIONREAD, &queued) == 0 && queued > 0) {
+            usleep(10000);
+        }
+        close(slave);
+    }
+    close(fd);
+    fprintf(stderr, "sent %zu frames (%llu bytes), skipped %zu, "
+                    "corrupted %zu\n",
+            sent, (unsigned long long)bytes, skipped, corrupted);
+    return 0;
+}
+
+RC parse_options(int argc, char **argv, Options *opts) {
+    *opts = (Options){
+        .frames = 1000,
+        .samples = 256,
+        .rate = 100000,
+        .baud = 2000000,
+        .seed = 1,
+    };
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:r:b:d:e:x:o:z")) != -1) {
+        switch (opt) {
+        case 'n':
+            opts->frames = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            opts->samples = strtoul(optarg, NULL, 10);
+            break;
+        case 'r':
+            opts->rate = strtoul(optarg, NULL, 10);
+            break;
+        case 'b':
+            opts->baud = strtoul(optarg, NULL, 10);
+            break;
+        case 'd':
+            opts->skip = strtod(optarg, NULL);
+            break;
+        case 'e':
+            opts->corrupt = strtod(optarg, NULL);
+            break;
+        case 'x':
+            opts->seed = strtoul(optarg, NULL, 10);
+            break;
+        case 'o':
+            opts->out = optarg;
+            break;
+        case 'z':
+            opts->compress = 1;
+            break;
+        default:
+            return RC_INVALID_OPT;
+        }
+    }
+    if (optind != argc || opts->samples == 0 ||
+        opts->samples > STREAM_SAMPLES_MAX || opts->rate == 0 ||
+        opts->seed == 0) {
+        return RC_INVALID_OPT;
+    }
+    return RC_OK;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-n frames] [-s samples] [-r rate] [-b baud]\n"
+            "          [-d skip%%] [-e corrupt%%] [-x seed] [-o file] [-z]\n"
+            "  -b  pace output to this baud rate, 0 for no pacing\n"
+            "  -d  skip this percentage of frames, leaving gaps\n"
+            "  -e  flip a bit in this percentage of frames\n"
+            "  -o  write to a file instead of a pseudo terminal\n"
+            "  -z  Rice code frames that compress\n",
+            prog);
+}
+
+double uniform(void) {
+    // xorshift32, so runs are repeatable whatever the C library
+    RNG_STATE ^= RNG_STATE << 13;
+    RNG_STATE ^= RNG_STATE >> 17;
+    RNG_STATE ^= RNG_STATE << 5;
+    return RNG_STATE / 4294967296.0;
+}
+
+int open_pty(int *slave) {
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        return -1;
+    }
+    if (grantpt(fd) || unlockpt(fd)) {
+        close(fd);
+        return -1;
+    }
+    *slave = open(ptsname(fd), O_RDWR | O_NOCTTY);
+    if (*slave < 0) {
+        close(fd);
+        return -1;
+    }
+    // binary data, so no line discipline translating or echoing bytes
+    struct termios tio;
+    tcgetattr(*slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(*slave, TCSANOW, &tio);
+    return fd;
+}
+
+int write_all(int fd, const u8 *bytes, usize sz) {
+    while (sz > 0) {
+        ssize_t n = write(fd, bytes, sz);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 1;
+        }
+        bytes += n;
+        sz -= n;
+    }
+    return 0;
+}
+
+void pace(const struct timespec *start, u64 bytes, u32 baud) {
+    if (baud == 0) {
+        return;
+    }
+    // sleep until the time the bytes so far would have taken on the line
+    u64 ns = bytes * BITS_PER_BYTE * 1000000000ull / baud;
+    struct timespec until = {
+        .tv_sec = start->tv_sec + ns / 1000000000,
+        .tv_nsec = start->tv_nsec + ns % 1000000000,
+    };
+    if (until.tv_nsec >= 1000000000) {
+        ++until.tv_sec;
+        until.tv_nsec -= 1000000000;
+    }
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) ==
+           EINTR) {
+    }
+}
@@ -0,0 +1,457 @@
+/**
+ * capcheck.c
+ *
+ * Round trip checks for the capture file format: writes a capture in
+ * pieces of random size with random gaps, maps it back in and checks every
+ * sample, chunk summary and the index, checks seeks to random times against
+ * the ranges that were written, then corrupts entries of the index and
+ * cuts the file short, checking the index is rebuilt from the chunks each
+ * time. Reports how long each step took.
+ */
+#include "capfile.h"
+#include "defs.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PIECE_MAX 5000
+#define GAP_MAX 20000
+
+typedef struct {
+    usize channels;
+    u64 samples;
+    // percentage of writes that leave a gap before them
+    double gaps;
+    u32 chunk_samples;
+    usize seeks;
+    u32 seed;
+    const char *path;
+} Options;
+
+typedef struct {
+    u64 start;
+    u64 count;
+} Range;
+
+static u32 RNG_STATE;
+static u16 PIECE[PIECE_MAX * CAPFILE_CHANNELS_MAX];
+static Range *RANGES;
+static usize NRANGES;
+
+static RC parse_options(int argc, char **argv, Options *opts);
+static void usage(const char *prog);
+static u32 random_u32(void);
+static double uniform(void);
+static u16 sample_at(u64 t, usize channel);
+static int write_capture(const Options *opts);
+static int check_capture(const Options *opts);
+static int check_seeks(const Options *opts, const CapFile *f);
+static int check_corruption(const Options *opts);
+static int check_recovery(const Options *opts);
+static double seconds(const struct timespec *start);
+
+int main(int argc, char **argv) {
+    Options opts;
+    if (parse_options(argc, argv, &opts) != RC_OK) {
+        usage(argv[0]);
+        return 1;
+    }
+    RNG_STATE = opts.seed;
+    int failed = write_capture(&opts) || check_capture(&opts) ||
+                 check_corruption(&opts) || check_recovery(&opts);
+    unlink(opts.path);
+    free(RANGES);
+    return failed;
+}
+
+RC parse_options(int argc, char **argv, Options *opts) {
+    *opts = (Options){
+        .channels = 2,
+        .samples = 10000000,
+        .gaps = 1,
+        .chunk_samples = CAPFILE_CHUNK_SAMPLES,
+        .seeks = 100000,
+        .seed = 1,
+    };
+    int opt;
+    while ((opt = getopt(argc, argv, "c:n:g:k:s:x:")) != -1) {
+        switch (opt) {
+        case 'c':
+            opts->channels = strtoul(optarg, NULL, 10);
+            break;
+        case 'n':
+            opts->samples = strtoull(optarg, NULL, 10);
+            break;
+        case 'g':
+            opts->gaps = strtod(optarg, NULL);
+            break;
+        case 'k':
+            opts->chunk_samples = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            opts->seeks = strtoul(optarg, NULL, 10);
+            break;
+        case 'x':
+            opts->seed = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            return RC_INVALID_OPT;
+        }
+    }
+    if (optind != argc - 1 || opts->channels == 0 ||
+        opts->channels > CAPFILE_CHANNELS_MAX || opts->samples == 0 ||
+        opts->chunk_samples == 0 || opts->seed == 0) {
+        return RC_INVALID_OPT;
+    }
+    opts->path = argv[optind];
+    return RC_OK;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-c channels] [-n samples] [-g gap%%] [-k chunk]\n"
+            "          [-s seeks] [-x seed] scratch-file\n"
+            "  -n  samples per channel to write, default 10000000\n"
+            "  -g  percentage of writes with a gap before them, default 1\n"
+            "  -k  samples per channel in a chunk\n"
+            "  the scratch file is overwritten and removed afterwards\n",
+            prog);
+}
+
+u32 random_u32(void) {
+    // xorshift32, so runs are repeatable whatever the C library
+    RNG_STATE ^= RNG_STATE << 13;
+    RNG_STATE ^= RNG_STATE >> 17;
+    RNG_STATE ^= RNG_STATE << 5;
+    return RNG_STATE;
+}
+
+double uniform(void) { return random_u32() / 4294967296.0; }
+
+u16 sample_at(u64 t, usize channel) {
+    // a hash of the time, so any sample can be checked without keeping
+    // what was written
+    u32 h = (u32)t * 2654435761u ^ (u32)(t >> 32) ^ channel * 40503u;
+    h ^= h >> 15;
+    return (h * 2246822519u) >> 20;
+}
+
+int write_capture(const Options *opts) {
+    CapHeader header = {
+        .channels = opts->channels,
+        .channel_mask = (1 << opts->channels) - 1,
+        .sample_rate = 1000000,
+        .chunk_samples = opts->chunk_samples,
+        .start_ns = 1700000000000000000ull,
+    };
+    for (usize c = 0; c < opts->channels; ++c) {
+        header.scale[c] = 3.3f / 4095 * (c + 1);
+        header.offset[c] = -0.5f * c;
+    }
+    CapWriter w;
+    RC rc = capfile_create(&w, opts->path, &header);
+    if (rc != RC_OK) {
+        fprintf(stderr, "%s: %s\n", opts->path, rcstr(rc));
+        return 1;
+    }
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    usize cap = 0;
+    u64 t = 0;
+    for (u64 written = 0; written < opts->samples;) {
+        if (100 * uniform() < opts->gaps) {
+            t += 1 + random_u32() % GAP_MAX;
+        }
+        usize n = 1 + random_u32() % PIECE_MAX;
+        n = opts->samples - written < n ? opts->samples - written : n;
+        for (usize i = 0; i < n; ++i) {
+            for (usize c = 0; c < opts->channels; ++c) {
+                PIECE[i * opts->channels + c] = sample_at(t + i, c);
+            }
+        }
+        rc = capfile_write(&w, t, PIECE, n);
+        if (rc != RC_OK) {
+            fprintf(stderr, "write: %s\n", rcstr(rc));
+            return 1;
+        }
+        // kept as the continuous ranges written, to check chunks and seeks
+        // against
+        if (NRANGES > 0 &&
+            RANGES[NRANGES - 1].start + RANGES[NRANGES - 1].count == t) {
+            RANGES[NRANGES - 1].count += n;
+        } else {
+            if (NRANGES == cap) {
+                cap = cap ? 2 * cap : 64;
+                RANGES = realloc(RANGES, cap * sizeof(*RANGES));
+            }
+            RANGES[NRANGES++] = (Range){t, n};
+        }
+        t += n;
+        written += n;
+    }
+    rc = capfile_finish(&w);
+    if (rc != RC_OK) {
+        fprintf(stderr, "finish: %s\n", rcstr(rc));
+        return 1;
+    }
+    double elapsed = seconds(&start);
+    double mb = opts->samples * opts->channels * sizeof(u16) / 1e6;
+    printf("wrote %.1f MB in %zu ranges in %.3f s, %.0f MB/s\n", mb, NRANGES,
+           elapsed, mb / elapsed);
+    return 0;
+}
+
+int check_capture(const Options *opts) {
+    CapFile f;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    RC rc = capfile_open(&f, opts->path);
+    double open_s = seconds(&start);
+    if (rc != RC_OK) {
+        fprintf(stderr, "open: %s\n", rcstr(rc));
+        return 1;
+    }
+    const CapHeader *header = f.header;
+    if (header->channels != opts->channels ||
+        header->chunk_samples != opts->chunk_samples ||
+        header->sample_rate != 1000000 || f.recovered ||
+        f.samples != opts->samples ||
+        header->offset[opts->channels - 1] != -0.5f * (opts->channels - 1)) {
+        fprintf(stderr, "header or footer doesn't match what was written\n");
+        return 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    usize range = 0;
+    u64 in_range = 0;
+    for (usize i = 0; i < f.nchunks; ++i) {
+        const CapIndexEntry *entry = &f.index[i];
+        if (entry->offset % CAPFILE_ALIGN != 0 || entry->count == 0 ||
+            entry->count > opts->chunk_samples) {
+            fprintf(stderr, "chunk %zu out of place\n", i);
+            return 1;
+        }
+        // chunks cover the ranges in order, never spanning a gap
+        if (range == NRANGES ||
+            entry->start != RANGES[range].start + in_range ||
+            in_range + entry->count > RANGES[range].count) {
+            fprintf(stderr, "chunk %zu isn't where it was written\n", i);
+            return 1;
+        }
+        in_range += entry->count;
+        if (in_range == RANGES[range].count) {
+            ++range;
+            in_range = 0;
+        }
+        const u16 *samples = capfile_samples(&f, i);
+        for (usize c = 0; c < opts->channels; ++c) {
+            u16 min = 0xFFFF, max = 0;
+            for (usize j = 0; j < entry->count; ++j) {
+                u16 v = samples[j * opts->channels + c];
+                if (v != sample_at(entry->start + j, c)) {
+                    fprintf(stderr, "chunk %zu sample %zu channel %zu\n", i,
+                            j, c);
+                    return 1;
+                }
+                min = v < min ? v : min;
+                max = v > max ? v : max;
+            }
+            if (entry->min[c] != min || entry->max[c] != max) {
+                fprintf(stderr, "chunk %zu summary channel %zu\n", i, c);
+                return 1;
+            }
+        }
+    }
+    if (range != NRANGES) {
+        fprintf(stderr, "%zu of %zu ranges in the index\n", range, NRANGES);
+        return 1;
+    }
+    double read_s = seconds(&start);
+    printf("opened %zu chunks in %.1f us, checked every sample in %.3f s\n",
+           f.nchunks, open_s * 1e6, read_s);
+
+    int failed = check_seeks(opts, &f);
+    capfile_close(&f);
+    return failed;
+}
+
+int check_seeks(const Options *opts, const CapFile *f) {
+    u64 end = RANGES[NRANGES - 1].start + RANGES[NRANGES - 1].count;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (usize s = 0; s < opts->seeks; ++s) {
+        // a few past the end, which have nothing to find
+        u64 t = uniform() * (end + end / 100);
+        usize chunk, at;
+        RC rc = capfile_seek(f, t, &chunk, &at);
+        // the first range ending after t
+        usize lo = 0, hi = NRANGES;
+        while (lo < hi) {
+            usize mid = lo + (hi - lo) / 2;
+            if (RANGES[mid].start + RANGES[mid].count <= t) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo == NRANGES) {
+            if (rc == RC_OK) {
+                fprintf(stderr, "seek to %llu past the end found a sample\n",
+                        (unsigned long long)t);
+                return 1;
+            }
+            continue;
+        }
+        u64 want = t < RANGES[lo].start ? RANGES[lo].start : t;
+        if (rc != RC_OK || at >= f->index[chunk].count ||
+            f->index[chunk].start + at != want ||
+            capfile_samples(f, chunk)[at * opts->channels] !=
+                sample_at(want, 0)) {
+            fprintf(stderr, "seek to %llu didn't find %llu\n",
+                    (unsigned long long)t, (unsigned long long)want);
+            return 1;
+        }
+    }
+    double elapsed = seconds(&start);
+    printf("%zu seeks checked, %.0f ns each\n", opts->seeks,
+           elapsed * 1e9 / opts->seeks);
+    return 0;
+}
+
+int check_corruption(const Options *opts) {
+    CapFile f;
+    RC rc = capfile_open(&f, opts->path);
+    if (rc != RC_OK) {
+        fprintf(stderr, "open: %s\n", rcstr(rc));
+        return 1;
+    }
+    usize nchunks = f.nchunks;
+    CapIndexEntry *index = malloc(nchunks * sizeof(*index));
+    memcpy(index, f.index, nchunks * sizeof(*index));
+    u64 index_offset = (const u8 *)f.index - f.map;
+    capfile_close(&f);
+
+    // entries that would read outside the file or past the chunks, or that
+    // break the order capfile_seek searches in
+    const char *names[] = {
+        "offset far past the end", "offset unaligned", "offset at the index",
+        "count zero",              "count over a chunk", "start out of order",
+    };
+    usize kinds = sizeof(names) / sizeof(names[0]);
+    int fd = open(opts->path, O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "can't open %s to corrupt it\n", opts->path);
+        free(index);
+        return 1;
+    }
+    int failed = 0;
+    for (usize k = 0; k < kinds && !failed; ++k) {
+        // out of order needs an entry before it
+        usize i = nchunks > 1 ? 1 + random_u32() % (nchunks - 1) : 0;
+        CapIndexEntry entry = index[i];
+        if (k == 0) {
+            entry.offset = 1ull << 40;
+        } else if (k == 1) {
+            entry.offset += 8;
+        } else if (k == 2) {
+            entry.offset = index_offset;
+        } else if (k == 3) {
+            entry.count = 0;
+        } else if (k == 4) {
+            entry.count = opts->chunk_samples + 1;
+        } else if (i > 0) {
+            entry.start = index[i - 1].start;
+        } else {
+            continue;
+        }
+        u64 at = index_offset + i * sizeof(entry);
+        if (pwrite(fd, &entry, sizeof(entry), at) != sizeof(entry) ||
+            capfile_open(&f, opts->path) != RC_OK) {
+            fprintf(stderr, "can't open with %s\n", names[k]);
+            failed = 1;
+            break;
+        }
+        if (!f.recovered || f.nchunks != nchunks ||
+            memcmp(f.index, index, nchunks * sizeof(*index)) != 0 ||
+            capfile_samples(&f, i)[0] != sample_at(index[i].start, 0)) {
+            fprintf(stderr, "with %s in chunk %zu, rebuilt %zu chunks\n",
+                    names[k], i, f.nchunks);
+            failed = 1;
+        } else {
+            printf("index with %s rebuilt\n", names[k]);
+        }
+        capfile_close(&f);
+        if (pwrite(fd, &index[i], sizeof(entry), at) != sizeof(entry)) {
+            fprintf(stderr, "can't restore the index\n");
+            failed = 1;
+        }
+    }
+    close(fd);
+    free(index);
+    return failed;
+}
+
+int check_recovery(const Options *opts) {
+    CapFile f;
+    RC rc = capfile_open(&f, opts->path);
+    if (rc != RC_OK) {
+        fprintf(stderr, "open: %s\n", rcstr(rc));
+        return 1;
+    }
+    // the index as written, for the rebuilt ones to match
+    usize nchunks = f.nchunks;
+    CapIndexEntry *index = malloc(nchunks * sizeof(*index));
+    memcpy(index, f.index, nchunks * sizeof(*index));
+    const CapIndexEntry *last = &index[nchunks - 1];
+    u64 last_end = last->offset + sizeof(CapChunkHeader) +
+                   last->count * opts->channels * sizeof(u16);
+    u64 cuts[] = {
+        // without the footer, as if cut off writing the index
+        f.sz - sizeof(CapFooter),
+        // halfway into the last chunk, as if cut off writing that
+        (last->offset + last_end) / 2,
+    };
+    usize expected[] = {nchunks, nchunks - 1};
+    capfile_close(&f);
+
+    int failed = 0;
+    for (usize i = 0; i < 2 && !failed; ++i) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (truncate(opts->path, cuts[i]) ||
+            capfile_open(&f, opts->path) != RC_OK) {
+            fprintf(stderr, "can't open once cut to %llu bytes\n",
+                    (unsigned long long)cuts[i]);
+            failed = 1;
+            break;
+        }
+        double elapsed = seconds(&start);
+        u64 samples = 0;
+        for (usize j = 0; j < expected[i]; ++j) {
+            samples += index[j].count;
+        }
+        if (!f.recovered || f.nchunks != expected[i] ||
+            f.samples != samples ||
+            (expected[i] > 0 &&
+             memcmp(f.index, index, expected[i] * sizeof(*index)) != 0)) {
+            fprintf(stderr, "cut to %llu bytes, rebuilt %zu chunks\n",
+                    (unsigned long long)cuts[i], f.nchunks);
+            failed = 1;
+        } else {
+            printf("cut to %llu bytes, rebuilt %zu chunks in %.3f s\n",
+                   (unsigned long long)cuts[i], f.nchunks, elapsed);
+        }
+        capfile_close(&f);
+    }
+    free(index);
+    return failed;
+}
+
+double seconds(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec - start->tv_sec + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
@@ -0,0 +1,342 @@
+#include "capfile.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// the structs are the file, so any padding would change the format. Each
+// array has a negative size, failing the build, if its layout is off
+typedef char cap_header_size[sizeof(CapHeader) == 96 ? 1 : -1];
+typedef char cap_chunk_header_size[sizeof(CapChunkHeader) == 16 ? 1 : -1];
+typedef char cap_index_entry_size[sizeof(CapIndexEntry) == 56 ? 1 : -1];
+typedef char cap_footer_size[sizeof(CapFooter) == 32 ? 1 : -1];
+
+static RC flush_chunk(CapWriter *w);
+static _Bool index_valid(const CapFile *f, const CapFooter *footer);
+static RC rebuild_index(CapFile *f);
+static void summarize(const u16 *samples, usize count, usize channels,
+                      CapIndexEntry *entry);
+static RC write_at(int fd, const void *bytes, usize sz, u64 offset);
+static u64 align_up(u64 offset);
+
+RC capfile_create(CapWriter *w, const char *path, const CapHeader *header) {
+    if (header->channels == 0 || header->channels > CAPFILE_CHANNELS_MAX ||
+        header->sample_rate == 0) {
+        return RC_INVALID_OPT;
+    }
+    memset(w, 0, sizeof(*w));
+    w->header = *header;
+    memcpy(w->header.magic, CAPFILE_MAGIC, sizeof(w->header.magic));
+    w->header.version = CAPFILE_VERSION;
+    if (w->header.chunk_samples == 0) {
+        w->header.chunk_samples = CAPFILE_CHUNK_SAMPLES;
+    }
+    w->chunk = malloc((usize)w->header.chunk_samples * header->channels *
+                      sizeof(u16));
+    if (w->chunk == NULL) {
+        return RC_BUF_LENGTH;
+    }
+    w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (w->fd < 0) {
+        free(w->chunk);
+        return RC_OPEN_FAILED;
+    }
+    w->offset = CAPFILE_ALIGN;
+    // the header's padding is there from the start, so a capture that is
+    // cut short before its first chunk still opens
+    RC rc = write_at(w->fd, &w->header, sizeof(w->header), 0);
+    if (rc == RC_OK && ftruncate(w->fd, CAPFILE_ALIGN)) {
+        rc = RC_WRITE_FAILED;
+    }
+    if (rc != RC_OK) {
+        close(w->fd);
+        free(w->chunk);
+    }
+    return rc;
+}
+
+RC capfile_write(CapWriter *w, u64 start, const u16 *samples, usize count) {
+    usize channels = w->header.channels;
+    if (w->count > 0 && start != w->start + w->count) {
+        RC rc = flush_chunk(w);
+        if (rc != RC_OK) {
+            return rc;
+        }
+    }
+    while (count > 0) {
+        if (w->count == 0) {
+            w->start = start;
+        }
+        usize n = w->header.chunk_samples - w->count;
+        n = count < n ? count : n;
+        memcpy(w->chunk + w->count * channels, samples,
+               n * channels * sizeof(u16));
+        w->count += n;
+        start += n;
+        samples += n * channels;
+        count -= n;
+        if (w->count == w->header.chunk_samples) {
+            RC rc = flush_chunk(w);
+            if (rc != RC_OK) {
+                return rc;
+            }
+        }
+    }
+    return RC_OK;
+}
+
+RC capfile_finish(CapWriter *w) {
+    RC rc = flush_chunk(w);
+    if (rc == RC_OK) {
+        rc = write_at(w->fd, w->index, w->nchunks * sizeof(CapIndexEntry),
+                      w->offset);
+    }
+    if (rc == RC_OK) {
+        CapFooter footer = {
+            .index_offset = w->offset,
+            .nchunks = w->nchunks,
+            .samples = w->samples,
+            .magic = CAPFILE_INDEX_MAGIC,
+        };
+        rc = write_at(w->fd, &footer, sizeof(footer),
+                      w->offset + w->nchunks * sizeof(CapIndexEntry));
+    }
+    if (close(w->fd) && rc == RC_OK) {
+        rc = RC_CLOSE_FAILED;
+    }
+    free(w->index);
+    free(w->chunk);
+    return rc;
+}
+
+RC capfile_open(CapFile *f, const char *path) {
+    memset(f, 0, sizeof(*f));
+    f->fd = open(path, O_RDONLY);
+    if (f->fd < 0) {
+        return RC_OPEN_FAILED;
+    }
+    struct stat st;
+    if (fstat(f->fd, &st) || (usize)st.st_size < CAPFILE_ALIGN) {
+        close(f->fd);
+        return RC_OPEN_FAILED;
+    }
+    f->sz = st.st_size;
+    void *map = mmap(NULL, f->sz, PROT_READ, MAP_SHARED, f->fd, 0);
+    if (map == MAP_FAILED) {
+        close(f->fd);
+        return RC_OPEN_FAILED;
+    }
+    f->map = map;
+    f->header = map;
+    const CapHeader *header = f->header;
+    if (memcmp(header->magic, CAPFILE_MAGIC, sizeof(header->magic)) ||
+        header->version != CAPFILE_VERSION || header->channels == 0 ||
+        header->channels > CAPFILE_CHANNELS_MAX ||
+        header->chunk_samples == 0) {
+        capfile_close(f);
+        return RC_OPEN_FAILED;
+    }
+    // copied out, since a file cut short can end anywhere
+    CapFooter footer;
+    memcpy(&footer, f->map + f->sz - sizeof(footer), sizeof(footer));
+    // the footer has to account for exactly the rest of the file, or
+    // whatever is there isn't one
+    if (footer.magic == CAPFILE_INDEX_MAGIC &&
+        footer.index_offset >= CAPFILE_ALIGN &&
+        footer.index_offset % CAPFILE_ALIGN == 0 &&
+        footer.nchunks <= f->sz / CAPFILE_ALIGN &&
+        footer.index_offset + footer.nchunks * sizeof(CapIndexEntry) ==
+            f->sz - sizeof(footer) &&
+        index_valid(f, &footer)) {
+        f->index = (const CapIndexEntry *)(f->map + footer.index_offset);
+        f->nchunks = footer.nchunks;
+        f->samples = footer.samples;
+        return RC_OK;
+    }
+    RC rc = rebuild_index(f);
+    if (rc != RC_OK) {
+        capfile_close(f);
+    }
+    return rc;
+}
+
+void capfile_close(CapFile *f) {
+    munmap((void *)f->map, f->sz);
+    close(f->fd);
+    free(f->rebuilt);
+    f->rebuilt = NULL;
+}
+
+const u16 *capfile_samples(const CapFile *f, usize i) {
+    return (const u16 *)(f->map + f->index[i].offset +
+                         sizeof(CapChunkHeader));
+}
+
+RC capfile_seek(const CapFile *f, u64 t, usize *chunk, usize *at) {
+    // the last chunk starting at or before t
+    usize lo = 0, hi = f->nchunks;
+    while (lo < hi) {
+        usize mid = lo + (hi - lo) / 2;
+        if (f->index[mid].start <= t) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo > 0 && t < f->index[lo - 1].start + f->index[lo - 1].count) {
+        *chunk = lo - 1;
+        *at = t - f->index[lo - 1].start;
+        return RC_OK;
+    }
+    if (lo == f->nchunks) {
+        return RC_INVALID_OPT;
+    }
+    *chunk = lo;
+    *at = 0;
+    return RC_OK;
+}
+
+static RC flush_chunk(CapWriter *w) {
+    if (w->count == 0) {
+        return RC_OK;
+    }
+    if (w->nchunks == w->index_cap) {
+        usize cap = w->index_cap ? 2 * w->index_cap : 64;
+        CapIndexEntry *index = realloc(w->index, cap * sizeof(*index));
+        if (index == NULL) {
+            return RC_BUF_LENGTH;
+        }
+        w->index = index;
+        w->index_cap = cap;
+    }
+    usize channels = w->header.channels;
+    CapChunkHeader chunk = {
+        .magic = CAPFILE_CHUNK_MAGIC,
+        .count = w->count,
+        .start = w->start,
+    };
+    RC rc = write_at(w->fd, &chunk, sizeof(chunk), w->offset);
+    if (rc == RC_OK) {
+        rc = write_at(w->fd, w->chunk, w->count * channels * sizeof(u16),
+                      w->offset + sizeof(chunk));
+    }
+    if (rc != RC_OK) {
+        return rc;
+    }
+    CapIndexEntry *entry = &w->index[w->nchunks++];
+    *entry = (CapIndexEntry){
+        .offset = w->offset,
+        .start = w->start,
+        .count = w->count,
+    };
+    summarize(w->chunk, w->count, channels, entry);
+    w->offset = align_up(w->offset + sizeof(chunk) +
+                         w->count * channels * sizeof(u16));
+    w->samples += w->count;
+    w->count = 0;
+    return RC_OK;
+}
+
+static _Bool index_valid(const CapFile *f, const CapFooter *footer) {
+    // the entries are used as they are, to find samples in the map and by
+    // binary search on start, so any that would read outside the chunks or
+    // break the order means the index can't be trusted
+    const CapIndexEntry *index =
+        (const CapIndexEntry *)(f->map + footer->index_offset);
+    usize channels = f->header->channels;
+    u64 samples = 0;
+    for (usize i = 0; i < footer->nchunks; ++i) {
+        const CapIndexEntry *entry = &index[i];
+        if (entry->offset < CAPFILE_ALIGN ||
+            entry->offset % CAPFILE_ALIGN != 0 ||
+            entry->offset >= footer->index_offset || entry->count == 0 ||
+            entry->count > f->header->chunk_samples ||
+            entry->start + entry->count < entry->start ||
+            footer->index_offset - entry->offset <
+                sizeof(CapChunkHeader) + (u64)entry->count * channels * 2 ||
+            (i > 0 && entry->start < index[i - 1].start + index[i - 1].count)) {
+            return 0;
+        }
+        samples += entry->count;
+    }
+    return samples == footer->samples;
+}
+
+static RC rebuild_index(CapFile *f) {
+    usize channels = f->header->channels;
+    usize cap = 0;
+    u64 offset = CAPFILE_ALIGN;
+    while (offset + sizeof(CapChunkHeader) <= f->sz) {
+        const CapChunkHeader *chunk =
+            (const CapChunkHeader *)(f->map + offset);
+        u64 end = offset + sizeof(*chunk) + chunk->count * channels * 2;
+        // stop at the first chunk that isn't whole, or is out of order
+        if (chunk->magic != CAPFILE_CHUNK_MAGIC || chunk->count == 0 ||
+            chunk->count > f->header->chunk_samples || end > f->sz ||
+            (f->nchunks > 0 &&
+             chunk->start < f->rebuilt[f->nchunks - 1].start +
+                                f->rebuilt[f->nchunks - 1].count)) {
+            break;
+        }
+        if (f->nchunks == cap) {
+            cap = cap ? 2 * cap : 64;
+            CapIndexEntry *index = realloc(f->rebuilt, cap * sizeof(*index));
+            if (index == NULL) {
+                return RC_BUF_LENGTH;
+            }
+            f->rebuilt = index;
+        }
+        CapIndexEntry *entry = &f->rebuilt[f->nchunks++];
+        *entry = (CapIndexEntry){
+            .offset = offset,
+            .start = chunk->start,
+            .count = chunk->count,
+        };
+        summarize((const u16 *)(chunk + 1), chunk->count, channels, entry);
+        f->samples += chunk->count;
+        offset = align_up(end);
+    }
+    f->index = f->rebuilt;
+    f->recovered = 1;
+    return RC_OK;
+}
+
+static void summarize(const u16 *samples, usize count, usize channels,
+                      CapIndexEntry *entry) {
+    for (usize c = 0; c < channels; ++c) {
+        entry->min[c] = 0xFFFF;
+        entry->max[c] = 0;
+    }
+    for (usize i = 0; i < count; ++i, samples += channels) {
+        for (usize c = 0; c < channels; ++c) {
+            entry->min[c] = samples[c] < entry->min[c] ? samples[c]
+                                                       : entry->min[c];
+            entry->max[c] = samples[c] > entry->max[c] ? samples[c]
+                                                       : entry->max[c];
+        }
+    }
+}
+
+static RC write_at(int fd, const void *bytes, usize sz, u64 offset) {
+    const u8 *at = bytes;
+    while (sz > 0) {
+        ssize_t n = pwrite(fd, at, sz, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return RC_WRITE_FAILED;
+        }
+        at += n;
+        sz -= n;
+        offset += n;
+    }
+    return RC_OK;
+}
+
+static u64 align_up(u64 offset) {
+    return (offset + CAPFILE_ALIGN - 1) / CAPFILE_ALIGN * CAPFILE_ALIGN;
+}
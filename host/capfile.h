@@ -0,0 +1,143 @@
+/**
+ * capfile.h
+ *
+ * Container for recorded captures that host tools can map into memory and
+ * use straight away, whatever the size, rather than parse from the start:
+ *
+ *   0              CapHeader, padded to CAPFILE_ALIGN
+ *   CAPFILE_ALIGN  chunks, each a CapChunkHeader and then its samples,
+ *                  channels interleaved as u16, padded to CAPFILE_ALIGN
+ *   ..             index, a CapIndexEntry per chunk in time order
+ *   end - 32       CapFooter, locating the index
+ *
+ * Time is counted in samples per channel since the first one recorded, on
+ * the board's sample clock, so seconds are that over the sample rate.
+ * Samples lost on the way leave a gap in time between chunks; a chunk
+ * itself is always continuous. The index holds every chunk's position in
+ * time and the min and max of each channel in it, so finding a time is a
+ * binary search and an overview of the whole capture never touches the
+ * samples.
+ *
+ * A file cut short before its index was written, by a crash or a full disk,
+ * still opens: the index is rebuilt by walking the chunks.
+ *
+ * Fields are stored in host byte order, which is little endian on every
+ * machine the host tools are built for, so the structs below are the bytes
+ * on disk.
+ */
+#ifndef HOST_CAPFILE_H
+#define HOST_CAPFILE_H
+
+#include "defs.h"
+
+#define CAPFILE_MAGIC "SCOPECAP"
+#define CAPFILE_VERSION 1
+#define CAPFILE_CHUNK_MAGIC 0x4B4E4843
+#define CAPFILE_INDEX_MAGIC 0x58444E49
+#define CAPFILE_ALIGN 4096
+#define CAPFILE_CHANNELS_MAX 8
+// per channel, so a chunk of two channels is 256KiB of samples
+#define CAPFILE_CHUNK_SAMPLES 65536
+
+typedef struct {
+    char magic[8];
+    u32 version;
+    u8 channels;
+    // which of the board's channels these are, as in the stream header
+    u8 channel_mask;
+    u16 reserved;
+    u32 sample_rate;
+    // the most samples per channel a chunk holds
+    u32 chunk_samples;
+    // wall clock time of the first sample, ns since the epoch
+    u64 start_ns;
+    // volts = offset + scale * sample, for each channel
+    float scale[CAPFILE_CHANNELS_MAX];
+    float offset[CAPFILE_CHANNELS_MAX];
+} CapHeader;
+
+typedef struct {
+    u32 magic;
+    // samples per channel
+    u32 count;
+    u64 start;
+} CapChunkHeader;
+
+typedef struct {
+    // of the chunk header
+    u64 offset;
+    u64 start;
+    u32 count;
+    u32 reserved;
+    u16 min[CAPFILE_CHANNELS_MAX];
+    u16 max[CAPFILE_CHANNELS_MAX];
+} CapIndexEntry;
+
+typedef struct {
+    u64 index_offset;
+    u64 nchunks;
+    // samples per channel across all chunks
+    u64 samples;
+    u32 magic;
+    u32 reserved;
+} CapFooter;
+
+typedef struct {
+    int fd;
+    CapHeader header;
+    // where the next chunk goes
+    u64 offset;
+    CapIndexEntry *index;
+    usize nchunks;
+    usize index_cap;
+    // the chunk being filled
+    u16 *chunk;
+    usize count;
+    u64 start;
+    u64 samples;
+} CapWriter;
+
+typedef struct {
+    int fd;
+    const u8 *map;
+    usize sz;
+    const CapHeader *header;
+    const CapIndexEntry *index;
+    usize nchunks;
+    u64 samples;
+    // the file had no index and it was rebuilt from the chunks
+    _Bool recovered;
+    CapIndexEntry *rebuilt;
+} CapFile;
+
+/**
+ * Start a capture file at `path`, with the header's channels, rate and
+ * calibration. The magic and version are filled in, and the chunk size
+ * when left zero.
+ */
+RC capfile_create(CapWriter *w, const char *path, const CapHeader *header);
+
+/**
+ * Append `count` samples per channel, interleaved, the first at time
+ * `start`. A start that doesn't follow on from the last write ends the
+ * chunk, leaving a gap.
+ */
+RC capfile_write(CapWriter *w, u64 start, const u16 *samples, usize count);
+
+// write out the last chunk and the index, and close the file
+RC capfile_finish(CapWriter *w);
+
+RC capfile_open(CapFile *f, const char *path);
+void capfile_close(CapFile *f);
+
+// the interleaved samples of chunk `i`
+const u16 *capfile_samples(const CapFile *f, usize i);
+
+/**
+ * Find the sample at time `t`, as the chunk holding it and the position in
+ * that chunk. A time in a gap finds the first sample after it, and one
+ * past the last sample is RC_INVALID_OPT.
+ */
+RC capfile_seek(const CapFile *f, u64 t, usize *chunk, usize *at);
+
+#endif // HOST_CAPFILE_H
@@ -0,0 +1,526 @@
+/**
+ * capture.c
+ *
+ * Records the board's binary sample stream to disk at full rate. One thread
+ * does nothing but read the port into a ring, another drains the ring to the
+ * output file and decodes it on the way, and the main thread reports
+ * throughput, gaps and CRC errors once a second until the port closes or
+ * the capture is interrupted.
+ *
+ * The ring has a single producer and a single consumer, each owning one
+ * index, so neither thread ever waits on the other: a write that stalls
+ * only lets the ring fill, and the port keeps being read. Only if the ring
+ * fills up completely are bytes from a port thrown away, and counted, since
+ * the UART would overrun anyway. A regular file is read no faster than it
+ * is written out.
+ *
+ * The raw stream can be recorded as it came, for streamcat, and the decoded
+ * samples as a capture file (see capfile.h) for tools that seek around a
+ * recording. A frame's place in time in the capture file comes from the
+ * frames before it, those lost taken to be the size of the last one that
+ * arrived, and a change of rate or channels ends the capture file.
+ */
+#define _GNU_SOURCE
+#include "capfile.h"
+#include "defs.h"
+#include "stream.h"
+#include "streamdec.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+// how long a blocked thread waits before looking at the stop flag again
+#define POLL_MS 100
+#define IDLE_NS 1000000
+// the board's ADC, as in the firmware
+#define VOLTAGE_MAX 3.3
+#define ADC_MAX 4095.0
+
+typedef struct {
+    u32 baud;
+    speed_t speed;
+} Baud;
+
+// rates the firmware can be asked for that termios has a constant for
+static const Baud BAUDS[] = {
+    {115200, B115200},   {230400, B230400},   {460800, B460800},
+    {921600, B921600},   {1000000, B1000000}, {1500000, B1500000},
+    {2000000, B2000000}, {2500000, B2500000}, {3000000, B3000000},
+    {3500000, B3500000}, {4000000, B4000000},
+};
+
+typedef struct {
+    u32 baud;
+    // ring size as a power of two
+    usize ring;
+    // pause after every write, to see what a slow disk does
+    u32 write_delay_ms;
+    _Bool quiet;
+    const char *path;
+    const char *out;
+    const char *capfile;
+} Options;
+
+typedef struct {
+    u8 *buf;
+    usize sz;
+    // running totals of bytes put in and taken out, each written by one
+    // thread only, so their difference is the fill
+    u64 head;
+    u64 tail;
+} Ring;
+
+typedef struct {
+    // written by the reader
+    u64 read;
+    u64 dropped;
+    u64 peak;
+    // written by the writer
+    u64 written;
+    // a copy of the writer's decoder stats, under `lock`
+    StreamDecoderStats decoded;
+    pthread_mutex_t lock;
+} Progress;
+
+typedef struct {
+    int in;
+    int out;
+    _Bool live;
+    u32 write_delay_ms;
+    Ring ring;
+    Progress progress;
+    // the capture file, created by the writer on the first frame
+    const char *capfile;
+    CapWriter recording;
+    _Bool recording_open;
+    _Bool recording_ended;
+    // time of the next sample and samples per channel in the last frame
+    u64 t;
+    usize frame_samples;
+    // set by main to stop reading, by the reader when the port closes and
+    // by the writer when it's done or a write fails
+    _Bool stop;
+    _Bool reader_done;
+    _Bool writer_done;
+    _Bool failed;
+} Capture;
+
+static Capture CAPTURE;
+static StreamDecoder DECODER;
+static StreamFrame FRAME;
+static u8 DISCARD[4096];
+
+static RC parse_options(int argc, char **argv, Options *opts);
+static void usage(const char *prog);
+static int set_raw(int fd, u32 baud);
+static void *reader(void *arg);
+static void *writer(void *arg);
+static int decode(Capture *cap, const u8 *bytes, usize sz);
+static RC record(Capture *cap, const StreamFrame *frame);
+static int write_all(int fd, const u8 *bytes, usize sz);
+static void report(Capture *cap, double elapsed, u64 *last, double *last_at,
+                   _Bool final);
+static double seconds(const struct timespec *start);
+static u64 load(const u64 *value);
+static void store(u64 *value, u64 to);
+
+int main(int argc, char **argv) {
+    Options opts;
+    if (parse_options(argc, argv, &opts) != RC_OK) {
+        usage(argv[0]);
+        return 1;
+    }
+    Capture *cap = &CAPTURE;
+    cap->in = open(opts.path, O_RDONLY | O_NOCTTY);
+    if (cap->in < 0) {
+        perror(opts.path);
+        return 1;
+    }
+    if (isatty(cap->in) && set_raw(cap->in, opts.baud)) {
+        fprintf(stderr, "%s: can't set raw mode at %u baud\n", opts.path,
+                opts.baud);
+        return 1;
+    }
+    struct stat st;
+    cap->live = fstat(cap->in, &st) == 0 && !S_ISREG(st.st_mode);
+    cap->out = -1;
+    if (opts.out != NULL) {
+        cap->out = open(opts.out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (cap->out < 0) {
+            perror(opts.out);
+            return 1;
+        }
+    }
+    cap->write_delay_ms = opts.write_delay_ms;
+    cap->capfile = opts.capfile;
+    cap->ring.sz = opts.ring;
+    cap->ring.buf = malloc(opts.ring);
+    if (cap->ring.buf == NULL) {
+        fprintf(stderr, "can't allocate a %zu byte ring\n", opts.ring);
+        return 1;
+    }
+    pthread_mutex_init(&cap->progress.lock, NULL);
+    streamdec_init(&DECODER);
+
+    // the threads inherit the mask, so an interrupt only ever reaches the
+    // wait below
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    pthread_t threads[2];
+    if (pthread_create(&threads[0], NULL, reader, cap) ||
+        pthread_create(&threads[1], NULL, writer, cap)) {
+        fprintf(stderr, "can't start threads\n");
+        return 1;
+    }
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    u64 last = 0;
+    double last_at = 0;
+    while (!__atomic_load_n(&cap->writer_done, __ATOMIC_ACQUIRE)) {
+        // woken often enough to exit soon after the writer, reporting once
+        // a second
+        struct timespec tick = {.tv_nsec = POLL_MS * 1000000};
+        if (sigtimedwait(&signals, NULL, &tick) > 0) {
+            __atomic_store_n(&cap->stop, 1, __ATOMIC_RELEASE);
+            continue;
+        }
+        double elapsed = seconds(&start);
+        if (!opts.quiet && elapsed - last_at >= 1 &&
+            !__atomic_load_n(&cap->stop, __ATOMIC_ACQUIRE)) {
+            report(cap, elapsed, &last, &last_at, 0);
+        }
+    }
+    pthread_join(threads[0], NULL);
+    pthread_join(threads[1], NULL);
+    close(cap->in);
+    if (cap->out >= 0 && close(cap->out)) {
+        perror(opts.out);
+        cap->failed = 1;
+    }
+    report(cap, seconds(&start), &last, &last_at, 1);
+    free(cap->ring.buf);
+    return cap->failed;
+}
+
+RC parse_options(int argc, char **argv, Options *opts) {
+    *opts = (Options){.baud = 2000000, .ring = 16 << 20};
+    int opt;
+    while ((opt = getopt(argc, argv, "b:o:c:r:w:q")) != -1) {
+        switch (opt) {
+        case 'b':
+            opts->baud = strtoul(optarg, NULL, 10);
+            break;
+        case 'o':
+            opts->out = optarg;
+            break;
+        case 'c':
+            opts->capfile = optarg;
+            break;
+        case 'r':
+            opts->ring = strtoul(optarg, NULL, 10) << 10;
+            break;
+        case 'w':
+            opts->write_delay_ms = strtoul(optarg, NULL, 10);
+            break;
+        case 'q':
+            opts->quiet = 1;
+            break;
+        default:
+            return RC_INVALID_OPT;
+        }
+    }
+    // a power of two so indices wrap with a mask
+    if (optind != argc - 1 || opts->ring < sizeof(DISCARD) ||
+        (opts->ring & (opts->ring - 1)) != 0) {
+        return RC_INVALID_OPT;
+    }
+    opts->path = argv[optind];
+    return RC_OK;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-b baud] [-o file] [-c file] [-r KiB] [-w ms] [-q]\n"
+            "          port|file\n"
+            "  -b  baud rate when reading a serial port, default 2000000\n"
+            "  -o  record the stream to this file as it came\n"
+            "  -c  record the samples to this capture file\n"
+            "  -r  ring between reading and writing, a power of two, "
+            "default 16384\n"
+            "  -w  pause after every write, to try out a slow disk\n"
+            "  -q  only print the summary\n",
+            prog);
+}
+
+int set_raw(int fd, u32 baud) {
+    usize i = 0;
+    while (i < sizeof(BAUDS) / sizeof(BAUDS[0]) && BAUDS[i].baud != baud) {
+        ++i;
+    }
+    if (i == sizeof(BAUDS) / sizeof(BAUDS[0])) {
+        return 1;
+    }
+    struct termios tio;
+    if (tcgetattr(fd, &tio)) {
+        return 1;
+    }
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, BAUDS[i].speed);
+    cfsetospeed(&tio, BAUDS[i].speed);
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    return tcsetattr(fd, TCSANOW, &tio);
+}
+
+void *reader(void *arg) {
+    Capture *cap = arg;
+    Ring *ring = &cap->ring;
+    Progress *progress = &cap->progress;
+    struct pollfd pfd = {.fd = cap->in, .events = POLLIN};
+    while (!__atomic_load_n(&cap->stop, __ATOMIC_ACQUIRE)) {
+        // poll rather than block in read, so a stop is noticed on a quiet
+        // port
+        int ready = poll(&pfd, 1, POLL_MS);
+        if (ready < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+        if (ready <= 0) {
+            continue;
+        }
+        u64 tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        usize fill = ring->head - tail;
+        usize room = ring->sz - fill;
+        if (room == 0 && !cap->live) {
+            struct timespec idle = {.tv_nsec = IDLE_NS};
+            nanosleep(&idle, NULL);
+            continue;
+        }
+        // into the ring up to where it wraps, or away if there's no room
+        u8 *to = DISCARD;
+        usize want = sizeof(DISCARD);
+        if (room > 0) {
+            usize at = ring->head & (ring->sz - 1);
+            to = ring->buf + at;
+            want = ring->sz - at < room ? ring->sz - at : room;
+        }
+        ssize_t n = read(cap->in, to, want);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        // a pseudo terminal whose other end has gone reads as EIO
+        if (n < 0 && errno != EIO) {
+            perror("read");
+            break;
+        }
+        if (n <= 0) {
+            break;
+        }
+        store(&progress->read, progress->read + n);
+        if (room == 0) {
+            store(&progress->dropped, progress->dropped + n);
+            continue;
+        }
+        __atomic_store_n(&ring->head, ring->head + n, __ATOMIC_RELEASE);
+        if (fill + n > progress->peak) {
+            store(&progress->peak, fill + n);
+        }
+    }
+    __atomic_store_n(&cap->reader_done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+void *writer(void *arg) {
+    Capture *cap = arg;
+    Ring *ring = &cap->ring;
+    Progress *progress = &cap->progress;
+    for (;;) {
+        // whether the reader is done has to be read before the head, or
+        // bytes it put in just before finishing could be missed
+        _Bool done = __atomic_load_n(&cap->reader_done, __ATOMIC_ACQUIRE);
+        u64 head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (head == ring->tail) {
+            if (done) {
+                break;
+            }
+            struct timespec idle = {.tv_nsec = IDLE_NS};
+            nanosleep(&idle, NULL);
+            continue;
+        }
+        usize at = ring->tail & (ring->sz - 1);
+        usize n = head - ring->tail;
+        n = ring->sz - at < n ? ring->sz - at : n;
+        const u8 *bytes = ring->buf + at;
+        if (cap->out >= 0 && write_all(cap->out, bytes, n)) {
+            perror("write");
+            cap->failed = 1;
+            __atomic_store_n(&cap->stop, 1, __ATOMIC_RELEASE);
+            break;
+        }
+        if (decode(cap, bytes, n)) {
+            cap->failed = 1;
+            __atomic_store_n(&cap->stop, 1, __ATOMIC_RELEASE);
+            break;
+        }
+        __atomic_store_n(&ring->tail, ring->tail + n, __ATOMIC_RELEASE);
+        store(&progress->written, progress->written + n);
+        if (cap->write_delay_ms > 0) {
+            struct timespec delay = {
+                .tv_sec = cap->write_delay_ms / 1000,
+                .tv_nsec = cap->write_delay_ms % 1000 * 1000000,
+            };
+            nanosleep(&delay, NULL);
+        }
+    }
+    if (cap->recording_open && !cap->recording_ended) {
+        RC rc = capfile_finish(&cap->recording);
+        if (rc != RC_OK) {
+            fprintf(stderr, "%s: %s\n", cap->capfile, rcstr(rc));
+            cap->failed = 1;
+        }
+    }
+    __atomic_store_n(&cap->writer_done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+int decode(Capture *cap, const u8 *bytes, usize sz) {
+    usize taken = 0;
+    while (taken < sz) {
+        taken += streamdec_push(&DECODER, bytes + taken, sz - taken);
+        while (streamdec_next(&DECODER, &FRAME) == RC_OK) {
+            if (cap->capfile == NULL || cap->recording_ended) {
+                continue;
+            }
+            RC rc = record(cap, &FRAME);
+            if (rc != RC_OK) {
+                fprintf(stderr, "%s: %s\n", cap->capfile, rcstr(rc));
+                return 1;
+            }
+        }
+    }
+    pthread_mutex_lock(&cap->progress.lock);
+    cap->progress.decoded = DECODER.stats;
+    pthread_mutex_unlock(&cap->progress.lock);
+    return 0;
+}
+
+RC record(Capture *cap, const StreamFrame *frame) {
+    CapWriter *w = &cap->recording;
+    usize channels = __builtin_popcount(frame->channel_mask);
+    if (!cap->recording_open) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        CapHeader header = {
+            .channels = channels,
+            .channel_mask = frame->channel_mask,
+            .sample_rate = frame->sample_rate,
+            .start_ns = now.tv_sec * 1000000000ull + now.tv_nsec,
+        };
+        for (usize c = 0; c < channels; ++c) {
+            header.scale[c] = VOLTAGE_MAX / ADC_MAX;
+        }
+        RC rc = capfile_create(w, cap->capfile, &header);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        cap->recording_open = 1;
+    } else if (frame->channel_mask != w->header.channel_mask ||
+               frame->sample_rate != w->header.sample_rate) {
+        fprintf(stderr, "%s: rate or channels changed, ending it before "
+                        "seq %u\n",
+                cap->capfile, frame->seq);
+        cap->recording_ended = 1;
+        return capfile_finish(w);
+    }
+    cap->t += (u64)frame->lost * cap->frame_samples;
+    usize count = frame->count / channels;
+    RC rc = capfile_write(w, cap->t, frame->samples, count);
+    cap->t += count;
+    cap->frame_samples = count;
+    return rc;
+}
+
+int write_all(int fd, const u8 *bytes, usize sz) {
+    while (sz > 0) {
+        ssize_t n = write(fd, bytes, sz);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 1;
+        }
+        bytes += n;
+        sz -= n;
+    }
+    return 0;
+}
+
+void report(Capture *cap, double elapsed, u64 *last, double *last_at,
+            _Bool final) {
+    Progress *progress = &cap->progress;
+    StreamDecoderStats stats;
+    pthread_mutex_lock(&progress->lock);
+    stats = progress->decoded;
+    pthread_mutex_unlock(&progress->lock);
+    u64 read = load(&progress->read);
+    u64 written = load(&progress->written);
+    u64 dropped = load(&progress->dropped);
+    u64 peak = load(&progress->peak);
+    u64 tail = __atomic_load_n(&cap->ring.tail, __ATOMIC_ACQUIRE);
+    u64 fill = __atomic_load_n(&cap->ring.head, __ATOMIC_ACQUIRE) - tail;
+    if (!final) {
+        // the rate over the last second, the total over the whole run
+        double rate = (read - *last) / (elapsed - *last_at);
+        *last = read;
+        *last_at = elapsed;
+        fprintf(stderr,
+                "%7.1f s %8.1f KiB/s %10llu frames %6llu gaps (%llu lost) "
+                "%6llu crc  ring %3.0f%% peak %3.0f%%  dropped %llu\n",
+                elapsed, rate / 1024, (unsigned long long)stats.frames,
+                (unsigned long long)stats.gaps,
+                (unsigned long long)stats.lost,
+                (unsigned long long)stats.crc_errors,
+                100.0 * fill / cap->ring.sz,
+                100.0 * peak / cap->ring.sz, (unsigned long long)dropped);
+        return;
+    }
+    fprintf(stderr,
+            "%llu bytes in %.1f s (%.1f KiB/s), %llu written, %llu dropped, "
+            "ring peak %llu bytes\n"
+            "%llu frames, %llu samples, lost %llu frames in %llu gaps, "
+            "%llu crc errors, %llu bytes skipped\n",
+            (unsigned long long)read, elapsed,
+            elapsed > 0 ? read / elapsed / 1024 : 0,
+            (unsigned long long)written, (unsigned long long)dropped,
+            (unsigned long long)peak, (unsigned long long)stats.frames,
+            (unsigned long long)stats.samples, (unsigned long long)stats.lost,
+            (unsigned long long)stats.gaps,
+            (unsigned long long)stats.crc_errors,
+            (unsigned long long)stats.skipped);
+}
+
+double seconds(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec - start->tv_sec + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// counters only one thread writes, read by main for the report
+u64 load(const u64 *value) { return __atomic_load_n(value, __ATOMIC_RELAXED); }
+
+void store(u64 *value, u64 to) {
+    __atomic_store_n(value, to, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,317 @@
+/**
+ * cmdsh.c
+ *
+ * Runs the serial command parser on the host against a pretend board, so
+ * commands can be tried out from a terminal, and fuzzes it: random input
+ * must never overrun a buffer or produce an unterminated reply, every
+ * spelling of a known command must reach its handler with the value sent,
+ * and numbers must parse as strtod reads them.
+ */
+#include "command.h"
+#include "defs.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct {
+    double rate;
+    double level;
+    double scale;
+    // the last value a handler was given and how many replies were sent
+    double value;
+    usize sets;
+    usize replies;
+    _Bool echo;
+} Board;
+
+typedef struct {
+    usize iterations;
+    u32 seed;
+} Options;
+
+static u32 RNG_STATE = 1;
+
+static RC set_rate(void *ctx, double value);
+static RC set_level(void *ctx, double value);
+static RC set_scale(void *ctx, double value);
+static RC get_rate(void *ctx, char *reply, usize sz);
+static RC get_level(void *ctx, char *reply, usize sz);
+static RC get_scale(void *ctx, char *reply, usize sz);
+static RC get_measurements(void *ctx, char *reply, usize sz);
+static void reply(void *ctx, const char *text);
+
+// the board's table, with handlers that just record what they were given
+static const Command COMMANDS[] = {
+    {":ACQuire:RATE", set_rate, get_rate},
+    {":TRIGger:LEVel", set_level, get_level},
+    {":DISPlay:SCALe", set_scale, get_scale},
+    {":MEASure", NULL, get_measurements},
+};
+#define NCOMMANDS (sizeof(COMMANDS) / sizeof(COMMANDS[0]))
+
+static RC parse_options(int argc, char **argv, Options *opts);
+static void usage(const char *prog);
+static u32 random_u32(void);
+static double uniform(void);
+static int fuzz_bytes(CommandParser *parser, usize iterations);
+static int fuzz_spellings(CommandParser *parser, Board *board,
+                          usize iterations);
+static int fuzz_numbers(usize iterations);
+static usize spell(const char *pattern, char *out);
+
+int main(int argc, char **argv) {
+    Options opts;
+    if (parse_options(argc, argv, &opts) != RC_OK) {
+        usage(argv[0]);
+        return 1;
+    }
+    Board board = {.rate = 1000000, .level = 1.65, .scale = 2.0, .echo = 1};
+    CommandParser parser;
+    if (command_init(&parser, COMMANDS, NCOMMANDS, reply, &board) != RC_OK) {
+        fprintf(stderr, "error initializing commands\n");
+        return 1;
+    }
+
+    if (opts.iterations == 0) {
+        // read and feed in pieces as the firmware would
+        u8 buf[32];
+        ssize_t n;
+        while ((n = read(STDIN_FILENO, buf, sizeof(buf))) > 0) {
+            command_feed(&parser, buf, n);
+        }
+        return 0;
+    }
+
+    RNG_STATE = opts.seed;
+    board.echo = 0;
+    if (fuzz_bytes(&parser, opts.iterations) ||
+        fuzz_spellings(&parser, &board, opts.iterations) ||
+        fuzz_numbers(opts.iterations)) {
+        return 1;
+    }
+    printf("%zu iterations each: %lu lines, %lu executed, %lu errors\n",
+           opts.iterations, (unsigned long)parser.stats.lines,
+           (unsigned long)parser.stats.executed,
+           (unsigned long)parser.stats.errors);
+    return 0;
+}
+
+RC parse_options(int argc, char **argv, Options *opts) {
+    *opts = (Options){.seed = 1};
+    int opt;
+    while ((opt = getopt(argc, argv, "f:x:")) != -1) {
+        switch (opt) {
+        case 'f':
+            opts->iterations = strtoul(optarg, NULL, 10);
+            break;
+        case 'x':
+            opts->seed = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            return RC_INVALID_OPT;
+        }
+    }
+    if (optind != argc || opts->seed == 0) {
+        return RC_INVALID_OPT;
+    }
+    return RC_OK;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-f iterations] [-x seed]\n"
+            "  commands are read from stdin unless fuzzing\n"
+            "  -f  fuzz the parser for this many iterations of each check\n",
+            prog);
+}
+
+RC set_rate(void *ctx, double value) {
+    Board *board = ctx;
+    if (value < 1) {
+        return RC_INVALID_OPT;
+    }
+    board->rate = board->value = value;
+    ++board->sets;
+    return RC_OK;
+}
+
+RC set_level(void *ctx, double value) {
+    Board *board = ctx;
+    board->level = board->value = value;
+    ++board->sets;
+    return RC_OK;
+}
+
+RC set_scale(void *ctx, double value) {
+    Board *board = ctx;
+    if (value <= 0) {
+        return RC_INVALID_OPT;
+    }
+    board->scale = board->value = value;
+    ++board->sets;
+    return RC_OK;
+}
+
+RC get_rate(void *ctx, char *reply, usize sz) {
+    Board *board = ctx;
+    snprintf(reply, sz, "%.0f", board->rate);
+    return RC_OK;
+}
+
+RC get_level(void *ctx, char *reply, usize sz) {
+    Board *board = ctx;
+    snprintf(reply, sz, "%.3f", board->level);
+    return RC_OK;
+}
+
+RC get_scale(void *ctx, char *reply, usize sz) {
+    Board *board = ctx;
+    snprintf(reply, sz, "%.3f", board->scale);
+    return RC_OK;
+}
+
+RC get_measurements(void *ctx, char *reply, usize sz) {
+    snprintf(reply, sz, "0.150,3.150,1.650,3.000,1000.0");
+    return RC_OK;
+}
+
+void reply(void *ctx, const char *text) {
+    Board *board = ctx;
+    ++board->replies;
+    if (board->echo) {
+        printf("%s\n", text);
+    }
+}
+
+u32 random_u32(void) {
+    // xorshift32, so runs are repeatable whatever the C library
+    RNG_STATE ^= RNG_STATE << 13;
+    RNG_STATE ^= RNG_STATE >> 17;
+    RNG_STATE ^= RNG_STATE << 5;
+    return RNG_STATE;
+}
+
+double uniform(void) { return random_u32() / 4294967296.0; }
+
+int fuzz_bytes(CommandParser *parser, usize iterations) {
+    // pieces of real commands mixed with junk, so input gets past the
+    // header lookup often enough to reach the number parser and handlers
+    static const char *PIECES[] = {
+        ":",     "ACQ", "acquire", "RATE", "TRIG", "lev", "DISP", "SCAL",
+        "MEAS",  "?",   " ",       "\t",   ";",    "\n",  "\r",   "1e6",
+        "-1.25", ".",   "e",       "+",    "9999999999999999999",
+    };
+    usize npieces = sizeof(PIECES) / sizeof(PIECES[0]);
+    u8 buf[4 * COMMAND_LINE_MAX];
+    for (usize it = 0; it < iterations; ++it) {
+        usize len = 0;
+        while (len < sizeof(buf) - 32 && uniform() < 0.97) {
+            if (uniform() < 0.2) {
+                buf[len++] = random_u32();
+                continue;
+            }
+            const char *piece = PIECES[random_u32() % npieces];
+            usize n = strlen(piece);
+            memcpy(buf + len, piece, n);
+            len += n;
+        }
+        // fed in random pieces, as reads from the port would arrive
+        for (usize at = 0; at < len;) {
+            usize n = 1 + random_u32() % (len - at);
+            command_feed(parser, buf + at, n);
+            at += n;
+        }
+        if (parser->len >= COMMAND_LINE_MAX ||
+            memchr(parser->out, '\0', sizeof(parser->out)) == NULL) {
+            fprintf(stderr, "parser state out of bounds after %zu\n", it);
+            return 1;
+        }
+    }
+    // finish any line left over so the next check starts clean
+    command_feed(parser, (const u8 *)"\n", 1);
+    return 0;
+}
+
+int fuzz_spellings(CommandParser *parser, Board *board, usize iterations) {
+    for (usize it = 0; it < iterations; ++it) {
+        // every command but the query only one can be set
+        const Command *command = &COMMANDS[random_u32() % (NCOMMANDS - 1)];
+        char line[COMMAND_LINE_MAX];
+        usize len = spell(command->header, line);
+        double value = 1 + uniform() * 1e6;
+        len += snprintf(line + len, sizeof(line) - len, "%s%.6g\n",
+                        uniform() < 0.5 ? " " : " \t ", value);
+        usize sets = board->sets;
+        usize replies = board->replies;
+        command_feed(parser, (const u8 *)line, len);
+        char expected[32];
+        snprintf(expected, sizeof(expected), "%.6g", value);
+        if (board->sets != sets + 1 || board->replies != replies ||
+            fabs(board->value - strtod(expected, NULL)) > 1e-9 * value) {
+            fprintf(stderr, "not executed as sent: %s", line);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int fuzz_numbers(usize iterations) {
+    static const char *FORMATS[] = {"%.*e", "%.*f", "%.*g", "%.*E"};
+    for (usize it = 0; it < iterations; ++it) {
+        char text[64];
+        double value = (uniform() - 0.5) * pow(10, (int)(uniform() * 16) - 8);
+        const char *format = FORMATS[random_u32() % 4];
+        snprintf(text, sizeof(text), format, (int)(random_u32() % 10), value);
+        double parsed;
+        double expected = strtod(text, NULL);
+        if (command_parse_number(text, &parsed) != RC_OK ||
+            fabs(parsed - expected) > 1e-12 * fabs(expected)) {
+            fprintf(stderr, "%s parsed as %.17g, not %.17g\n", text, parsed,
+                    expected);
+            return 1;
+        }
+    }
+    // and junk strtod would partly accept never does
+    static const char *BAD[] = {"",   "-",  ".",    "e5",  "1e",  "1e+",
+                                "1x", "1.2.3", "--1", "1e99", " 1", "inf"};
+    for (usize i = 0; i < sizeof(BAD) / sizeof(BAD[0]); ++i) {
+        double parsed;
+        if (command_parse_number(BAD[i], &parsed) == RC_OK) {
+            fprintf(stderr, "\"%s\" parsed as %g\n", BAD[i], parsed);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+usize spell(const char *pattern, char *out) {
+    // short or long form of each node in random case, colon or not in front
+    usize len = 0;
+    if (*pattern == ':') {
+        ++pattern;
+    }
+    if (uniform() < 0.7) {
+        out[len++] = ':';
+    }
+    while (*pattern) {
+        usize plen = strcspn(pattern, ":");
+        usize slen = 0;
+        while (slen < plen && !(pattern[slen] >= 'a' && pattern[slen] <= 'z')) {
+            ++slen;
+        }
+        usize n = uniform() < 0.5 ? slen : plen;
+        for (usize i = 0; i < n; ++i) {
+            char c = pattern[i];
+            c = uniform() < 0.5 ? (c >= 'a' && c <= 'z' ? c - 32 : c)
+                                : (c >= 'A' && c <= 'Z' ? c + 32 : c);
+            out[len++] = c;
+        }
+        pattern += plen;
+        if (*pattern == ':') {
+            out[len++] = *pattern++;
+        }
+    }
+    return len;
+}
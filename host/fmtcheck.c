@@ -0,0 +1,406 @@
+/**
+ * fmtcheck.c
+ *
+ * Checks the fmt module against the C library's snprintf: integers, fixed
+ * point and doubles over random values at every precision, voltages read
+ * back against the value they were made from, the escape sequences, and
+ * the handling of buffers that are too small. Where fmt_double is
+ * documented to differ from printf, the cases are counted rather than
+ * failed. Then times the formatting the display does both ways.
+ */
+#include "defs.h"
+#include "fmt.h"
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DECIMALS_MAX 9
+#define OUT_MAX 64
+#define TIMING_CALLS 1000000
+
+typedef struct {
+    usize count;
+    u32 seed;
+    _Bool verbose;
+} Options;
+
+typedef struct {
+    usize checked;
+    usize failed;
+    // fmt_double outputs that differ from printf as the header describes
+    usize ties;
+    usize negative_zeros;
+    usize out_of_range;
+} Results;
+
+static u32 RNG_STATE;
+
+static RC parse_options(int argc, char **argv, Options *opts);
+static void usage(const char *prog);
+static u32 random_u32(void);
+static double uniform(void);
+static double random_double(void);
+static void expect(Results *res, const char *what, const char *got,
+                   const char *want);
+static void check_ints(const Options *opts, Results *res);
+static void check_fixed(const Options *opts, Results *res);
+static void check_double(const Options *opts, Results *res, double value,
+                         u8 decimals);
+static void check_doubles(const Options *opts, Results *res);
+static void check_volts(const Options *opts, Results *res);
+static void check_escapes(Results *res);
+static void check_short_buffers(Results *res);
+static void timing(void);
+static double seconds(const struct timespec *start);
+
+int main(int argc, char **argv) {
+    Options opts;
+    if (parse_options(argc, argv, &opts) != RC_OK) {
+        usage(argv[0]);
+        return 1;
+    }
+    RNG_STATE = opts.seed;
+    Results res = {0};
+    check_ints(&opts, &res);
+    check_fixed(&opts, &res);
+    check_doubles(&opts, &res);
+    check_volts(&opts, &res);
+    check_escapes(&res);
+    check_short_buffers(&res);
+    printf("%zu checks, %zu failed\n", res.checked, res.failed);
+    printf("fmt_double as documented: %zu half-way cases rounded the "
+           "other way,\n  %zu negative zeros without a sign, %zu out of "
+           "range refused\n",
+           res.ties, res.negative_zeros, res.out_of_range);
+    if (res.failed) {
+        return 1;
+    }
+    timing();
+    return 0;
+}
+
+RC parse_options(int argc, char **argv, Options *opts) {
+    *opts = (Options){
+        .count = 1000000,
+        .seed = 1,
+    };
+    int opt;
+    while ((opt = getopt(argc, argv, "n:x:v")) != -1) {
+        switch (opt) {
+        case 'n':
+            opts->count = strtoul(optarg, NULL, 10);
+            break;
+        case 'x':
+            opts->seed = strtoul(optarg, NULL, 10);
+            break;
+        case 'v':
+            opts->verbose = 1;
+            break;
+        default:
+            return RC_INVALID_OPT;
+        }
+    }
+    if (optind != argc || opts->count == 0 || opts->seed == 0) {
+        return RC_INVALID_OPT;
+    }
+    return RC_OK;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-n count] [-x seed] [-v]\n"
+            "  -n  random values for each kind of check, default 1000000\n"
+            "  -v  print the fmt_double cases that differ as documented\n",
+            prog);
+}
+
+u32 random_u32(void) {
+    // xorshift32, so runs are repeatable whatever the C library
+    RNG_STATE ^= RNG_STATE << 13;
+    RNG_STATE ^= RNG_STATE >> 17;
+    RNG_STATE ^= RNG_STATE << 5;
+    return RNG_STATE;
+}
+
+double uniform(void) { return random_u32() / 4294967296.0; }
+
+double random_double(void) {
+    // spread over magnitudes from 1e-12 to 1e10, both signs, with some
+    // values on a short decimal grid so the half-way cases come up
+    double value = pow(10, -12 + 22 * uniform());
+    if (random_u32() % 4 == 0) {
+        value = (double)(random_u32() % 20001) / 1000;
+    }
+    return random_u32() & 1 ? -value : value;
+}
+
+void expect(Results *res, const char *what, const char *got,
+            const char *want) {
+    ++res->checked;
+    if (strcmp(got, want)) {
+        if (res->failed < 20) {
+            printf("%s: got \"%s\", want \"%s\"\n", what, got, want);
+        }
+        ++res->failed;
+    }
+}
+
+void check_ints(const Options *opts, Results *res) {
+    static const i32 EDGES[] = {0, 1, -1, 9, 10, -10, 2147483647,
+                                -2147483647 - 1};
+    char got[OUT_MAX], want[OUT_MAX], what[OUT_MAX];
+    for (usize i = 0; i < opts->count; ++i) {
+        // every digit count as often as any other
+        i32 value = i < sizeof(EDGES) / sizeof(EDGES[0])
+                        ? EDGES[i]
+                        : (i32)(random_u32() >> (random_u32() % 32));
+        snprintf(what, sizeof(what), "fmt_u32(%u)", (u32)value);
+        fmt_u32(got, sizeof(got), (u32)value);
+        snprintf(want, sizeof(want), "%u", (u32)value);
+        expect(res, what, got, want);
+        snprintf(what, sizeof(what), "fmt_i32(%d)", value);
+        fmt_i32(got, sizeof(got), value);
+        snprintf(want, sizeof(want), "%d", value);
+        expect(res, what, got, want);
+    }
+}
+
+void check_fixed(const Options *opts, Results *res) {
+    char got[OUT_MAX], want[OUT_MAX], what[OUT_MAX];
+    for (usize i = 0; i < opts->count; ++i) {
+        i32 value = (i32)(random_u32() >> (random_u32() % 32));
+        u8 decimals = random_u32() % (DECIMALS_MAX + 1);
+        // worked out in integers, so there is no rounding to disagree on
+        long long magnitude = llabs((long long)value);
+        long long scale = 1;
+        for (u8 d = 0; d < decimals; ++d) {
+            scale *= 10;
+        }
+        if (decimals) {
+            snprintf(want, sizeof(want), "%s%lld.%0*lld",
+                     value < 0 ? "-" : "", magnitude / scale, decimals,
+                     magnitude % scale);
+        } else {
+            snprintf(want, sizeof(want), "%d", value);
+        }
+        snprintf(what, sizeof(what), "fmt_fixed(%d, %u)", value, decimals);
+        fmt_fixed(got, sizeof(got), value, decimals);
+        expect(res, what, got, want);
+    }
+}
+
+void check_double(const Options *opts, Results *res, double value,
+                  u8 decimals) {
+    char got[OUT_MAX], want[OUT_MAX], what[OUT_MAX];
+    snprintf(what, sizeof(what), "fmt_double(%.17g, %u)", value, decimals);
+    usize len = fmt_double(got, sizeof(got), value, decimals);
+    snprintf(want, sizeof(want), "%.*f", decimals, value);
+    double scaled = fabs(value) * pow(10, decimals);
+    ++res->checked;
+    if (len == 0) {
+        // refused, which is only right past the end of the i32 range
+        if (floor(scaled + 0.5) >= 2147483647.0) {
+            ++res->out_of_range;
+        } else {
+            printf("%s: refused\n", what);
+            ++res->failed;
+        }
+        return;
+    }
+    if (strlen(got) != len) {
+        printf("%s: \"%s\" but returned %zu\n", what, got, len);
+        ++res->failed;
+        return;
+    }
+    if (strcmp(got, want) == 0) {
+        return;
+    }
+    // printf rounds the exact binary value, fmt the scaled double, so the
+    // two only part ways when it is within rounding error of a half
+    double frac = scaled - floor(scaled);
+    if (fabs(frac - 0.5) <= 4 * DBL_EPSILON * scaled) {
+        ++res->ties;
+    } else if (want[0] == '-' && strcmp(got, want + 1) == 0 &&
+               strspn(got, "0.") == len) {
+        ++res->negative_zeros;
+    } else {
+        printf("%s: got \"%s\", want \"%s\"\n", what, got, want);
+        ++res->failed;
+        return;
+    }
+    if (opts->verbose) {
+        printf("%s: \"%s\", printf \"%s\"\n", what, got, want);
+    }
+}
+
+void check_doubles(const Options *opts, Results *res) {
+    static const double EDGES[] = {0.0, -0.0, 0.15, 0.25, -0.04, 2.675,
+                                   123456.789, 2147.4836475, -2147.483648};
+    for (usize i = 0; i < sizeof(EDGES) / sizeof(EDGES[0]); ++i) {
+        for (u8 decimals = 0; decimals <= DECIMALS_MAX; ++decimals) {
+            check_double(opts, res, EDGES[i], decimals);
+        }
+    }
+    for (usize i = 0; i < opts->count; ++i) {
+        check_double(opts, res, random_double(),
+                     random_u32() % (DECIMALS_MAX + 1));
+    }
+}
+
+void check_volts(const Options *opts, Results *res) {
+    // there is no printf equivalent, so each result is read back and has to
+    // be the value to the requested significant digits, in the right unit
+    char got[OUT_MAX];
+    for (usize i = 0; i < opts->count; ++i) {
+        double volts = random_double() / 1e6;
+        u8 digits = 1 + random_u32() % 6;
+        ++res->checked;
+        usize len = fmt_volts(got, sizeof(got), volts, digits);
+        char *unit;
+        double read = strtod(got, &unit);
+        double scale = !strcmp(unit, "V")    ? 1
+                       : !strcmp(unit, "mV") ? 1e-3
+                       : !strcmp(unit, "uV") ? 1e-6
+                                             : 0;
+        // the integer part is kept whole and decimals make up the rest of
+        // the digits, so the last one is within half of itself. A mantissa
+        // is only below 1 in the smallest unit or for zero, and only 1000
+        // or more in the largest
+        const char *point = strchr(got, '.');
+        usize decimals = point != NULL && point < unit ? unit - point - 1 : 0;
+        double mantissa = fabs(read);
+        usize whole = mantissa < 10 ? 1 : (usize)log10(mantissa) + 1;
+        usize want = digits > whole ? digits - whole : 0;
+        _Bool ok = len > 0 && scale > 0 && decimals == want &&
+                   fabs(read - volts / scale) <=
+                       0.5 * pow(10, -(double)decimals) * (1 + 1e-9) &&
+                   (mantissa >= 1 || scale == 1e-6 || volts == 0) &&
+                   (mantissa < 1000 || scale == 1);
+        if (!ok) {
+            if (res->failed < 20) {
+                printf("fmt_volts(%.17g, %u): \"%s\"\n", volts, digits, got);
+            }
+            ++res->failed;
+        }
+    }
+}
+
+void check_escapes(Results *res) {
+    char got[OUT_MAX], want[OUT_MAX], what[OUT_MAX];
+    for (u32 n = 0; n < 1000; ++n) {
+        snprintf(what, sizeof(what), "fmt_csi(%u)", n);
+        fmt_csi(got, sizeof(got), n, 'C');
+        if (n == 1) {
+            snprintf(want, sizeof(want), "\033[C");
+        } else {
+            snprintf(want, sizeof(want), "\033[%uC", n);
+        }
+        expect(res, what, got, want);
+        snprintf(what, sizeof(what), "fmt_cursor(%u)", n);
+        fmt_cursor(got, sizeof(got), n, 1000 - n);
+        snprintf(want, sizeof(want), "\033[%u;%uH", n, 1000 - n);
+        expect(res, what, got, want);
+    }
+    for (u32 color = 0; color < 256; ++color) {
+        snprintf(what, sizeof(what), "fmt_color(%u)", color);
+        fmt_color(got, sizeof(got), color);
+        if (color == 0) {
+            snprintf(want, sizeof(want), "\033[0m");
+        } else if (color < 8) {
+            snprintf(want, sizeof(want), "\033[3%um", color);
+        } else if (color < 16) {
+            snprintf(want, sizeof(want), "\033[9%um", color - 8);
+        } else {
+            snprintf(want, sizeof(want), "\033[38;5;%um", color);
+        }
+        expect(res, what, got, want);
+    }
+}
+
+void check_short_buffers(Results *res) {
+    // every size short of the output fails cleanly, and an exact fit works
+    char got[OUT_MAX];
+    for (usize sz = 0; sz <= 12; ++sz) {
+        memset(got, 'x', sizeof(got));
+        usize expected = sz >= 12 ? 11 : 0;
+        ++res->checked;
+        if (fmt_i32(got, sz, -2147483647 - 1) != expected ||
+            (sz > 0 && expected == 0 && got[0] != '\0') || got[sz] != 'x') {
+            printf("fmt_i32 into %zu bytes\n", sz);
+            ++res->failed;
+        }
+        memset(got, 'x', sizeof(got));
+        expected = sz >= 10 ? 9 : 0;
+        ++res->checked;
+        if (fmt_double(got, sz, -3.14159, 6) != expected ||
+            (sz > 0 && expected == 0 && got[0] != '\0') || got[sz] != 'x') {
+            printf("fmt_double into %zu bytes\n", sz);
+            ++res->failed;
+        }
+    }
+}
+
+void timing(void) {
+    // the header, cursor and axis formatting the terminal does per frame
+    char buf[OUT_MAX];
+    volatile usize sink = 0;
+    struct timespec start;
+    double value = 0.123456;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (usize i = 0; i < TIMING_CALLS; ++i) {
+        sink += snprintf(buf, sizeof(buf), "(%.5lf) %-25s", value, "ch1");
+    }
+    double printf_header = seconds(&start);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (usize i = 0; i < TIMING_CALLS; ++i) {
+        usize len = 0;
+        buf[len++] = '(';
+        len += fmt_double(buf + len, sizeof(buf) - len, value, 5);
+        buf[len++] = ')';
+        buf[len++] = ' ';
+        memcpy(buf + len, "ch1", 4);
+        sink += fmt_pad(buf, sizeof(buf), len + 3, len + 25);
+    }
+    double fmt_header = seconds(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (u32 i = 0; i < TIMING_CALLS; ++i) {
+        sink += snprintf(buf, sizeof(buf), "\033[%u;%uH", i % 40, i % 120);
+    }
+    double printf_cursor = seconds(&start);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (u32 i = 0; i < TIMING_CALLS; ++i) {
+        sink += fmt_cursor(buf, sizeof(buf), i % 40, i % 120);
+    }
+    double fmt_cursor_time = seconds(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (usize i = 0; i < TIMING_CALLS; ++i) {
+        sink += snprintf(buf, sizeof(buf), "%.3lfV", value);
+    }
+    double printf_axis = seconds(&start);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (usize i = 0; i < TIMING_CALLS; ++i) {
+        sink += fmt_volts(buf, sizeof(buf), value, 4);
+    }
+    double fmt_axis = seconds(&start);
+
+    printf("ns per call on this host, snprintf -> fmt:\n");
+    printf("  header %6.1f -> %6.1f\n", 1e9 * printf_header / TIMING_CALLS,
+           1e9 * fmt_header / TIMING_CALLS);
+    printf("  cursor %6.1f -> %6.1f\n", 1e9 * printf_cursor / TIMING_CALLS,
+           1e9 * fmt_cursor_time / TIMING_CALLS);
+    printf("  axis   %6.1f -> %6.1f\n", 1e9 * printf_axis / TIMING_CALLS,
+           1e9 * fmt_axis / TIMING_CALLS);
+}
+
+double seconds(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec - start->tv_sec + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
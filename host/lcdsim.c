@@ -0,0 +1,323 @@
+/**
+ * lcdsim.c
+ *
+ * Runs the LCD backend on the host against the RAM framebuffer transport,
+ * feeding it synthetic channels, and reports the bytes each frame would have
+ * sent over SPI. Frames can be dumped as a stream of binary PPM images, e.g.
+ * for `ffplay -f image2pipe -vcodec ppm`, and every frame is hashed so a
+ * change to the rendering shows up as a different hash. As on the board, the
+ * channels can instead be drawn as persistence or as their zoomed out
+ * history, from samples converted to ADC counts.
+ */
+#include "defs.h"
+#include "display.h"
+#include "framebuffer.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// SPI2 clock set up by ili9341_init
+#define SPI_HZ 21000000
+#define FNV_OFFSET 0x811C9DC5u
+#define FNV_PRIME 0x01000193u
+// counts spanning the plot's +-2 V, and history kept for each channel
+#define COUNT_MAX 4095
+#define VOLTS_PER_COUNT (4.0 / COUNT_MAX)
+#define HISTORY_CAP (1 << 16)
+
+typedef struct {
+    usize frames;
+    usize channels;
+    // samples written per channel per frame, 0 for a whole sweep
+    usize block;
+    // trigger jitter in samples and noise in volts added to every sample
+    double jitter;
+    double noise;
+    // samples per column of history, 0 to draw the traces
+    usize zoom;
+    _Bool roll;
+    _Bool persist;
+    _Bool verbose;
+    const char *out;
+} Options;
+
+static u16 PIXELS[LCD_WIDTH * LCD_HEIGHT];
+static double SAMPLES[CHANNEL_COUNT_MAX][LCD_WIDTH];
+static u16 COUNTS[LCD_WIDTH];
+static u8 HITS[LCD_WIDTH * LCD_HEIGHT];
+static u16 HISTORY[CHANNEL_COUNT_MAX][HISTORY_CAP];
+static u32 LEVELS[CHANNEL_COUNT_MAX][HISTORY_CAP];
+static u32 RNG_STATE = 1;
+
+static RC parse_options(int argc, char **argv, Options *opts);
+static void usage(const char *prog);
+static double uniform(void);
+static double waveform(usize ch, double t);
+static void to_counts(const double *samples, usize sz, u16 *counts);
+static u32 hash_frame(const Framebuffer *fb, u32 hash);
+static int write_ppm(FILE *file, const Framebuffer *fb);
+
+int main(int argc, char **argv) {
+    Options opts;
+    if (parse_options(argc, argv, &opts) != RC_OK) {
+        usage(argv[0]);
+        return 1;
+    }
+    FILE *out = NULL;
+    if (opts.out != NULL) {
+        out = strcmp(opts.out, "-") ? fopen(opts.out, "wb") : stdout;
+        if (out == NULL) {
+            perror(opts.out);
+            return 1;
+        }
+    }
+
+    DisplayFile *display;
+    Framebuffer fb;
+    LcdTransport transport;
+    ChannelHandle hdls[CHANNEL_COUNT_MAX];
+    RC rc = display_open(LCD_DISPLAY, &display);
+    if (rc == RC_OK) {
+        rc = display_set_scale(display, 2.0);
+    }
+    if (rc == RC_OK && opts.roll) {
+        rc = display_set_sweep(display, SWEEP_ROLL);
+    }
+    if (rc == RC_OK && opts.zoom) {
+        rc = display_set_zoom(display, opts.zoom);
+    }
+    for (usize i = 0; rc == RC_OK && i < opts.channels; ++i) {
+        char name[CHANNEL_NAME_MAX];
+        snprintf(name, sizeof(name), "ch%zu", i + 1);
+        rc = display_add_channel(display, name, &hdls[i]);
+        // history is drawn from counts, 0 V being half way up them
+        if (rc == RC_OK && opts.zoom) {
+            rc = display_set_channel_offset(display, hdls[i], -2.0);
+        }
+    }
+    if (rc == RC_OK) {
+        rc = framebuffer_init(&fb, PIXELS, LCD_WIDTH, LCD_HEIGHT);
+    }
+    if (rc == RC_OK) {
+        framebuffer_transport(&fb, &transport);
+        rc = display_set_transport(display, &transport);
+    }
+    usize rows, cols;
+    if (rc == RC_OK) {
+        rc = display_plot_size(display, &rows, &cols);
+    }
+    Persistence persist;
+    if (rc == RC_OK) {
+        rc = persist_init(&persist, HITS, rows, cols);
+    }
+    if (rc == RC_OK) {
+        rc = persist_set_range(&persist, 0, COUNT_MAX);
+    }
+    Pyramid history[CHANNEL_COUNT_MAX];
+    for (usize ch = 0; rc == RC_OK && ch < opts.channels; ++ch) {
+        rc = pyramid_init(&history[ch], HISTORY[ch], LEVELS[ch], HISTORY_CAP);
+    }
+    if (rc != RC_OK) {
+        fprintf(stderr, "error setting up the display: %s\n", rcstr(rc));
+        return 1;
+    }
+    usize block = opts.block ? opts.block : cols;
+    if (block > cols) {
+        fprintf(stderr, "block is wider than the plot (%zu columns)\n", cols);
+        return 1;
+    }
+
+    // the first frame paints the whole panel and is reported on its own
+    usize first = 0, total = 0, most = 0, windows = 0;
+    u32 hash = FNV_OFFSET;
+    double t = 0;
+    for (usize frame = 0; frame < opts.frames; ++frame) {
+        // a sweep starts at a trigger that lands a little off each time,
+        // a rolling plot or the history just carries on from the last sample
+        double start = opts.roll || opts.zoom ? t : opts.jitter * uniform();
+        for (usize ch = 0; ch < opts.channels; ++ch) {
+            for (usize i = 0; i < block; ++i) {
+                SAMPLES[ch][i] = waveform(ch, start + i) +
+                                 opts.noise * (2 * uniform() - 1);
+            }
+        }
+        t += block;
+
+        usize bytes = fb.bytes;
+        usize moves = fb.windows;
+        for (usize ch = 0; ch < opts.channels && rc == RC_OK; ++ch) {
+            if (opts.zoom) {
+                to_counts(SAMPLES[ch], block, COUNTS);
+                pyramid_append(&history[ch], COUNTS, block);
+                rc = display_draw_history(display, hdls[ch], &history[ch],
+                                          VOLTS_PER_COUNT);
+            } else if (opts.persist) {
+                to_counts(SAMPLES[ch], block, COUNTS);
+                rc = persist_accumulate(&persist, COUNTS, block);
+            } else {
+                rc = display_writev(display, hdls[ch], SAMPLES[ch], block);
+            }
+        }
+        if (rc == RC_OK && opts.persist) {
+            rc = display_draw_persistence(display, &persist);
+        }
+        if (rc != RC_OK) {
+            fprintf(stderr, "error drawing frame %zu: %s\n", frame, rcstr(rc));
+            return 1;
+        }
+        bytes = fb.bytes - bytes;
+        moves = fb.windows - moves;
+        u32 frame_hash = hash_frame(&fb, FNV_OFFSET);
+        hash = (hash ^ frame_hash) * FNV_PRIME;
+        if (frame == 0) {
+            first = bytes;
+        } else {
+            total += bytes;
+            windows += moves;
+            most = bytes > most ? bytes : most;
+        }
+        if (opts.verbose) {
+            printf("frame %zu: %zu bytes, %zu windows, hash %08x\n", frame,
+                   bytes, moves, frame_hash);
+        }
+        if (out != NULL && write_ppm(out, &fb)) {
+            perror(opts.out);
+            return 1;
+        }
+    }
+
+    printf("first frame: %zu bytes\n", first);
+    if (opts.frames > 1) {
+        double avg = (double)total / (opts.frames - 1);
+        printf("later frames: %.0f bytes avg, %zu max, %.1f windows avg\n",
+               avg, most, (double)windows / (opts.frames - 1));
+        if (avg > 0) {
+            printf("SPI bound at %d MHz: %.0f fps\n", SPI_HZ / 1000000,
+                   SPI_HZ / 8 / avg);
+        }
+    }
+    printf("hash: %08x\n", hash);
+    if (out != NULL && out != stdout) {
+        fclose(out);
+    }
+    display_close(display);
+    return 0;
+}
+
+RC parse_options(int argc, char **argv, Options *opts) {
+    *opts = (Options){
+        .frames = 100,
+        .channels = 2,
+        .jitter = 1.0,
+        .noise = 0.02,
+    };
+    int opt;
+    while ((opt = getopt(argc, argv, "f:c:b:j:n:o:z:prv")) != -1) {
+        switch (opt) {
+        case 'f':
+            opts->frames = strtoul(optarg, NULL, 10);
+            break;
+        case 'c':
+            opts->channels = strtoul(optarg, NULL, 10);
+            break;
+        case 'b':
+            opts->block = strtoul(optarg, NULL, 10);
+            break;
+        case 'j':
+            opts->jitter = strtod(optarg, NULL);
+            break;
+        case 'n':
+            opts->noise = strtod(optarg, NULL);
+            break;
+        case 'o':
+            opts->out = optarg;
+            break;
+        case 'z':
+            opts->zoom = strtoul(optarg, NULL, 10);
+            break;
+        case 'p':
+            opts->persist = 1;
+            break;
+        case 'r':
+            opts->roll = 1;
+            break;
+        case 'v':
+            opts->verbose = 1;
+            break;
+        default:
+            return RC_INVALID_OPT;
+        }
+    }
+    if (optind != argc || opts->frames == 0 || opts->channels == 0 ||
+        opts->channels > CHANNEL_COUNT_MAX || (opts->zoom && opts->persist)) {
+        return RC_INVALID_OPT;
+    }
+    return RC_OK;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-f frames] [-c channels] [-b block] [-j jitter]\n"
+            "          [-n noise] [-o frames.ppm|-] [-z zoom | -p] [-r] [-v]\n"
+            "  -b  samples per channel per frame, default a whole sweep\n"
+            "  -j  trigger jitter in samples\n"
+            "  -n  noise in volts\n"
+            "  -o  append every frame to a PPM stream\n"
+            "  -z  draw the history at this many samples per column\n"
+            "  -p  draw the persistence of the traces\n"
+            "  -r  roll instead of sweeping\n"
+            "  -v  print bytes, windows and a hash for every frame\n",
+            prog);
+}
+
+double uniform(void) {
+    // xorshift32, so runs are repeatable whatever the C library
+    RNG_STATE ^= RNG_STATE << 13;
+    RNG_STATE ^= RNG_STATE >> 17;
+    RNG_STATE ^= RNG_STATE << 5;
+    return RNG_STATE / 4294967296.0;
+}
+
+double waveform(usize ch, double t) {
+    // alternating sines and squares, slower for each pair of channels
+    double period = 107.0 * (1 + ch / 2);
+    if (ch % 2 == 0) {
+        return 1.5 * sin(2 * M_PI * t / period);
+    }
+    return fmod(t, period) < period / 2 ? 0.8 : -0.8;
+}
+
+void to_counts(const double *samples, usize sz, u16 *counts) {
+    for (usize i = 0; i < sz; ++i) {
+        double count = round((samples[i] + 2.0) / VOLTS_PER_COUNT);
+        counts[i] = count < 0 ? 0 : count > COUNT_MAX ? COUNT_MAX : count;
+    }
+}
+
+u32 hash_frame(const Framebuffer *fb, u32 hash) {
+    // FNV-1a over the pixels, low byte first
+    for (usize i = 0; i < fb->width * fb->height; ++i) {
+        hash = (hash ^ (fb->px[i] & 0xFF)) * FNV_PRIME;
+        hash = (hash ^ (fb->px[i] >> 8)) * FNV_PRIME;
+    }
+    return hash;
+}
+
+int write_ppm(FILE *file, const Framebuffer *fb) {
+    u8 row[LCD_WIDTH * 3];
+    fprintf(file, "P6\n%zu %zu\n255\n", fb->width, fb->height);
+    for (usize y = 0; y < fb->height; ++y) {
+        for (usize x = 0; x < fb->width; ++x) {
+            u16 px = fb->px[y * fb->width + x];
+            row[3 * x] = ((px >> 11) * 255 + 15) / 31;
+            row[3 * x + 1] = (((px >> 5) & 0x3F) * 255 + 31) / 63;
+            row[3 * x + 2] = ((px & 0x1F) * 255 + 15) / 31;
+        }
+        if (fwrite(row, 3, fb->width, file) != fb->width) {
+            return 1;
+        }
+    }
+    return 0;
+}
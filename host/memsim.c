@@ -0,0 +1,443 @@
+/**
+ * memsim.c
+ *
+ * Runs the terminal renderer on the host through the headless
+ * MEMORY_DISPLAY backend. It first draws a few fixed scenes and compares
+ * their snapshots with the ones below, so a change to the rendering fails
+ * here before it reaches a terminal, then times frames of synthetic
+ * channels and reports the work each frame did from the draw statistics,
+ * or with -S the time per frame for every channel count.
+ *
+ * Needs DISPLAY_MEMORY defined, see the README.
+ */
+#include "defs.h"
+#include "display.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FNV_OFFSET 0x811C9DC5u
+#define FNV_PRIME 0x01000193u
+#define SCENE_COLS 32
+#define SCENE_ROWS 10
+#define SCALING_RUNS 5
+// enough for every cell of the largest display as a 3 byte code point
+#define SNAPSHOT_MAX (TERMINAL_ROWS_MAX * (3 * TERMINAL_COLS_MAX + 1) + 1)
+
+#ifndef DISPLAY_MEMORY
+#error "memsim needs the memory backend, build it with -DDISPLAY_MEMORY"
+#endif
+
+typedef struct {
+    usize frames;
+    usize channels;
+    // samples written per channel per frame, 0 for a whole sweep
+    usize block;
+    usize cols;
+    usize rows;
+    PlotStyle style;
+    SweepMode sweep;
+    // print the scenes' snapshots rather than checking them
+    _Bool print;
+    // time every channel count from one up rather than just channels
+    _Bool scaling;
+} Options;
+
+typedef struct {
+    const char *name;
+    PlotStyle style;
+    SweepMode sweep;
+    // samples written per channel, past a sweep to wrap or roll
+    usize samples;
+    // the snapshot itself where it is plain ASCII, else its FNV-1a hash
+    const char *expected;
+    u32 hash;
+} Scene;
+
+static const Scene SCENES[] = {
+    {
+        .name = "cells",
+        .style = PLOT_CELLS,
+        .sweep = SWEEP_WRAP,
+        .samples = 24,
+        .expected = "(574.0mV) sin                   \n"
+                    "2.000V*                         \n"
+                    "      *    ***             ***  \n"
+                    "      * ********        ********\n"
+                    "      *  *     *         *     *\n"
+                    "       *************************\n"
+                    "      *          *     *        \n"
+                    "      *         ********        \n"
+                    "      *            ***          \n"
+                    "-2.000V                         \n",
+    },
+    {
+        .name = "cells wrapped",
+        .style = PLOT_CELLS,
+        .sweep = SWEEP_WRAP,
+        .samples = 30,
+        .expected = "(-1.386V) sin                   \n"
+                    "2.000V*                         \n"
+                    "      *                         \n"
+                    "      *                         \n"
+                    "      *                         \n"
+                    "       *************************\n"
+                    "      *  *                      \n"
+                    "      * ******                  \n"
+                    "      *    ***                  \n"
+                    "-2.000V                         \n",
+    },
+    {
+        .name = "cells rolled",
+        .style = PLOT_CELLS,
+        .sweep = SWEEP_ROLL,
+        .samples = 30,
+        .expected = "(-1.386V) sin                   \n"
+                    "2.000V*                         \n"
+                    "      *        ***              \n"
+                    "      * **    *   ********      \n"
+                    "      *      *     *            \n"
+                    "       *************************\n"
+                    "      *    *         *          \n"
+                    "      *   ********    *   ******\n"
+                    "      * **             ***      \n"
+                    "-2.000V                         \n",
+    },
+    {
+        .name = "braille",
+        .style = PLOT_BRAILLE,
+        .sweep = SWEEP_WRAP,
+        .samples = 48,
+        .hash = 0x95d16f59,
+    },
+};
+
+#define SCENE_COUNT (sizeof(SCENES) / sizeof(SCENES[0]))
+
+static char SNAPSHOT[SNAPSHOT_MAX];
+static double SAMPLES[CHANNEL_COUNT_MAX][2 * TERMINAL_COLS_MAX];
+static u32 RNG_STATE = 1;
+
+static RC parse_options(int argc, char **argv, Options *opts);
+static void usage(const char *prog);
+static RC draw_scene(const Scene *scene, char *buf, usize sz);
+static int check_scenes(_Bool print);
+static int run_frames(const Options *opts, usize channels, usize *block,
+                      double *elapsed, DisplayStats *stats);
+static int benchmark(const Options *opts);
+static int scaling(const Options *opts);
+static double uniform(void);
+static double waveform(usize ch, double t);
+static u32 hash_text(const char *text);
+static double now(void);
+
+int main(int argc, char **argv) {
+    Options opts;
+    if (parse_options(argc, argv, &opts) != RC_OK) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (check_scenes(opts.print)) {
+        return 1;
+    }
+    if (opts.print) {
+        return 0;
+    }
+    return opts.scaling ? scaling(&opts) : benchmark(&opts);
+}
+
+RC parse_options(int argc, char **argv, Options *opts) {
+    *opts = (Options){
+        .frames = 20000,
+        .channels = 2,
+        .block = 72,
+        .cols = 80,
+        .rows = 25,
+        .style = PLOT_BRAILLE,
+        .sweep = SWEEP_WRAP,
+    };
+    int opt;
+    while ((opt = getopt(argc, argv, "f:c:b:x:y:srpS")) != -1) {
+        switch (opt) {
+        case 'f':
+            opts->frames = strtoul(optarg, NULL, 10);
+            break;
+        case 'c':
+            opts->channels = strtoul(optarg, NULL, 10);
+            break;
+        case 'b':
+            opts->block = strtoul(optarg, NULL, 10);
+            break;
+        case 'x':
+            opts->cols = strtoul(optarg, NULL, 10);
+            break;
+        case 'y':
+            opts->rows = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            opts->style = PLOT_CELLS;
+            break;
+        case 'r':
+            opts->sweep = SWEEP_ROLL;
+            break;
+        case 'p':
+            opts->print = 1;
+            break;
+        case 'S':
+            opts->scaling = 1;
+            break;
+        default:
+            return RC_INVALID_OPT;
+        }
+    }
+    if (optind != argc || opts->frames == 0 || opts->channels == 0 ||
+        opts->channels > CHANNEL_COUNT_MAX || opts->cols == 0 ||
+        opts->cols > TERMINAL_COLS_MAX || opts->rows == 0 ||
+        opts->rows > TERMINAL_ROWS_MAX) {
+        return RC_INVALID_OPT;
+    }
+    return RC_OK;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-f frames] [-c channels] [-b block] [-x cols]\n"
+            "          [-y rows] [-s] [-r] [-p] [-S]\n"
+            "  -b  samples per channel per frame, 0 for a whole sweep\n"
+            "  -s  plot in cells rather than Braille\n"
+            "  -r  roll instead of sweeping\n"
+            "  -p  print the test scenes' snapshots and hashes, and stop\n"
+            "  -S  time 1 to %d channels in turn\n",
+            prog, CHANNEL_COUNT_MAX);
+}
+
+RC draw_scene(const Scene *scene, char *buf, usize sz) {
+    DisplayFile *display;
+    ChannelHandle sine, square;
+    RC rc = display_open(MEMORY_DISPLAY, &display);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    rc = display_set_x(display, SCENE_COLS);
+    if (rc == RC_OK) {
+        rc = display_set_y(display, SCENE_ROWS);
+    }
+    if (rc == RC_OK) {
+        rc = display_set_scale(display, 2.0);
+    }
+    if (rc == RC_OK) {
+        rc = display_set_style(display, scene->style);
+    }
+    if (rc == RC_OK) {
+        rc = display_set_sweep(display, scene->sweep);
+    }
+    if (rc == RC_OK) {
+        rc = display_add_channel(display, "sin", &sine);
+    }
+    if (rc == RC_OK) {
+        rc = display_add_channel(display, "sq", &square);
+    }
+    if (rc == RC_OK) {
+        rc = display_redraw(display);
+    }
+    // a 16 sample period, so the scenes don't depend on libm rounding at
+    // the edges of a row
+    double a[2 * TERMINAL_COLS_MAX], b[2 * TERMINAL_COLS_MAX];
+    for (usize i = 0; i < scene->samples; ++i) {
+        a[i] = 1.5 * sin(2 * M_PI * i / 16.0);
+        b[i] = i % 16 < 8 ? 0.8 : -0.8;
+    }
+    if (rc == RC_OK) {
+        rc = display_writev(display, sine, a, scene->samples);
+    }
+    if (rc == RC_OK) {
+        rc = display_writev(display, square, b, scene->samples);
+    }
+    if (rc == RC_OK) {
+        rc = display_snapshot(display, buf, sz);
+    }
+    display_close(display);
+    return rc;
+}
+
+int check_scenes(_Bool print) {
+    int failed = 0;
+    for (usize i = 0; i < SCENE_COUNT; ++i) {
+        const Scene *scene = &SCENES[i];
+        RC rc = draw_scene(scene, SNAPSHOT, sizeof(SNAPSHOT));
+        if (rc != RC_OK) {
+            fprintf(stderr, "error drawing %s: %s\n", scene->name,
+                    rcstr(rc));
+            return 1;
+        }
+        u32 hash = hash_text(SNAPSHOT);
+        if (print) {
+            printf("%s, hash %08x:\n%s\n", scene->name, hash, SNAPSHOT);
+            continue;
+        }
+        _Bool ok = scene->expected != NULL
+                       ? strcmp(SNAPSHOT, scene->expected) == 0
+                       : hash == scene->hash;
+        printf("snapshot %s: %s\n", scene->name, ok ? "ok" : "FAILED");
+        if (!ok) {
+            printf("got, hash %08x:\n%s", hash, SNAPSHOT);
+            if (scene->expected != NULL) {
+                printf("expected:\n%s", scene->expected);
+            }
+            failed = 1;
+        }
+    }
+    return failed;
+}
+
+int run_frames(const Options *opts, usize channels, usize *block,
+               double *elapsed, DisplayStats *stats) {
+    DisplayFile *display;
+    ChannelHandle hdls[CHANNEL_COUNT_MAX];
+    RC rc = display_open(MEMORY_DISPLAY, &display);
+    if (rc == RC_OK) {
+        rc = display_set_x(display, opts->cols);
+    }
+    if (rc == RC_OK) {
+        rc = display_set_y(display, opts->rows);
+    }
+    if (rc == RC_OK) {
+        rc = display_set_scale(display, 2.0);
+    }
+    if (rc == RC_OK) {
+        rc = display_set_style(display, opts->style);
+    }
+    if (rc == RC_OK) {
+        rc = display_set_sweep(display, opts->sweep);
+    }
+    for (usize i = 0; rc == RC_OK && i < channels; ++i) {
+        char name[CHANNEL_NAME_MAX];
+        snprintf(name, sizeof(name), "ch%u", (unsigned)(i + 1));
+        rc = display_add_channel(display, name, &hdls[i]);
+    }
+    if (rc == RC_OK) {
+        rc = display_redraw(display);
+    }
+    usize rows, cols;
+    if (rc == RC_OK) {
+        rc = display_plot_size(display, &rows, &cols);
+    }
+    if (rc != RC_OK) {
+        fprintf(stderr, "error setting up the display: %s\n", rcstr(rc));
+        return 1;
+    }
+    *block = opts->block ? opts->block : cols;
+    if (*block > sizeof(SAMPLES[0]) / sizeof(SAMPLES[0][0])) {
+        fprintf(stderr, "block is more than %zu samples\n",
+                sizeof(SAMPLES[0]) / sizeof(SAMPLES[0][0]));
+        return 1;
+    }
+
+    // the samples are made up front so only the display is timed
+    for (usize ch = 0; ch < channels; ++ch) {
+        for (usize i = 0; i < *block; ++i) {
+            SAMPLES[ch][i] = waveform(ch, i) + 0.02 * (2 * uniform() - 1);
+        }
+    }
+    display_reset_stats(display);
+    double start = now();
+    for (usize frame = 0; frame < opts->frames && rc == RC_OK; ++frame) {
+        for (usize ch = 0; ch < channels && rc == RC_OK; ++ch) {
+            rc = display_writev(display, hdls[ch], SAMPLES[ch], *block);
+        }
+    }
+    *elapsed = now() - start;
+    if (rc == RC_OK) {
+        rc = display_stats(display, stats);
+    }
+    if (rc != RC_OK) {
+        fprintf(stderr, "error drawing: %s\n", rcstr(rc));
+        return 1;
+    }
+    display_close(display);
+    return 0;
+}
+
+int benchmark(const Options *opts) {
+    usize block;
+    double elapsed;
+    DisplayStats stats;
+    if (run_frames(opts, opts->channels, &block, &elapsed, &stats)) {
+        return 1;
+    }
+    double frames = opts->frames;
+    printf("%zux%zu %s, %zu channels, %zu samples per channel per frame\n",
+           opts->cols, opts->rows,
+           opts->style == PLOT_BRAILLE ? "braille" : "cells", opts->channels,
+           block);
+    printf("%.0f frames/s, %.2f us per frame\n", frames / elapsed,
+           1e6 * elapsed / frames);
+    printf("per frame: %.1f bytes, %.1f glyphs, %.1f cursor moves, "
+           "%.1f colour changes, %.1f flushes\n",
+           stats.bytes / frames, stats.glyphs / frames,
+           stats.cursor_moves / frames, stats.color_changes / frames,
+           stats.flushes / frames);
+    return 0;
+}
+
+int scaling(const Options *opts) {
+    // the same frames with every channel count, to show the cost grows in
+    // step with the channels drawn and not faster
+    printf("%zux%zu %s, %zu frames\n", opts->cols, opts->rows,
+           opts->style == PLOT_BRAILLE ? "braille" : "cells", opts->frames);
+    printf("channels  us/frame  us/channel  bytes/frame  vs one channel\n");
+    double first = 0;
+    for (usize channels = 1; channels <= CHANNEL_COUNT_MAX; ++channels) {
+        // the best of a few runs, as other work on the host only adds time
+        double best = 0;
+        DisplayStats stats;
+        for (usize run = 0; run < SCALING_RUNS; ++run) {
+            usize block;
+            double elapsed;
+            if (run_frames(opts, channels, &block, &elapsed, &stats)) {
+                return 1;
+            }
+            best = run == 0 || elapsed < best ? elapsed : best;
+        }
+        double per_frame = 1e6 * best / opts->frames;
+        first = channels == 1 ? per_frame : first;
+        printf("%8zu  %8.2f  %10.2f  %11.1f  %13.2fx\n", channels, per_frame,
+               per_frame / channels, (double)stats.bytes / opts->frames,
+               per_frame / first);
+    }
+    return 0;
+}
+
+double uniform(void) {
+    // xorshift32, so runs are repeatable whatever the C library
+    RNG_STATE ^= RNG_STATE << 13;
+    RNG_STATE ^= RNG_STATE >> 17;
+    RNG_STATE ^= RNG_STATE << 5;
+    return RNG_STATE / 4294967296.0;
+}
+
+double waveform(usize ch, double t) {
+    // alternating sines and squares, slower for each pair of channels
+    double period = 107.0 * (1 + ch / 2);
+    if (ch % 2 == 0) {
+        return 1.5 * sin(2 * M_PI * t / period);
+    }
+    return fmod(t, period) < period / 2 ? 0.8 : -0.8;
+}
+
+u32 hash_text(const char *text) {
+    u32 hash = FNV_OFFSET;
+    for (; *text != '\0'; ++text) {
+        hash = (hash ^ (u8)*text) * FNV_PRIME;
+    }
+    return hash;
+}
+
+double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
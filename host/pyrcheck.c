@@ -0,0 +1,257 @@
+/**
+ * pyrcheck.c
+ *
+ * Checks the min/max pyramid against brute force: for rings of random size,
+ * appends random signals in pieces of random size, anything up to four
+ * times round the ring, then reads random spans across a random number of
+ * columns and compares every column with the min and max of the samples it
+ * covers, worked out from the whole signal. Then times appends, and reads
+ * of spans up to a million samples, against a linear scan.
+ */
+#include "defs.h"
+#include "pyramid.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CAP_LOG2_MAX 16
+#define COLS_MAX 320
+#define TIMING_CAP (1u << 20)
+#define TIMING_COLS 240
+#define TIMING_READS 10000
+
+typedef struct {
+    usize cases;
+    // reads checked in each case
+    usize reads;
+    u32 seed;
+} Options;
+
+static u32 RNG_STATE;
+static u16 LO[COLS_MAX];
+static u16 HI[COLS_MAX];
+
+static RC parse_options(int argc, char **argv, Options *opts);
+static void usage(const char *prog);
+static u32 random_u32(void);
+static double uniform(void);
+static void generate(u16 *samples, usize sz);
+static int check_case(const Options *opts, usize n, usize *reads);
+static int timing(void);
+static double seconds(const struct timespec *start);
+
+int main(int argc, char **argv) {
+    Options opts;
+    if (parse_options(argc, argv, &opts) != RC_OK) {
+        usage(argv[0]);
+        return 1;
+    }
+    RNG_STATE = opts.seed;
+    usize reads = 0, failed = 0;
+    for (usize n = 0; n < opts.cases; ++n) {
+        failed += check_case(&opts, n, &reads);
+    }
+    printf("%zu of %zu cases passed, %zu reads checked\n",
+           opts.cases - failed, opts.cases, reads);
+    if (failed) {
+        return 1;
+    }
+    return timing();
+}
+
+RC parse_options(int argc, char **argv, Options *opts) {
+    *opts = (Options){
+        .cases = 1000,
+        .reads = 50,
+        .seed = 1,
+    };
+    int opt;
+    while ((opt = getopt(argc, argv, "n:r:x:")) != -1) {
+        switch (opt) {
+        case 'n':
+            opts->cases = strtoul(optarg, NULL, 10);
+            break;
+        case 'r':
+            opts->reads = strtoul(optarg, NULL, 10);
+            break;
+        case 'x':
+            opts->seed = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            return RC_INVALID_OPT;
+        }
+    }
+    if (optind != argc || opts->cases == 0 || opts->seed == 0) {
+        return RC_INVALID_OPT;
+    }
+    return RC_OK;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-n cases] [-r reads] [-x seed]\n"
+            "  -n  rings to fill and check, default 1000\n"
+            "  -r  random reads checked on each ring, default 50\n",
+            prog);
+}
+
+u32 random_u32(void) {
+    // xorshift32, so runs are repeatable whatever the C library
+    RNG_STATE ^= RNG_STATE << 13;
+    RNG_STATE ^= RNG_STATE >> 17;
+    RNG_STATE ^= RNG_STATE << 5;
+    return RNG_STATE;
+}
+
+double uniform(void) { return random_u32() / 4294967296.0; }
+
+void generate(u16 *samples, usize sz) {
+    // a 12 bit random walk with the odd spike, so the extremes of a span
+    // can sit anywhere in it, including a single sample
+    i32 x = random_u32() & 0xFFF;
+    for (usize i = 0; i < sz; ++i) {
+        x += (i32)(random_u32() % 33) - 16;
+        x = x < 0 ? 0 : x > 0xFFF ? 0xFFF : x;
+        samples[i] = random_u32() % 500 == 0 ? random_u32() & 0xFFF : (u16)x;
+    }
+}
+
+int check_case(const Options *opts, usize n, usize *reads) {
+    usize cap = 2u << (random_u32() % CAP_LOG2_MAX);
+    // from part of a ring up to a few times round it
+    usize total = 1 + (usize)(uniform() * 4 * cap);
+    u16 *signal = malloc(total * sizeof(u16));
+    u16 *samples = malloc(cap * sizeof(u16));
+    u32 *levels = malloc(cap * sizeof(u32));
+    if (signal == NULL || samples == NULL || levels == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    generate(signal, total);
+
+    Pyramid pyr;
+    RC rc = pyramid_init(&pyr, samples, levels, cap);
+    for (usize at = 0; rc == RC_OK && at < total;) {
+        usize piece = 1 + random_u32() % (cap < 1000 ? cap : 1000);
+        piece = piece < total - at ? piece : total - at;
+        pyramid_append(&pyr, signal + at, piece);
+        at += piece;
+    }
+    u64 first, end;
+    pyramid_bounds(&pyr, &first, &end);
+
+    int failed = rc != RC_OK || end != total;
+    for (usize r = 0; !failed && r < opts->reads; ++r) {
+        u64 avail = end - first;
+        usize cols = 1 + random_u32() % COLS_MAX;
+        if (cols > avail) {
+            cols = avail;
+        }
+        u64 span = cols + (u64)(uniform() * (avail - cols + 1));
+        u64 start = first + (u64)(uniform() * (avail - span + 1));
+        rc = pyramid_read(&pyr, start, span, LO, HI, cols);
+        if (rc != RC_OK) {
+            fprintf(stderr, "case %zu: read of %llu at %llu: %s\n", n,
+                    (unsigned long long)span, (unsigned long long)start,
+                    rcstr(rc));
+            failed = 1;
+            break;
+        }
+        ++*reads;
+        // the level pyramid_read settles on, and each column widened out to
+        // whole entries of it, as the header describes
+        u64 per_col = span / cols;
+        usize level = 0;
+        while (level + 1 < pyr.nlevels && (2ull << level) <= per_col) {
+            ++level;
+        }
+        for (usize col = 0; col < cols; ++col) {
+            u64 a = start + span * col / cols;
+            u64 b = start + span * (col + 1) / cols;
+            a = a >> level << level;
+            b = ((b - 1) >> level << level) + (1ull << level);
+            b = b < end ? b : end;
+            u16 lo = 0xFFFF, hi = 0;
+            for (u64 i = a; i < b; ++i) {
+                lo = signal[i] < lo ? signal[i] : lo;
+                hi = signal[i] > hi ? signal[i] : hi;
+            }
+            if (LO[col] != lo || HI[col] != hi) {
+                fprintf(stderr,
+                        "case %zu: cap %zu, %llu samples at %llu across "
+                        "%zu columns: column %zu is %u..%u, should be "
+                        "%u..%u\n",
+                        n, cap, (unsigned long long)span,
+                        (unsigned long long)start, cols, col, LO[col],
+                        HI[col], lo, hi);
+                failed = 1;
+                break;
+            }
+        }
+    }
+    free(signal);
+    free(samples);
+    free(levels);
+    return failed;
+}
+
+int timing(void) {
+    u16 *samples = malloc(TIMING_CAP * sizeof(u16));
+    u32 *levels = malloc(TIMING_CAP * sizeof(u32));
+    u16 *signal = malloc(4 * TIMING_CAP * sizeof(u16));
+    if (samples == NULL || levels == NULL || signal == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    generate(signal, 4 * TIMING_CAP);
+
+    Pyramid pyr;
+    pyramid_init(&pyr, samples, levels, TIMING_CAP);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    // in blocks, as the board appends a buffer at a time
+    for (usize at = 0; at < 4 * TIMING_CAP; at += 256) {
+        pyramid_append(&pyr, signal + at, 256);
+    }
+    printf("append: %.2f ns per sample\n",
+           1e9 * seconds(&start) / (4 * TIMING_CAP));
+
+    u64 first, end;
+    pyramid_bounds(&pyr, &first, &end);
+    // kept so the compiler can't drop the reads being timed
+    volatile u32 sink = 0;
+    for (u64 span = TIMING_COLS; span <= TIMING_CAP; span *= 4) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (usize r = 0; r < TIMING_READS; ++r) {
+            pyramid_read(&pyr, end - span, span, LO, HI, TIMING_COLS);
+            sink += LO[r % TIMING_COLS];
+        }
+        printf("read %7llu samples across %d columns: %.2f us\n",
+               (unsigned long long)span, TIMING_COLS,
+               1e6 * seconds(&start) / TIMING_READS);
+    }
+    // what the same widest read costs without the pyramid
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (usize r = 0; r < 100; ++r) {
+        u16 lo = 0xFFFF, hi = 0;
+        for (usize i = 0; i < TIMING_CAP; ++i) {
+            lo = samples[i] < lo ? samples[i] : lo;
+            hi = samples[i] > hi ? samples[i] : hi;
+        }
+        sink += lo + hi;
+    }
+    printf("linear scan of %u samples: %.2f us\n", TIMING_CAP,
+           1e6 * seconds(&start) / 100);
+    free(samples);
+    free(levels);
+    free(signal);
+    return 0;
+}
+
+double seconds(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec - start->tv_sec + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
@@ -0,0 +1,199 @@
+/**
+ * ricebench.c
+ *
+ * Compresses synthetic sine, square and noise signals a stream frame at a
+ * time, checks every block decodes back to the same samples, and reports
+ * the compression against 12 bit packing with the time taken per sample on
+ * this machine. Cycles on the board are reported by the firmware itself.
+ */
+#define _GNU_SOURCE
+#include "defs.h"
+#include "rice.h"
+#include "stream.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef enum {
+    SIGNAL_SINE,
+    SIGNAL_SQUARE,
+    SIGNAL_NOISE,
+    SIGNAL_COUNT,
+} Signal;
+
+static const char *SIGNAL_NAMES[SIGNAL_COUNT] = {"sine", "square", "noise"};
+
+typedef struct {
+    usize blocks;
+    usize samples;
+    u32 rate;
+    double freq;
+    // noise in LSBs added to the sine and square, as an ADC would
+    double noise;
+    usize repeat;
+} Options;
+
+static u16 SAMPLES[STREAM_SAMPLES_MAX];
+static u16 DECODED[STREAM_SAMPLES_MAX];
+static u8 OUT[STREAM_PAYLOAD_SZ(STREAM_SAMPLES_MAX)];
+static u32 RNG_STATE = 1;
+
+static RC parse_options(int argc, char **argv, Options *opts);
+static void usage(const char *prog);
+static double uniform(void);
+static void generate(Signal signal, const Options *opts, usize block);
+static double now(void);
+
+int main(int argc, char **argv) {
+    Options opts;
+    if (parse_options(argc, argv, &opts) != RC_OK) {
+        usage(argv[0]);
+        return 1;
+    }
+    printf("%zu blocks of %zu samples at %lu Hz, %.0f Hz signal, "
+           "+-%.1f LSB noise\n",
+           opts.blocks, opts.samples, (unsigned long)opts.rate, opts.freq,
+           opts.noise);
+    printf("%-7s %9s %9s %7s %7s %9s %9s\n", "signal", "packed", "coded",
+           "ratio", "frames", "enc ns/s", "dec ns/s");
+
+    usize packed_sz = STREAM_PAYLOAD_SZ(opts.samples);
+    for (Signal signal = 0; signal < SIGNAL_COUNT; ++signal) {
+        RNG_STATE = 1;
+        u64 packed = 0, coded = 0;
+        usize rice_blocks = 0;
+        double enc = 0, dec = 0;
+        for (usize block = 0; block < opts.blocks; ++block) {
+            generate(signal, &opts, block);
+            usize len = 0;
+            RC rc = RC_OK;
+            double start = now();
+            for (usize r = 0; r < opts.repeat; ++r) {
+                // as stream_encode does, only a saving is worth sending
+                rc = rice_encode(SAMPLES, opts.samples, OUT,
+                                 packed_sz - STREAM_RICE_LEN_SZ - 1, &len);
+            }
+            enc += now() - start;
+            packed += packed_sz;
+            if (rc != RC_OK) {
+                coded += packed_sz;
+                continue;
+            }
+            coded += STREAM_RICE_LEN_SZ + len;
+            ++rice_blocks;
+
+            start = now();
+            for (usize r = 0; r < opts.repeat && rc == RC_OK; ++r) {
+                rc = rice_decode(OUT, len, opts.samples, DECODED);
+            }
+            dec += now() - start;
+            if (rc != RC_OK ||
+                memcmp(SAMPLES, DECODED, opts.samples * sizeof(u16))) {
+                fprintf(stderr, "%s block %zu doesn't round trip\n",
+                        SIGNAL_NAMES[signal], block);
+                return 1;
+            }
+        }
+        double n = (double)opts.blocks * opts.samples * opts.repeat;
+        double dec_n = (double)rice_blocks * opts.samples * opts.repeat;
+        printf("%-7s %9llu %9llu %7.3f %3zu/%-3zu %9.2f %9.2f\n",
+               SIGNAL_NAMES[signal], (unsigned long long)packed,
+               (unsigned long long)coded, (double)packed / coded,
+               rice_blocks, opts.blocks, 1e9 * enc / n,
+               dec_n > 0 ? 1e9 * dec / dec_n : 0);
+    }
+    return 0;
+}
+
+RC parse_options(int argc, char **argv, Options *opts) {
+    *opts = (Options){
+        .blocks = 400,
+        .samples = 256,
+        .rate = 100000,
+        .freq = 1000,
+        .noise = 2,
+        .repeat = 20,
+    };
+    int opt;
+    while ((opt = getopt(argc, argv, "b:s:r:f:a:t:")) != -1) {
+        switch (opt) {
+        case 'b':
+            opts->blocks = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            opts->samples = strtoul(optarg, NULL, 10);
+            break;
+        case 'r':
+            opts->rate = strtoul(optarg, NULL, 10);
+            break;
+        case 'f':
+            opts->freq = strtod(optarg, NULL);
+            break;
+        case 'a':
+            opts->noise = strtod(optarg, NULL);
+            break;
+        case 't':
+            opts->repeat = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            return RC_INVALID_OPT;
+        }
+    }
+    if (optind != argc || opts->blocks == 0 || opts->samples == 0 ||
+        opts->samples > STREAM_SAMPLES_MAX || opts->rate == 0 ||
+        opts->repeat == 0) {
+        return RC_INVALID_OPT;
+    }
+    return RC_OK;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-b blocks] [-s samples] [-r rate] [-f freq]\n"
+            "          [-a noise] [-t repeat]\n"
+            "  -a  noise in LSBs added to the sine and square\n"
+            "  -t  times each block is coded, for steadier timings\n",
+            prog);
+}
+
+double uniform(void) {
+    // xorshift32, so runs are repeatable whatever the C library
+    RNG_STATE ^= RNG_STATE << 13;
+    RNG_STATE ^= RNG_STATE >> 17;
+    RNG_STATE ^= RNG_STATE << 5;
+    return RNG_STATE / 4294967296.0;
+}
+
+void generate(Signal signal, const Options *opts, usize block) {
+    for (usize i = 0; i < opts->samples; ++i) {
+        double t = (double)(block * opts->samples + i) / opts->rate;
+        double phase = fmod(t * opts->freq, 1.0);
+        double value;
+        switch (signal) {
+        case SIGNAL_SINE:
+            value = 2048 + 1800 * sin(2 * M_PI * phase);
+            break;
+        case SIGNAL_SQUARE:
+            value = phase < 0.5 ? 3848 : 248;
+            break;
+        default:
+            // the whole range, which nothing can compress
+            value = 4096 * uniform();
+            break;
+        }
+        if (signal != SIGNAL_NOISE) {
+            value += opts->noise * (2 * uniform() - 1);
+        }
+        long sample = lround(value);
+        SAMPLES[i] = sample < 0 ? 0 : sample > 4095 ? 4095 : sample;
+    }
+}
+
+double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
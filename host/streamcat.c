@@ -0,0 +1,176 @@
+/**
+ * streamcat.c
+ *
+ * Reads the board's binary sample stream from a serial port, pseudo
+ * terminal or capture file, reports gaps and CRC errors as they happen and
+ * a summary at the end, and optionally writes the samples out as CSV.
+ */
+#include "defs.h"
+#include "stream.h"
+#include "streamdec.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+typedef struct {
+    u32 baud;
+    speed_t speed;
+} Baud;
+
+// rates the firmware can be asked for that termios has a constant for
+static const Baud BAUDS[] = {
+    {115200, B115200},   {230400, B230400},   {460800, B460800},
+    {921600, B921600},   {1000000, B1000000}, {1500000, B1500000},
+    {2000000, B2000000}, {2500000, B2500000}, {3000000, B3000000},
+    {3500000, B3500000}, {4000000, B4000000},
+};
+
+typedef struct {
+    u32 baud;
+    _Bool csv;
+    _Bool quiet;
+    const char *path;
+} Options;
+
+static StreamDecoder DECODER;
+static StreamFrame FRAME;
+
+static RC parse_options(int argc, char **argv, Options *opts);
+static void usage(const char *prog);
+static int set_raw(int fd, u32 baud);
+
+int main(int argc, char **argv) {
+    Options opts;
+    if (parse_options(argc, argv, &opts) != RC_OK) {
+        usage(argv[0]);
+        return 1;
+    }
+    int fd = open(opts.path, O_RDONLY | O_NOCTTY);
+    if (fd < 0) {
+        perror(opts.path);
+        return 1;
+    }
+    if (isatty(fd) && set_raw(fd, opts.baud)) {
+        fprintf(stderr, "%s: can't set raw mode at %u baud\n", opts.path,
+                opts.baud);
+        return 1;
+    }
+
+    streamdec_init(&DECODER);
+    if (opts.csv) {
+        printf("seq,index,value\n");
+    }
+    u8 buf[4096];
+    u64 crc_errors = 0;
+    for (;;) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        // a pseudo terminal whose other end has gone reads as EIO
+        if (n < 0 && errno != EIO) {
+            perror(opts.path);
+            return 1;
+        }
+        if (n <= 0) {
+            break;
+        }
+        usize taken = 0;
+        while (taken < (usize)n) {
+            taken += streamdec_push(&DECODER, buf + taken, n - taken);
+            while (streamdec_next(&DECODER, &FRAME) == RC_OK) {
+                if (FRAME.lost && !opts.quiet) {
+                    fprintf(stderr, "gap: %u frames before seq %u\n",
+                            FRAME.lost, FRAME.seq);
+                }
+                for (usize i = 0; opts.csv && i < FRAME.count; ++i) {
+                    printf("%u,%zu,%u\n", FRAME.seq, i, FRAME.samples[i]);
+                }
+            }
+            if (DECODER.stats.crc_errors != crc_errors && !opts.quiet) {
+                fprintf(stderr, "crc errors: %llu\n",
+                        (unsigned long long)DECODER.stats.crc_errors);
+            }
+            crc_errors = DECODER.stats.crc_errors;
+        }
+    }
+    close(fd);
+
+    const StreamDecoderStats *stats = &DECODER.stats;
+    fprintf(stderr,
+            "%llu bytes, %llu frames, %llu samples\n"
+            "lost %llu frames in %llu gaps, %llu crc errors, "
+            "%llu bytes skipped\n",
+            (unsigned long long)stats->bytes,
+            (unsigned long long)stats->frames,
+            (unsigned long long)stats->samples,
+            (unsigned long long)stats->lost, (unsigned long long)stats->gaps,
+            (unsigned long long)stats->crc_errors,
+            (unsigned long long)stats->skipped);
+    if (stats->payload_bytes > 0) {
+        // against 12 bit packing, 3 bytes for every 2 samples
+        fprintf(stderr, "payload %llu bytes, %.3fx smaller than packed\n",
+                (unsigned long long)stats->payload_bytes,
+                1.5 * stats->samples / stats->payload_bytes);
+    }
+    return 0;
+}
+
+RC parse_options(int argc, char **argv, Options *opts) {
+    *opts = (Options){.baud = 2000000};
+    int opt;
+    while ((opt = getopt(argc, argv, "b:cq")) != -1) {
+        switch (opt) {
+        case 'b':
+            opts->baud = strtoul(optarg, NULL, 10);
+            break;
+        case 'c':
+            opts->csv = 1;
+            break;
+        case 'q':
+            opts->quiet = 1;
+            break;
+        default:
+            return RC_INVALID_OPT;
+        }
+    }
+    if (optind != argc - 1) {
+        return RC_INVALID_OPT;
+    }
+    opts->path = argv[optind];
+    return RC_OK;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-b baud] [-c] [-q] port|file\n"
+            "  -b  baud rate when reading a serial port, default 2000000\n"
+            "  -c  write samples to stdout as CSV\n"
+            "  -q  only print the summary\n",
+            prog);
+}
+
+int set_raw(int fd, u32 baud) {
+    usize i = 0;
+    while (i < sizeof(BAUDS) / sizeof(BAUDS[0]) && BAUDS[i].baud != baud) {
+        ++i;
+    }
+    if (i == sizeof(BAUDS) / sizeof(BAUDS[0])) {
+        return 1;
+    }
+    struct termios tio;
+    if (tcgetattr(fd, &tio)) {
+        return 1;
+    }
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, BAUDS[i].speed);
+    cfsetospeed(&tio, BAUDS[i].speed);
+    // block until at least a byte is there
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    return tcsetattr(fd, TCSANOW, &tio);
+}
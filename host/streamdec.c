@@ -0,0 +1,125 @@
+#include "streamdec.h"
+#include "rice.h"
+#include <string.h>
+
+static void consume(StreamDecoder *dec, usize n);
+static _Bool find_sync(StreamDecoder *dec);
+static u16 get_u16(const u8 *in);
+static u32 get_u32(const u8 *in);
+
+void streamdec_init(StreamDecoder *dec) {
+    dec->len = 0;
+    dec->have_seq = 0;
+    dec->next_seq = 0;
+    memset(&dec->stats, 0, sizeof(dec->stats));
+}
+
+usize streamdec_push(StreamDecoder *dec, const u8 *bytes, usize sz) {
+    usize room = sizeof(dec->buf) - dec->len;
+    usize n = sz < room ? sz : room;
+    memcpy(dec->buf + dec->len, bytes, n);
+    dec->len += n;
+    dec->stats.bytes += n;
+    return n;
+}
+
+RC streamdec_next(StreamDecoder *dec, StreamFrame *frame) {
+    while (find_sync(dec)) {
+        if (dec->len < STREAM_HEADER_SZ) {
+            return RC_NOT_READY;
+        }
+        const u8 *in = dec->buf;
+        const u8 *payload = in + STREAM_HEADER_SZ;
+        u8 coding = in[2];
+        usize count = get_u16(in + 4);
+        usize payload_sz = STREAM_PAYLOAD_SZ(count);
+        if (coding == STREAM_CODING_RICE) {
+            if (dec->len < STREAM_HEADER_SZ + STREAM_RICE_LEN_SZ) {
+                return RC_NOT_READY;
+            }
+            // never longer than packing, or it would have been sent packed
+            usize rice_sz = get_u16(payload);
+            payload_sz = rice_sz > STREAM_RICE_LEN_SZ && rice_sz < payload_sz
+                             ? rice_sz
+                             : 0;
+        }
+        if ((coding != STREAM_CODING_PACKED && coding != STREAM_CODING_RICE) ||
+            in[3] == 0 || count == 0 || count > STREAM_SAMPLES_MAX ||
+            payload_sz == 0) {
+            // not a header after all
+            ++dec->stats.skipped;
+            consume(dec, 1);
+            continue;
+        }
+        usize body = STREAM_HEADER_SZ + payload_sz;
+        if (dec->len < body + STREAM_CRC_SZ) {
+            return RC_NOT_READY;
+        }
+        RC rc = RC_OK;
+        if (stream_crc16(STREAM_CRC_INIT, in, body) != get_u16(in + body)) {
+            rc = RC_INVALID_OPT;
+        } else if (coding == STREAM_CODING_RICE) {
+            rc = rice_decode(payload + STREAM_RICE_LEN_SZ,
+                             payload_sz - STREAM_RICE_LEN_SZ, count,
+                             frame->samples);
+        } else {
+            stream_unpack12(payload, count, frame->samples);
+        }
+        if (rc != RC_OK) {
+            // a Rice payload that won't decode despite its CRC is as bad
+            ++dec->stats.crc_errors;
+            ++dec->stats.skipped;
+            consume(dec, 1);
+            continue;
+        }
+
+        frame->channel_mask = in[3];
+        frame->seq = get_u32(in + 6);
+        frame->sample_rate = get_u32(in + 10);
+        frame->timestamp = get_u32(in + 14);
+        frame->coding = coding;
+        frame->count = count;
+        // the sequence wraps, so a frame from before the last one reads as
+        // a long gap rather than going unnoticed
+        frame->lost = dec->have_seq ? frame->seq - dec->next_seq : 0;
+        if (frame->lost) {
+            dec->stats.lost += frame->lost;
+            ++dec->stats.gaps;
+        }
+        dec->have_seq = 1;
+        dec->next_seq = frame->seq + 1;
+        ++dec->stats.frames;
+        dec->stats.samples += count;
+        dec->stats.payload_bytes += payload_sz;
+        consume(dec, body + STREAM_CRC_SZ);
+        return RC_OK;
+    }
+    return RC_NOT_READY;
+}
+
+static void consume(StreamDecoder *dec, usize n) {
+    memmove(dec->buf, dec->buf + n, dec->len - n);
+    dec->len -= n;
+}
+
+static _Bool find_sync(StreamDecoder *dec) {
+    // drop everything before the first sync pattern, keeping a trailing
+    // first sync byte in case its partner hasn't arrived yet
+    usize i = 0;
+    while (i + 1 < dec->len && !(dec->buf[i] == STREAM_SYNC0 &&
+                                 dec->buf[i + 1] == STREAM_SYNC1)) {
+        ++i;
+    }
+    if (i + 1 >= dec->len && !(i < dec->len && dec->buf[i] == STREAM_SYNC0)) {
+        i = dec->len;
+    }
+    dec->stats.skipped += i;
+    consume(dec, i);
+    return dec->len >= 2;
+}
+
+static u16 get_u16(const u8 *in) { return in[0] | in[1] << 8; }
+
+static u32 get_u32(const u8 *in) {
+    return get_u16(in) | (u32)get_u16(in + 2) << 16;
+}
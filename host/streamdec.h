@@ -0,0 +1,61 @@
+/**
+ * streamdec.h
+ *
+ * Reassembles frames of the binary sample stream (see stream.h) from bytes
+ * as they arrive, in whatever pieces the serial port hands them over.
+ *
+ * Bytes before a sync pattern are skipped, so decoding can start anywhere
+ * in the stream. A frame that fails its CRC is dropped and the search for
+ * the next sync restarts one byte further on. Frames missing from the
+ * sequence, whether skipped by the board or lost to corruption, are
+ * reported on the next frame that arrives.
+ */
+#ifndef HOST_STREAMDEC_H
+#define HOST_STREAMDEC_H
+
+#include "defs.h"
+#include "stream.h"
+
+typedef struct {
+    StreamCoding coding;
+    u8 channel_mask;
+    u32 seq;
+    u32 sample_rate;
+    u32 timestamp;
+    // frames missing between the previous frame and this one
+    u32 lost;
+    usize count;
+    u16 samples[STREAM_SAMPLES_MAX];
+} StreamFrame;
+
+typedef struct {
+    u64 frames;
+    u64 samples;
+    u64 bytes;
+    // payload bytes of the frames decoded, to compare against packing
+    u64 payload_bytes;
+    // frames missing from the sequence and the runs they went missing in
+    u64 lost;
+    u64 gaps;
+    u64 crc_errors;
+    // bytes thrown away looking for the start of a frame
+    u64 skipped;
+} StreamDecoderStats;
+
+typedef struct {
+    u8 buf[2 * STREAM_FRAME_MAX];
+    usize len;
+    _Bool have_seq;
+    u32 next_seq;
+    StreamDecoderStats stats;
+} StreamDecoder;
+
+void streamdec_init(StreamDecoder *dec);
+
+// buffer up to `sz` bytes, returning how many were taken
+usize streamdec_push(StreamDecoder *dec, const u8 *bytes, usize sz);
+
+// next complete frame, RC_NOT_READY until more bytes are pushed
+RC streamdec_next(StreamDecoder *dec, StreamFrame *frame);
+
+#endif // HOST_STREAMDEC_H
@@ -0,0 +1,69 @@
+/**
+ * autoset.h
+ *
+ * Automatic vertical scale, sample rate and trigger level selection.
+ *
+ * Autoset sweeps down from the fastest sample rate, capturing a short block
+ * at each step through a caller supplied callback, until it has seen enough
+ * periods to estimate the signal frequency. The capture callback keeps this
+ * module free of any HAL dependency so it can be driven by synthetic
+ * signals on a host build.
+ */
+#ifndef INCLUDE_AUTOSET_H
+#define INCLUDE_AUTOSET_H
+
+#include "defs.h"
+#include "trigger.h"
+
+// number of periods autoset aims to put on screen, within [MIN, MAX]
+#define AUTOSET_PERIODS 3
+#define AUTOSET_PERIODS_MIN 2
+#define AUTOSET_PERIODS_MAX 5
+
+// rates skipped between sweep captures so slow signals are found quickly
+#define AUTOSET_SWEEP_STEP 4
+
+/**
+ * Capture `sz` samples at (approximately) `rate` samples/s into `buf` and
+ * report the rate that was actually used.
+ */
+typedef RC (*AutosetCapture)(void *ctx, u32 rate, u16 *buf, usize sz,
+                             u32 *actual_rate);
+
+typedef struct {
+    // achievable sample rates, sorted fastest first
+    const u32 *rates;
+    usize nrates;
+    // samples that span the width of the screen
+    usize screen_samples;
+    // volts represented by `adc_max`
+    double full_scale;
+    u16 adc_max;
+    // scratch space for captures
+    u16 *buf;
+    usize sz;
+} AutosetConfig;
+
+typedef struct {
+    u16 min;
+    u16 max;
+    u16 mean;
+    // peak-to-peak / 2, in ADC counts
+    u16 amplitude;
+    // 0 when no periodic component was found
+    double frequency;
+} AutosetEstimate;
+
+typedef struct {
+    AutosetEstimate estimate;
+    double scale;
+    u32 rate;
+    Trigger trigger;
+} AutosetResult;
+
+RC autoset_estimate(const u16 *samples, usize sz, u32 rate,
+                    AutosetEstimate *est);
+RC autoset_run(const AutosetConfig *cfg, AutosetCapture capture, void *ctx,
+               AutosetResult *res);
+
+#endif // INCLUDE_AUTOSET_H
@@ -0,0 +1,48 @@
+/**
+ * average.h
+ *
+ * Accumulation of repeated acquisitions into a single 32-bit fixed-point
+ * buffer. Supports block (ensemble) averaging, exponential averaging and a
+ * min/max envelope. The accumulation buffer is owned by the caller and must
+ * hold one `u32` per sample.
+ */
+#ifndef INCLUDE_AVERAGE_H
+#define INCLUDE_AVERAGE_H
+
+#include "defs.h"
+
+typedef enum {
+    AVERAGE_OFF,
+    AVERAGE_ENSEMBLE,
+    AVERAGE_EXPONENTIAL,
+    AVERAGE_ENVELOPE,
+} AverageMode;
+
+#define AVERAGE_COUNT_MIN 2
+#define AVERAGE_COUNT_MAX 256
+
+// fractional bits kept by the exponential accumulator
+#define AVERAGE_FRAC_BITS 16
+
+typedef struct {
+    AverageMode mode;
+    u32 *acc;
+    usize sz;
+    // acquisitions per average (ensemble/envelope) or time constant
+    // (exponential, rounded down to a power of two)
+    usize count;
+    usize shift;
+    usize nacquired;
+} Averager;
+
+RC average_init(Averager *avg, AverageMode mode, u32 *acc, usize sz);
+RC average_set_count(Averager *avg, usize count);
+RC average_reset(Averager *avg);
+
+RC average_update(Averager *avg, const u16 *samples, usize sz);
+_Bool average_ready(const Averager *avg);
+
+RC average_read(const Averager *avg, u16 *out, usize sz);
+RC average_read_envelope(const Averager *avg, u16 *lo, u16 *hi, usize sz);
+
+#endif // INCLUDE_AVERAGE_H
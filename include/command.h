@@ -0,0 +1,79 @@
+/**
+ * command.h
+ *
+ * Line based command interface over the serial port, in the style of SCPI:
+ *
+ *   :ACQuire:RATE 1e6
+ *   :TRIGger:LEVel 1.2
+ *   :DISPlay:SCALe?
+ *   :MEASure?
+ *
+ * A header matches a command in the table when each of its nodes is either
+ * the node's short form, its capitals, or the whole node, in any case. The
+ * leading colon is optional. A header ending in '?' is a query and replies
+ * with a line; anything else sets the command's value from its single
+ * numeric argument and replies only on error, with a line starting "ERR".
+ * Commands on the same line are separated by ';', each a full header.
+ *
+ * Nothing is allocated. Bytes collect in a fixed line buffer, numbers are
+ * parsed in place rather than with strtod, which may call malloc in newlib,
+ * and handlers format replies into a buffer owned by the parser.
+ */
+#ifndef INCLUDE_COMMAND_H
+#define INCLUDE_COMMAND_H
+
+#include "defs.h"
+
+#define COMMAND_LINE_MAX 96
+#define COMMAND_REPLY_MAX 96
+
+typedef RC (*CommandSet)(void *ctx, double value);
+// format the reply to a query into `reply`
+typedef RC (*CommandQuery)(void *ctx, char *reply, usize sz);
+// send one line of reply, without its line ending
+typedef void (*CommandReply)(void *ctx, const char *reply);
+
+typedef struct {
+    // e.g. ":ACQuire:RATE", capitals giving the short form
+    const char *header;
+    // either may be NULL when the command can't be set or queried
+    CommandSet set;
+    CommandQuery query;
+} Command;
+
+typedef struct {
+    u32 lines;
+    u32 executed;
+    u32 errors;
+} CommandStats;
+
+typedef struct {
+    const Command *commands;
+    usize ncommands;
+    CommandReply reply;
+    void *ctx;
+    char line[COMMAND_LINE_MAX];
+    usize len;
+    // the line outgrew the buffer and is thrown away at its end
+    _Bool overflow;
+    char out[COMMAND_REPLY_MAX];
+    CommandStats stats;
+} CommandParser;
+
+/**
+ * `ctx` is passed to every handler and to `reply`. The table is used in
+ * place and has to outlive the parser.
+ */
+RC command_init(CommandParser *parser, const Command *commands,
+                usize ncommands, CommandReply reply, void *ctx);
+
+// run every line completed by `bytes`, keeping any partial line for later
+void command_feed(CommandParser *parser, const u8 *bytes, usize sz);
+
+// run one line of commands, which is modified in place
+void command_execute(CommandParser *parser, char *line);
+
+// parse the whole of `text` as a decimal number with optional exponent
+RC command_parse_number(const char *text, double *value);
+
+#endif // INCLUDE_COMMAND_H
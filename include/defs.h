@@ -23,6 +23,10 @@ typedef enum {
     RC_INVALID_OPT,
     RC_CHANNEL_COUNT,
     RC_BUF_LENGTH,
+    RC_NO_TRIGGER,
+    RC_TIMEOUT,
+    RC_NOT_READY,
+    RC_WRITE_FAILED,
 } RC;
 
 const char *rcstr(RC rc);
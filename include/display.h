@@ -2,18 +2,23 @@
  * display.h
  *
  * Header for the display server ingesting data from the ADC.
- *
- * TODO: Include the LCD display once it arrives
  */
 #ifndef INCLUDE_DISPLAY_H
 #define INCLUDE_DISPLAY_H
 
 #include "defs.h"
+#include "font.h"
+#include "persist.h"
+#include "pyramid.h"
 
 typedef enum {
     INVALID_DISPLAY,
     TERMINAL_DISPLAY,
     LCD_DISPLAY,
+    // terminal renderer drawing into RAM only, for host tests and benchmarks.
+    // Needs a build with DISPLAY_MEMORY defined, it doesn't fit on the board
+    // alongside the terminal
+    MEMORY_DISPLAY,
 } DisplayOption;
 
 typedef enum {
@@ -21,32 +26,162 @@ typedef enum {
     DISPLAY_CLOSED,
 } DisplayStatus;
 
-#define CHANNEL_COUNT_MAX 2
+typedef enum {
+    // one glyph per sample per character cell
+    PLOT_CELLS,
+    // Unicode Braille patterns, 2x4 dots per character cell
+    PLOT_BRAILLE,
+} PlotStyle;
+
+typedef enum {
+    // restart from the left edge once the plot is full
+    SWEEP_WRAP,
+    // scroll the plot left so new samples enter from the right
+    SWEEP_ROLL,
+} SweepMode;
+
+#define CHANNEL_COUNT_MAX 8
 #define CHANNEL_NAME_MAX 20
 
+#define TERMINAL_COLS_MAX 120
+#define TERMINAL_ROWS_MAX 40
+
+// per-channel state, kept as parallel arrays indexed by `ChannelHandle` so
+// the loops over every channel walk contiguous memory
 typedef struct {
-    _Bool active;
-    char name[CHANNEL_NAME_MAX];
-    double last_value;
-} Channel;
+    // one past the highest handle in use
+    usize count;
+    _Bool active[CHANNEL_COUNT_MAX];
+    _Bool visible[CHANNEL_COUNT_MAX];
+    u8 color[CHANNEL_COUNT_MAX];
+    // where traces overlap, the higher priority one is drawn on top and ties
+    // go to whichever was written last
+    u8 priority[CHANNEL_COUNT_MAX];
+    // volts at the top of the plot and volts added before scaling
+    double scale[CHANNEL_COUNT_MAX];
+    double offset[CHANNEL_COUNT_MAX];
+    double last_value[CHANNEL_COUNT_MAX];
+    // next sample position across the plot, in columns or Braille dots
+    usize x[CHANNEL_COUNT_MAX];
+    // dot row of the previous sample so consecutive samples are joined,
+    // -1 at the start of a sweep
+    i32 last_y[CHANNEL_COUNT_MAX];
+    char name[CHANNEL_COUNT_MAX][CHANNEL_NAME_MAX];
+} Channels;
 
 typedef struct {
-    Channel channels[CHANNEL_COUNT_MAX];
-    usize nchannels;
+    // Unicode code point, ASCII or a Braille pattern
+    u16 glyph;
+    // xterm colour index, 0 for the terminal's default
+    u8 color;
+    // handle + 1 of the channel drawn here, 0 for the background
+    u8 owner;
+} Cell;
+
+// running totals of the work a backend has done since the last reset
+typedef struct {
+    usize bytes;
+    usize flushes;
+    usize samples;
+    usize glyphs;
+    // address windows on the LCD
+    usize cursor_moves;
+    usize color_changes;
+} DisplayStats;
+
+typedef struct {
+    Channels channels;
     usize chars_wide;
     usize chars_tall;
-    usize col;
+    PlotStyle style;
+    SweepMode sweep;
+    // columns scrolled in RAM but not yet on the terminal
+    usize pending_roll;
+    // history view: samples per plot column (or Braille dot) and how far the
+    // right edge sits behind the newest sample
+    usize zoom;
+    usize pan;
     usize reserved_rows;
     double scale;
     double binwidth;
+    // `front` mirrors the terminal, `back` is drawn into and diffed against
+    // it so only changed cells go over the wire
+    Cell front[TERMINAL_ROWS_MAX][TERMINAL_COLS_MAX];
+    Cell back[TERMINAL_ROWS_MAX][TERMINAL_COLS_MAX];
+    // where the terminal's cursor and colour were left, -1 when unknown
+    i32 cursor_row;
+    i32 cursor_col;
+    i32 color;
+    // render into `front` only, nothing is written to stdout
+    _Bool headless;
+    DisplayStats stats;
 } TerminalDisplay;
 
+#define LCD_WIDTH 320
+#define LCD_HEIGHT 240
+// background, dots along the horizontal divisions, vertical division line
+#define LCD_GRID_KINDS 3
+// a line of text across the top of the LCD, the plot fills the rest
+#define LCD_HEADER_ROWS FONT_CELL_HEIGHT
+#define LCD_HEADER_COLS (LCD_WIDTH / FONT_CELL_WIDTH)
+// CASET and PASET with four parameter bytes each, then RAMWR
+#define LCD_WINDOW_BYTES 11
+
+// how the LCD backend reaches the panel, so the drawing can be pointed at a
+// RAM framebuffer on the host instead of the SPI bus
+typedef struct {
+    // address window covering columns [x0, x1] and rows [y0, y1]
+    RC (*window)(void *ctx, u16 x0, u16 y0, u16 x1, u16 y1);
+    // RGB565 pixels for the window, column by column and top to bottom. The
+    // transport may still be reading `px` until its next call returns
+    RC (*pixels)(void *ctx, const u16 *px, usize n);
+    void *ctx;
+} LcdTransport;
+
 typedef struct {
+    Channels channels;
+    LcdTransport transport;
+    usize pixels_wide;
+    usize pixels_tall;
+    SweepMode sweep;
+    double scale;
+    // rows each channel's trace covers in each column, lo > hi for none.
+    // Columns are stored from `origin` so rolling doesn't move them
+    u8 span_lo[CHANNEL_COUNT_MAX][LCD_WIDTH];
+    u8 span_hi[CHANNEL_COUNT_MAX][LCD_WIDTH];
+    usize origin;
+    // samples per history column and how far the history is panned back
+    usize zoom;
+    usize pan;
+    // hit counts painted under the traces, only set while
+    // lcd_draw_persistence flushes them
+    const Persistence *persist;
+    // rows to repaint in each screen column at the next flush, lo > hi for
+    // none: wherever a changed trace was and wherever it is now
+    u8 dirty_lo[LCD_WIDTH];
+    u8 dirty_hi[LCD_WIDTH];
+    // grid pixels for each kind of column, one bit per row, and the kind of
+    // each screen column
+    u32 grid[LCD_GRID_KINDS][(LCD_HEIGHT + 31) / 32];
+    u8 grid_kind[LCD_WIDTH];
+    // a column is composed into one buffer while the other is being sent
+    u16 column[2][LCD_HEIGHT];
+    usize next_column;
+    // header text and colour for the next flush, and what the panel shows
+    // now. A shown cell of 0 is unknown and always redrawn
+    char text[LCD_HEADER_COLS];
+    u16 text_color[LCD_HEADER_COLS];
+    char shown[LCD_HEADER_COLS];
+    u16 shown_color[LCD_HEADER_COLS];
+    GlyphCache glyphs;
+    DisplayStats stats;
 } LcdDisplay;
 
+// each backend's state is stored separately, so a small backend doesn't
+// reserve room for the terminal's framebuffers
 union Display {
-    TerminalDisplay terminal;
-    LcdDisplay lcd;
+    TerminalDisplay *terminal;
+    LcdDisplay *lcd;
 };
 
 typedef struct {
@@ -69,9 +204,44 @@ RC display_redraw(DisplayFile *file);
 RC display_set_y(DisplayFile *file, usize dim);
 RC display_set_x(DisplayFile *file, usize dim);
 RC display_set_scale(DisplayFile *file, double scale);
+RC display_set_channel_scale(DisplayFile *file, ChannelHandle hdl,
+                             double scale);
+RC display_set_channel_offset(DisplayFile *file, ChannelHandle hdl,
+                              double offset);
+RC display_set_channel_visible(DisplayFile *file, ChannelHandle hdl,
+                               _Bool visible);
+RC display_set_channel_priority(DisplayFile *file, ChannelHandle hdl,
+                                u8 priority);
+RC display_set_style(DisplayFile *file, PlotStyle style);
+RC display_set_sweep(DisplayFile *file, SweepMode sweep);
+RC display_plot_size(DisplayFile *file, usize *rows, usize *cols);
 
 RC display_writev(DisplayFile *file, ChannelHandle hdl, double *values,
                   usize sz);
 RC display_write(DisplayFile *file, ChannelHandle hdl, double value);
+RC display_draw_persistence(DisplayFile *file, const Persistence *persist);
+
+RC display_set_zoom(DisplayFile *file, usize samples_per_point);
+RC display_set_pan(DisplayFile *file, usize samples);
+/**
+ * Redraw a channel as the min/max envelope of its capture history, at the
+ * current zoom and pan. Samples are ADC counts scaled by `volts_per_count`.
+ */
+RC display_draw_history(DisplayFile *file, ChannelHandle hdl,
+                        const Pyramid *pyr, double volts_per_count);
+
+/**
+ * Send the LCD's pixels through `transport`, which is copied. The LCD draws
+ * nothing until it has one.
+ */
+RC display_set_transport(DisplayFile *file, const LcdTransport *transport);
+
+RC display_stats(DisplayFile *file, DisplayStats *stats);
+RC display_reset_stats(DisplayFile *file);
+/**
+ * Copy what the display shows into `buf` as UTF-8 text, one line per row.
+ * Colours are dropped. Returns RC_BUF_LENGTH if `buf` is too small.
+ */
+RC display_snapshot(DisplayFile *file, char *buf, usize sz);
 
 #endif // INCLUDE_DISPLAY_H
@@ -0,0 +1,58 @@
+/**
+ * fanout.h
+ *
+ * Fan one stream of processed frames out to several sinks (terminal, LCD,
+ * binary stream, ...) that each draw at their own frame rate.
+ *
+ * Frames are taken from a render scheduler once and shared by every sink,
+ * so nothing computed for a frame is redone per sink. Each poll draws at
+ * most one sink, the most overdue one, so a slow sink delays the others by
+ * at most a single draw and can't hold the main loop for a whole round.
+ */
+#ifndef INCLUDE_FANOUT_H
+#define INCLUDE_FANOUT_H
+
+#include "defs.h"
+#include "render.h"
+
+#define FANOUT_SINKS_MAX 4
+
+typedef RC (*FanoutDraw)(void *ctx, const void *frame);
+
+typedef struct {
+    FanoutDraw draw;
+    void *ctx;
+    RenderPacer pacer;
+    // sequence number of the last frame this sink drew
+    u32 seq;
+    u32 drawn;
+    // frames that arrived and were replaced before this sink drew them
+    u32 skipped;
+} FanoutSink;
+
+typedef struct {
+    RenderScheduler *source;
+    // newest frame taken from `source` and its sequence number, 0 for none
+    const void *frame;
+    u32 seq;
+    FanoutSink sinks[FANOUT_SINKS_MAX];
+    usize nsinks;
+} Fanout;
+
+/**
+ * Share frames from `source`, which should run unthrottled (0 fps) since
+ * the sinks do their own rate limiting.
+ */
+RC fanout_init(Fanout *fan, RenderScheduler *source);
+RC fanout_add(Fanout *fan, FanoutDraw draw, void *ctx, u32 fps, usize *idx);
+RC fanout_set_fps(Fanout *fan, usize idx, u32 fps);
+
+/**
+ * Pick up the newest frame and draw it on the most overdue sink that
+ * hasn't shown it yet. Returns RC_NOT_READY when no sink was due, otherwise
+ * whatever that sink's draw returned.
+ */
+RC fanout_poll(Fanout *fan, u32 now_ms);
+RC fanout_stats(const Fanout *fan, usize idx, RenderStats *stats);
+
+#endif // INCLUDE_FANOUT_H
@@ -0,0 +1,46 @@
+/**
+ * fmt.h
+ *
+ * Small allocation-free formatting into caller buffers, replacing printf for
+ * the hot display paths so newlib's float printf doesn't need linking in.
+ *
+ * Every function returns the number of characters written, not counting the
+ * terminating NUL which is always added, or 0 when the buffer is too small
+ * or the value is out of range.
+ */
+#ifndef INCLUDE_FMT_H
+#define INCLUDE_FMT_H
+
+#include "defs.h"
+
+// longest output of fmt_u32/fmt_i32 including the sign and NUL
+#define FMT_INT_MAX 12
+
+usize fmt_u32(char *buf, usize sz, u32 value);
+usize fmt_i32(char *buf, usize sz, i32 value);
+// `value` in units of 10^-decimals, e.g. (1234, 3) -> "1.234"
+usize fmt_fixed(char *buf, usize sz, i32 value, u8 decimals);
+/**
+ * `value` to `decimals` places, which differs from printf's "%.*f" in three
+ * ways. Halves round away from zero rather than to even (0.25 -> "0.3"),
+ * and it is value * 10^decimals as a double that is rounded rather than
+ * the exact value, so one just below a half can round up (0.15 -> "0.2").
+ * A negative value that rounds to zero loses its sign ("0.0", not "-0.0").
+ * Returns 0 once value * 10^decimals rounds past the i32 range, e.g. for
+ * 123456.789 to 5 places.
+ */
+usize fmt_double(char *buf, usize sz, double value, u8 decimals);
+// engineering units (V, mV, uV) with `digits` significant digits
+usize fmt_volts(char *buf, usize sz, double volts, u8 digits);
+
+// CSI n <final>, the parameter is left out when it is the default of 1
+usize fmt_csi(char *buf, usize sz, u32 n, char final);
+// CSI row ; col H with one based coordinates
+usize fmt_cursor(char *buf, usize sz, u32 row, u32 col);
+// SGR foreground for an xterm colour index, 0 resets attributes
+usize fmt_color(char *buf, usize sz, u8 color);
+
+// pad `buf` (holding `len` characters) with spaces out to `width`
+usize fmt_pad(char *buf, usize sz, usize len, usize width);
+
+#endif // INCLUDE_FMT_H
@@ -0,0 +1,56 @@
+/**
+ * font.h
+ *
+ * 5x7 bitmap font for text on the LCD, and a cache of glyphs expanded to
+ * RGB565 so each one goes to the panel as a single transfer.
+ *
+ * Glyphs are stored a byte per column with bit 0 at the top, the order the
+ * LCD is filled in, 475 bytes of flash for printable ASCII. Each sits in a
+ * cell with a column of spacing to its right and blank rows above and below.
+ */
+#ifndef INCLUDE_FONT_H
+#define INCLUDE_FONT_H
+
+#include "defs.h"
+
+#define FONT_WIDTH 5
+#define FONT_HEIGHT 7
+#define FONT_CELL_WIDTH 6
+#define FONT_CELL_HEIGHT 10
+// blank rows above the glyph within its cell
+#define FONT_CELL_TOP 1
+
+#define GLYPH_CACHE_SZ 24
+
+// columns of `c`, '?' for anything outside printable ASCII
+const u8 *font_glyph(char c);
+
+typedef struct {
+    // the whole cell, column by column and top to bottom
+    u16 px[FONT_CELL_WIDTH * FONT_CELL_HEIGHT];
+    char c;
+    u16 fg;
+    u16 bg;
+    // when the entry was last looked up, 0 while it is empty
+    u32 used;
+} Glyph;
+
+typedef struct {
+    Glyph entries[GLYPH_CACHE_SZ];
+    u32 clock;
+    usize hits;
+    usize misses;
+} GlyphCache;
+
+void glyph_cache_init(GlyphCache *cache);
+
+/**
+ * Find `c` in these colours. On a miss the least recently used entry is
+ * taken over and returned for glyph_render to fill in, which is left to the
+ * caller so it can first wait until the panel has finished reading it.
+ * Returns 1 on a hit.
+ */
+_Bool glyph_lookup(GlyphCache *cache, char c, u16 fg, u16 bg, Glyph **glyph);
+void glyph_render(Glyph *glyph);
+
+#endif // INCLUDE_FONT_H
@@ -0,0 +1,40 @@
+/**
+ * framebuffer.h
+ *
+ * LCD transport that draws into a framebuffer in RAM, the same way the
+ * panel fills its address window, so the LCD backend can be run and checked
+ * on the host. A full 320x240 panel needs 150 KB, more than the board has.
+ *
+ * It also counts what the panel would have been sent, so redraw bandwidth
+ * can be measured without the hardware.
+ */
+#ifndef INCLUDE_FRAMEBUFFER_H
+#define INCLUDE_FRAMEBUFFER_H
+
+#include "defs.h"
+#include "display.h"
+
+typedef struct {
+    // RGB565, row major
+    u16 *px;
+    usize width;
+    usize height;
+    // current address window, inclusive
+    u16 x0;
+    u16 y0;
+    u16 x1;
+    u16 y1;
+    // next pixel written, moving down each column and wrapping back to the
+    // top left of the window once it is full
+    u16 x;
+    u16 y;
+    usize windows;
+    usize pixels;
+    // command and pixel bytes that would have crossed the SPI bus
+    usize bytes;
+} Framebuffer;
+
+RC framebuffer_init(Framebuffer *fb, u16 *px, usize width, usize height);
+void framebuffer_transport(Framebuffer *fb, LcdTransport *transport);
+
+#endif // INCLUDE_FRAMEBUFFER_H
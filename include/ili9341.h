@@ -0,0 +1,28 @@
+/**
+ * ili9341.h
+ *
+ * Transport for a 320x240 ILI9341 panel on SPI2, pixel data sent by DMA.
+ *
+ * The panel is left in its native portrait addressing and mounted on its
+ * side, so the column address runs down the screen and RAMWR fills each
+ * screen column top to bottom, the order the LCD backend composes in.
+ *
+ * Wiring: SCK PB13, MOSI PB15, CS PB12, D/C PA8 (D7), RST PA9 (D8).
+ */
+#ifndef INCLUDE_ILI9341_H
+#define INCLUDE_ILI9341_H
+
+#include "defs.h"
+#include "display.h"
+
+#include "stm32f4xx_hal.h"
+
+extern SPI_HandleTypeDef hspi2;
+extern DMA_HandleTypeDef hdma_spi2_tx;
+
+RC ili9341_init(void);
+void ili9341_transport(LcdTransport *transport);
+
+void HAL_SPI_MspInit(SPI_HandleTypeDef *hspi);
+
+#endif // INCLUDE_ILI9341_H
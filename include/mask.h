@@ -0,0 +1,46 @@
+/**
+ * mask.h
+ *
+ * Pass/fail mask testing. A mask is compiled ahead of time into per-sample
+ * lower and upper bounds, so checking an acquisition is a single branch-free
+ * comparison loop. Masks can be built from a tolerance band around a golden
+ * reference (usually captured from the live signal) or from upper and lower
+ * boundary polylines.
+ */
+#ifndef INCLUDE_MASK_H
+#define INCLUDE_MASK_H
+
+#include "defs.h"
+
+typedef struct {
+    // sample index and value of a polyline vertex, sorted by x
+    u16 x;
+    u16 y;
+} MaskPoint;
+
+typedef struct {
+    // caller owned bounds, one entry per sample
+    u16 *lo;
+    u16 *hi;
+    usize sz;
+} Mask;
+
+typedef struct {
+    u32 acquisitions;
+    u32 passed;
+    u32 failed;
+    // samples outside the mask, summed over every acquisition
+    u64 violations;
+} MaskStats;
+
+RC mask_init(Mask *mask, u16 *lo, u16 *hi, usize sz);
+RC mask_from_reference(Mask *mask, const u16 *ref, usize sz, u16 tol_y,
+                       usize tol_x);
+RC mask_from_polylines(Mask *mask, const MaskPoint *lower, usize nlower,
+                       const MaskPoint *upper, usize nupper);
+
+RC mask_check(const Mask *mask, const u16 *samples, usize sz, u32 *violations);
+RC mask_test(const Mask *mask, const u16 *samples, usize sz, MaskStats *stats);
+RC mask_stats_reset(MaskStats *stats);
+
+#endif // INCLUDE_MASK_H
@@ -0,0 +1,42 @@
+/**
+ * persist.h
+ *
+ * Persistence buffer accumulating how often each display cell has been hit
+ * across acquisitions. Counters are 8-bit and saturate, and every cell
+ * decays by a configurable fraction per acquisition so intermittent
+ * behaviour stays visible for a while before fading out.
+ */
+#ifndef INCLUDE_PERSIST_H
+#define INCLUDE_PERSIST_H
+
+#include "defs.h"
+
+#define PERSIST_HITS_MAX 255
+// default counts added per hit, so a cell saturates after a few acquisitions
+#define PERSIST_INCREMENT 32
+
+typedef struct {
+    // column major, `rows` counters per column
+    u8 *hits;
+    usize rows;
+    usize cols;
+    // sample values mapped to the top and bottom rows
+    i32 hi;
+    i32 lo;
+    u8 increment;
+    // each acquisition removes ceil(hits / 2^decay_shift), 0 never decays
+    u8 decay_shift;
+} Persistence;
+
+RC persist_init(Persistence *persist, u8 *hits, usize rows, usize cols);
+RC persist_clear(Persistence *persist);
+RC persist_set_range(Persistence *persist, i32 lo, i32 hi);
+RC persist_set_decay(Persistence *persist, u8 decay_shift);
+RC persist_accumulate(Persistence *persist, const u16 *samples, usize sz);
+
+static inline u8 persist_hits(const Persistence *persist, usize row,
+                              usize col) {
+    return persist->hits[col * persist->rows + row];
+}
+
+#endif // INCLUDE_PERSIST_H
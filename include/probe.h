@@ -10,6 +10,8 @@ extern DMA_HandleTypeDef hdma_adc1;
 RC probe_init(void);
 RC probe_start(u16 *buf, usize sz);
 RC probe_fetch(u16 **buf, usize *sz);
+RC probe_rates(const u32 **rates, usize *nrates);
+RC probe_set_rate(u32 rate, u32 *actual_rate);
 
 void HAL_ADC_MspInit(ADC_HandleTypeDef *hadc);
 
@@ -0,0 +1,52 @@
+/**
+ * pyramid.h
+ *
+ * Min/max pyramid (mipmap) over a rolling history of samples.
+ *
+ * Level 0 is the raw sample ring and every level above it holds the min and
+ * max of two entries from the level below, so level k summarises 2^k
+ * samples per entry. Levels are filled in as samples are appended, at an
+ * amortised cost of one extra entry per sample. Reading the envelope of
+ * any span across `cols` columns picks the level whose entries are no wider
+ * than a column, touching O(cols) entries however long the span is.
+ *
+ * Buffers are owned by the caller: `cap` samples for level 0 plus `cap`
+ * packed min/max words for the levels above it, 6 bytes per sample.
+ */
+#ifndef INCLUDE_PYRAMID_H
+#define INCLUDE_PYRAMID_H
+
+#include "defs.h"
+
+#define PYRAMID_LEVELS_MAX 24
+
+typedef struct {
+    // level 0, indexed by sample number modulo `cap`
+    u16 *samples;
+    // levels 1 and up back to back, each half the length of the one before,
+    // entries packed as hi << 16 | lo
+    u32 *levels;
+    // samples retained, a power of two
+    usize cap;
+    // levels including the raw samples
+    usize nlevels;
+    // samples appended since the last reset
+    u64 count;
+} Pyramid;
+
+RC pyramid_init(Pyramid *pyr, u16 *samples, u32 *levels, usize cap);
+void pyramid_reset(Pyramid *pyr);
+void pyramid_append(Pyramid *pyr, const u16 *samples, usize sz);
+
+// sample numbers of the oldest retained sample and one past the newest
+void pyramid_bounds(const Pyramid *pyr, u64 *first, u64 *end);
+
+/**
+ * Envelope of samples [start, start + span) split evenly across `cols`
+ * columns. Columns are widened to whole entries of the level read, so a
+ * column may include up to one entry's worth of its neighbours' samples.
+ */
+RC pyramid_read(const Pyramid *pyr, u64 start, u64 span, u16 *lo, u16 *hi,
+                usize cols);
+
+#endif // INCLUDE_PYRAMID_H
@@ -0,0 +1,79 @@
+/**
+ * render.h
+ *
+ * Fixed-rate render scheduling with a triple-buffered frame handoff.
+ *
+ * The producer fills the back slot and publishes it, and the renderer takes
+ * the newest published frame once its next frame is due. Publishing never
+ * waits on the renderer: a frame replaced before it was taken is counted as
+ * dropped. The three slot roles are swapped through one atomic word, so the
+ * producer may run in an interrupt while the renderer runs in the main loop
+ * and neither ever touches the slot the other is using.
+ */
+#ifndef INCLUDE_RENDER_H
+#define INCLUDE_RENDER_H
+
+#include "defs.h"
+
+#define RENDER_SLOTS 3
+// frame times are kept in whole milliseconds
+#define RENDER_FPS_MAX 1000
+// effective frame rate is measured over windows of this length
+#define RENDER_FPS_WINDOW_MS 1000
+
+typedef struct {
+    u32 published;
+    u32 rendered;
+    // published frames replaced before the renderer took them
+    u32 dropped;
+    // frames rendered per second over the last complete window
+    double fps;
+} RenderStats;
+
+// fixed-cadence timing shared by anything drawn at a frame rate
+typedef struct {
+    // 0 is due whenever asked
+    u32 fps;
+    u32 interval_ms;
+    // leftover of 1000 / fps carried between frames, in 1/fps ms
+    u32 remainder;
+    u32 next_ms;
+    u32 window_start_ms;
+    u32 window_count;
+    // frames per second over the last complete window
+    double effective_fps;
+} RenderPacer;
+
+typedef struct {
+    // `RENDER_SLOTS` frames of `slot_sz` bytes, owned by the caller
+    u8 *slots;
+    usize slot_sz;
+    // back, ready and front slot indices plus a fresh flag, see render.c
+    volatile u32 state;
+    RenderPacer pacer;
+    RenderStats stats;
+} RenderScheduler;
+
+RC render_pacer_init(RenderPacer *pacer, u32 fps);
+// fold finished windows into the effective rate, call even when idle
+void render_pacer_update(RenderPacer *pacer, u32 now_ms);
+_Bool render_pacer_due(const RenderPacer *pacer, u32 now_ms);
+// record a frame drawn at `now_ms` and schedule the next one
+void render_pacer_tick(RenderPacer *pacer, u32 now_ms);
+
+RC render_init(RenderScheduler *sched, void *slots, usize slot_sz, u32 fps);
+RC render_set_fps(RenderScheduler *sched, u32 fps);
+
+// producer side, safe to call from an interrupt
+void *render_back(RenderScheduler *sched);
+void render_publish(RenderScheduler *sched);
+
+/**
+ * Hand the newest published frame to the renderer if one is due at
+ * `now_ms`. The frame stays valid until the next successful take.
+ * Returns RC_NOT_READY when it is too early or nothing new was published.
+ */
+RC render_take(RenderScheduler *sched, u32 now_ms, void **frame);
+void render_stats(const RenderScheduler *sched, RenderStats *stats);
+
+#endif // INCLUDE_RENDER_H
@@ -0,0 +1,44 @@
+/**
+ * rice.h
+ *
+ * Lossless compression of blocks of 12 bit samples for the binary stream.
+ *
+ * Each sample is predicted from the ones before it, by first or second
+ * order differences, whichever suits the block, and the residuals are Rice
+ * coded: a residual u is sent as u >> k in unary followed by the low k bits.
+ * The block is split into partitions that each pick their own k, so a quiet
+ * stretch isn't coded with the parameter a loud one needed.
+ *
+ * The bitstream, most significant bit first and zero padded to a byte:
+ *
+ *   2 bits     prediction order, 1 or 2
+ *   12 bits    each of the first `order` samples as they are
+ *   per partition of RICE_PARTITION residuals, the last one possibly short:
+ *     4 bits   k
+ *     residuals, zigzag mapped so small negatives stay small
+ *
+ * A quotient of RICE_ESCAPE or more is sent as RICE_ESCAPE ones followed by
+ * the residual in RICE_RAW_BITS bits, which bounds the work and the bits
+ * per sample whatever the signal does.
+ */
+#ifndef INCLUDE_RICE_H
+#define INCLUDE_RICE_H
+
+#include "defs.h"
+
+#define RICE_PARTITION 32
+#define RICE_K_MAX 13
+#define RICE_ESCAPE 16
+// a second order residual of 12 bit samples is within +-8190
+#define RICE_RAW_BITS 14
+
+/**
+ * Compress `n` samples into `out`. Gives up with RC_BUF_LENGTH as soon as
+ * they won't fit in `sz` bytes, so a caller can bound the output by the
+ * size of the uncompressed block.
+ */
+RC rice_encode(const u16 *samples, usize n, u8 *out, usize sz, usize *len);
+// decompress `n` samples from the `sz` bytes at `in`
+RC rice_decode(const u8 *in, usize sz, usize n, u16 *samples);
+
+#endif // INCLUDE_RICE_H
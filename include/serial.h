@@ -1,9 +1,87 @@
+/**
+ * serial.h
+ *
+ * USART2 to the ST-LINK's virtual COM port, which stdout is written to.
+ *
+ * Output is copied into a ring and sent by DMA in the background, so a
+ * printf costs the copy instead of the time the bytes take on the line.
+ * Each transfer sends the oldest queued run, up to a chunk, and its
+ * completion starts the next one, so the line stays busy while anything is
+ * queued.
+ *
+ * Input is received by DMA into a circular ring. The DMA's position is
+ * picked up at half and full transfer and whenever the line goes idle, so a
+ * command typed or sent in one burst is available as soon as it ends
+ * rather than once the ring fills.
+ */
 #ifndef INCLUDE_SERIAL_H
 #define INCLUDE_SERIAL_H
 #include "defs.h"
 
+#include "stm32f4xx_hal.h"
+
+// ring size, a power of two, and the most sent by a single transfer
+#define SERIAL_TX_SZ 2048
+#define SERIAL_TX_CHUNK 256
+// input ring, of which only the newest half is safe from the DMA
+#define SERIAL_RX_SZ 256
+
+// what _write does with output that doesn't fit in the ring
+typedef enum {
+    // wait for transfers to make room, nothing is lost
+    SERIAL_FULL_BLOCK,
+    // keep what was already queued and discard the rest of the new output
+    SERIAL_FULL_DROP,
+    // discard the oldest queued output that isn't being sent yet
+    SERIAL_FULL_OVERWRITE,
+} SerialFullPolicy;
+
+typedef struct {
+    // bytes taken into the ring and bytes discarded because it was full
+    u64 queued;
+    u64 dropped;
+    usize transfers;
+    // core clock cycles spent queueing output, waiting for room included
+    u64 write_cycles;
+    // bytes read, lost because they weren't read in time, and receive
+    // errors the UART reported
+    u64 received;
+    u64 overrun;
+    usize rx_errors;
+} SerialStats;
+
+extern UART_HandleTypeDef huart2;
+extern DMA_HandleTypeDef hdma_usart2_tx;
+extern DMA_HandleTypeDef hdma_usart2_rx;
+
 int _write(int file, char *ptr, int len);
 
 RC serial_init(void);
+RC serial_set_full_policy(SerialFullPolicy policy);
+
+/**
+ * Switch to another baud rate once everything queued has been sent.
+ * Rates above PCLK1 / 16 use 8x oversampling, up to PCLK1 / 8.
+ */
+RC serial_set_baud(u32 baud);
+
+// queue bytes as _write does, for output that doesn't go through stdio
+void serial_write(const u8 *bytes, usize sz);
+// bytes that can be queued right now without waiting or dropping any
+usize serial_room(void);
+// wait until everything queued has been sent
+RC serial_flush(void);
+/**
+ * Send everything queued by polling the UART, for use with interrupts
+ * masked, as on a fatal error, when no transfer completion is ever handled.
+ * Gives up after as long as serial_flush would, counted in core cycles
+ * since the tick doesn't advance.
+ */
+void serial_drain(void);
+// copy out up to `sz` of the bytes received since the last call, never
+// waiting for more
+usize serial_read(u8 *bytes, usize sz);
+void serial_stats(SerialStats *stats);
+void serial_reset_stats(void);
 
 #endif // INCLUDE_SERIAL_H
@@ -0,0 +1,82 @@
+/**
+ * stream.h
+ *
+ * Framed binary stream of raw samples over the serial port, for a host to
+ * record instead of watching the terminal plot.
+ *
+ * Every frame is self-contained so a host can join mid-stream, resync after
+ * corruption and spot lost frames from the sequence number:
+ *
+ *   0  sync, 0xA5 0x5A
+ *   2  payload coding, a StreamCoding
+ *   3  channel mask, samples interleaved in channel order
+ *   4  samples in the frame, across all channels
+ *   6  sequence number, counting frames sent and skipped
+ *   10 sample rate in Hz
+ *   14 time the samples were captured, HAL ticks in ms
+ *   18 payload
+ *   .. CRC-16/CCITT-FALSE over everything before it
+ *
+ * Multi-byte fields are little endian. A packed payload holds the samples
+ * as 12 bits each, 3 bytes per pair, the odd one out padded with a zero
+ * partner. A Rice payload is its length in bytes, these two included, then
+ * the samples compressed by rice_encode. An encoder asked for Rice frames
+ * still sends a packed one whenever compression wouldn't make it smaller, so
+ * a frame is never longer than STREAM_FRAME_SZ of its samples.
+ */
+#ifndef INCLUDE_STREAM_H
+#define INCLUDE_STREAM_H
+
+#include "defs.h"
+
+#define STREAM_SYNC0 0xA5
+#define STREAM_SYNC1 0x5A
+#define STREAM_HEADER_SZ 18
+#define STREAM_CRC_SZ 2
+#define STREAM_CRC_INIT 0xFFFF
+#define STREAM_SAMPLES_MAX 1024
+#define STREAM_PAYLOAD_SZ(samples) (((samples) + 1) / 2 * 3)
+#define STREAM_FRAME_SZ(samples)                                               \
+    (STREAM_HEADER_SZ + STREAM_PAYLOAD_SZ(samples) + STREAM_CRC_SZ)
+#define STREAM_FRAME_MAX STREAM_FRAME_SZ(STREAM_SAMPLES_MAX)
+#define STREAM_RICE_LEN_SZ 2
+
+typedef enum {
+    STREAM_CODING_PACKED = 1,
+    STREAM_CODING_RICE = 2,
+} StreamCoding;
+
+typedef struct {
+    // frames encoded in each coding and the samples and payload bytes in them
+    u32 packed;
+    u32 rice;
+    u64 samples;
+    u64 payload_bytes;
+} StreamStats;
+
+typedef struct {
+    u8 channel_mask;
+    u32 sample_rate;
+    StreamCoding coding;
+    // sequence number of the next frame
+    u32 seq;
+    StreamStats stats;
+} StreamEncoder;
+
+RC stream_init(StreamEncoder *enc, u8 channel_mask, u32 sample_rate);
+RC stream_set_coding(StreamEncoder *enc, StreamCoding coding);
+
+/**
+ * Build the next frame from `n` 12 bit samples into `frame`, which must
+ * hold STREAM_FRAME_SZ(n) bytes, however well they compress.
+ */
+RC stream_encode(StreamEncoder *enc, const u16 *samples, usize n,
+                 u32 timestamp, u8 *frame, usize sz, usize *len);
+// account for a frame that wasn't sent, so the host sees the gap
+void stream_skip(StreamEncoder *enc);
+
+void stream_pack12(const u16 *samples, usize n, u8 *out);
+void stream_unpack12(const u8 *in, usize n, u16 *samples);
+u16 stream_crc16(u16 crc, const u8 *bytes, usize sz);
+
+#endif // INCLUDE_STREAM_H
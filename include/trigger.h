@@ -0,0 +1,26 @@
+/**
+ * trigger.h
+ *
+ * Software edge trigger over a block of raw ADC samples. A crossing only
+ * counts once the signal has first been on the far side of the level by at
+ * least the hysteresis, so noise riding on the level does not retrigger.
+ */
+#ifndef INCLUDE_TRIGGER_H
+#define INCLUDE_TRIGGER_H
+
+#include "defs.h"
+
+typedef enum {
+    TRIGGER_RISING,
+    TRIGGER_FALLING,
+} TriggerEdge;
+
+typedef struct {
+    TriggerEdge edge;
+    u16 level;
+    u16 hysteresis;
+} Trigger;
+
+RC trigger_find(const Trigger *trig, const u16 *samples, usize sz, usize *idx);
+
+#endif // INCLUDE_TRIGGER_H
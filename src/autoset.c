@@ -0,0 +1,172 @@
+#include "autoset.h"
+
+// smallest half peak-to-peak (in counts) treated as a signal rather than noise
+#define AUTOSET_NOISE_FLOOR 16
+// trigger hysteresis as a multiple of the mean sample-to-sample step, which
+// is dominated by noise when a slow signal is captured at a fast rate
+#define AUTOSET_NOISE_HYSTERESIS 4
+// rising crossings needed (2 full periods) before a frequency is trusted
+#define AUTOSET_CROSSINGS_MIN 3
+// headroom left above the signal peak when picking the vertical scale
+#define AUTOSET_HEADROOM 1.05
+
+static double choose_scale(const AutosetConfig *cfg, u16 peak);
+static u32 choose_rate(const AutosetConfig *cfg, double frequency);
+
+RC autoset_estimate(const u16 *samples, usize sz, u32 rate,
+                    AutosetEstimate *est) {
+    if (sz == 0) {
+        return RC_BUF_LENGTH;
+    }
+    u16 min = samples[0];
+    u16 max = samples[0];
+    u64 sum = 0;
+    u64 steps = 0;
+    for (usize i = 0; i < sz; ++i) {
+        u16 x = samples[i];
+        min = x < min ? x : min;
+        max = x > max ? x : max;
+        sum += x;
+        if (i > 0) {
+            steps += x > samples[i - 1] ? x - samples[i - 1]
+                                        : samples[i - 1] - x;
+        }
+    }
+    est->min = min;
+    est->max = max;
+    est->mean = sum / sz;
+    est->amplitude = (max - min) / 2;
+    est->frequency = 0;
+    if (est->amplitude < AUTOSET_NOISE_FLOOR) {
+        return RC_OK;
+    }
+
+    // count rising crossings of the midpoint, measuring the span between the
+    // first and last one to average the period over the whole capture. Noise
+    // on a capture that only sees part of a slow period can cross the level
+    // more than once, so a crossing only counts once the signal has risen the
+    // hysteresis above the level since the last one
+    u32 hysteresis = AUTOSET_NOISE_HYSTERESIS * steps / sz;
+    if (hysteresis < est->amplitude / 4) {
+        hysteresis = est->amplitude / 4;
+    } else if (hysteresis > est->amplitude / 2) {
+        hysteresis = est->amplitude / 2;
+    }
+    Trigger trig = {
+        .edge = TRIGGER_RISING,
+        .level = min + est->amplitude,
+        .hysteresis = hysteresis,
+    };
+    usize ncrossings = 0;
+    usize first = 0, last = 0, pos = 0;
+    while (pos < sz) {
+        usize idx;
+        if (trigger_find(&trig, samples + pos, sz - pos, &idx) != RC_OK) {
+            break;
+        }
+        last = pos + idx;
+        if (ncrossings == 0) {
+            first = last;
+        }
+        ++ncrossings;
+        // a period has to carry the signal clear of the level both ways
+        pos = last + 1;
+        while (pos < sz && samples[pos] < trig.level + hysteresis) {
+            ++pos;
+        }
+    }
+    if (ncrossings >= AUTOSET_CROSSINGS_MIN && last > first) {
+        est->frequency = (double)rate * (ncrossings - 1) / (last - first);
+    }
+    return RC_OK;
+}
+
+RC autoset_run(const AutosetConfig *cfg, AutosetCapture capture, void *ctx,
+               AutosetResult *res) {
+    if (cfg->nrates == 0) {
+        return RC_INVALID_OPT;
+    }
+    if (cfg->buf == NULL || cfg->sz == 0) {
+        return RC_BUF_LENGTH;
+    }
+
+    AutosetEstimate est = {0};
+    u16 min = cfg->adc_max;
+    u16 max = 0;
+    usize i = 0;
+    while (1) {
+        u32 actual_rate;
+        RC rc = capture(ctx, cfg->rates[i], cfg->buf, cfg->sz, &actual_rate);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        rc = autoset_estimate(cfg->buf, cfg->sz, actual_rate, &est);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        // fast captures of a slow signal only see part of a period, so keep
+        // the extremes seen across the whole sweep
+        min = est.min < min ? est.min : min;
+        max = est.max > max ? est.max : max;
+        if (est.frequency > 0 || i == cfg->nrates - 1) {
+            break;
+        }
+        i += AUTOSET_SWEEP_STEP;
+        if (i >= cfg->nrates) {
+            i = cfg->nrates - 1;
+        }
+    }
+
+    est.min = min;
+    est.max = max;
+    est.amplitude = (max - min) / 2;
+    res->estimate = est;
+    res->scale = choose_scale(cfg, max);
+    res->rate = est.frequency > 0 ? choose_rate(cfg, est.frequency)
+                                  : cfg->rates[cfg->nrates - 1];
+    res->trigger.edge = TRIGGER_RISING;
+    res->trigger.level = min + est.amplitude;
+    res->trigger.hysteresis = est.amplitude / 4;
+    return RC_OK;
+}
+
+static double choose_scale(const AutosetConfig *cfg, u16 peak) {
+    static const double STEPS[] = {1.0, 2.0, 5.0};
+    double target = AUTOSET_HEADROOM * cfg->full_scale * peak / cfg->adc_max;
+    for (double decade = 0.01; decade <= cfg->full_scale; decade *= 10) {
+        for (usize i = 0; i < sizeof(STEPS) / sizeof(STEPS[0]); ++i) {
+            double scale = STEPS[i] * decade;
+            if (scale >= target) {
+                return scale < cfg->full_scale ? scale : cfg->full_scale;
+            }
+        }
+    }
+    return cfg->full_scale;
+}
+
+static u32 choose_rate(const AutosetConfig *cfg, double frequency) {
+    // rate that puts exactly AUTOSET_PERIODS across the screen, then the
+    // available rate with the smallest ratio to it, passing over any that
+    // show fewer than AUTOSET_PERIODS_MIN or more than AUTOSET_PERIODS_MAX
+    // unless the table has nothing between them
+    double ideal = frequency * cfg->screen_samples / AUTOSET_PERIODS;
+    u32 best = cfg->rates[0];
+    double best_ratio = 0;
+    _Bool best_fits = 0;
+    for (usize i = 0; i < cfg->nrates; ++i) {
+        double periods = frequency * cfg->screen_samples / cfg->rates[i];
+        _Bool fits =
+            periods >= AUTOSET_PERIODS_MIN && periods <= AUTOSET_PERIODS_MAX;
+        double ratio = cfg->rates[i] / ideal;
+        if (ratio < 1) {
+            ratio = 1 / ratio;
+        }
+        if (i == 0 || fits > best_fits ||
+            (fits == best_fits && ratio < best_ratio)) {
+            best = cfg->rates[i];
+            best_ratio = ratio;
+            best_fits = fits;
+        }
+    }
+    return best;
+}
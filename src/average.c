@@ -0,0 +1,202 @@
+#include "average.h"
+
+#define ENVELOPE_LO(word) ((u16)((word) & 0xFFFF))
+#define ENVELOPE_HI(word) ((u16)((word) >> 16))
+#define ENVELOPE_PACK(lo, hi) (((u32)(hi) << 16) | (u32)(lo))
+
+static void seed(u32 *restrict acc, const u16 *restrict samples, usize sz,
+                 u32 shift);
+static void seed_envelope(u32 *restrict acc, const u16 *restrict samples,
+                          usize sz);
+static void accumulate_sum(u32 *restrict acc, const u16 *restrict samples,
+                           usize sz);
+static void accumulate_exponential(u32 *restrict acc,
+                                   const u16 *restrict samples, usize sz,
+                                   usize shift);
+static void accumulate_envelope(u32 *restrict acc, const u16 *restrict samples,
+                                usize sz);
+
+RC average_init(Averager *avg, AverageMode mode, u32 *acc, usize sz) {
+    if (acc == NULL || sz == 0) {
+        return RC_BUF_LENGTH;
+    }
+    avg->mode = mode;
+    avg->acc = acc;
+    avg->sz = sz;
+    return average_set_count(avg, AVERAGE_COUNT_MIN);
+}
+
+RC average_set_count(Averager *avg, usize count) {
+    if (count < AVERAGE_COUNT_MIN || count > AVERAGE_COUNT_MAX) {
+        return RC_INVALID_OPT;
+    }
+    avg->count = count;
+    // exponential weighting uses the largest power of two <= count so the
+    // update is a shift instead of a divide
+    avg->shift = 0;
+    while ((2u << avg->shift) <= count) {
+        ++avg->shift;
+    }
+    return average_reset(avg);
+}
+
+RC average_reset(Averager *avg) {
+    avg->nacquired = 0;
+    return RC_OK;
+}
+
+RC average_update(Averager *avg, const u16 *samples, usize sz) {
+    if (sz > avg->sz) {
+        return RC_BUF_LENGTH;
+    }
+    // ensemble and envelope restart once a full set has been presented
+    _Bool restart = avg->nacquired == 0 || (avg->mode != AVERAGE_EXPONENTIAL &&
+                                            avg->nacquired >= avg->count);
+    switch (avg->mode) {
+    case AVERAGE_OFF:
+        seed(avg->acc, samples, sz, 0);
+        avg->nacquired = 1;
+        return RC_OK;
+    case AVERAGE_ENSEMBLE:
+        if (restart) {
+            seed(avg->acc, samples, sz, 0);
+            avg->nacquired = 0;
+        } else {
+            accumulate_sum(avg->acc, samples, sz);
+        }
+        break;
+    case AVERAGE_EXPONENTIAL:
+        if (restart) {
+            seed(avg->acc, samples, sz, AVERAGE_FRAC_BITS);
+        } else {
+            accumulate_exponential(avg->acc, samples, sz, avg->shift);
+        }
+        // saturate so the counter never wraps back into a restart
+        if (avg->nacquired >= avg->count) {
+            return RC_OK;
+        }
+        break;
+    case AVERAGE_ENVELOPE:
+        if (restart) {
+            seed_envelope(avg->acc, samples, sz);
+            avg->nacquired = 0;
+        } else {
+            accumulate_envelope(avg->acc, samples, sz);
+        }
+        break;
+    default:
+        return RC_INVALID_OPT;
+    }
+    ++avg->nacquired;
+    return RC_OK;
+}
+
+_Bool average_ready(const Averager *avg) {
+    switch (avg->mode) {
+    case AVERAGE_OFF:
+    case AVERAGE_EXPONENTIAL:
+        return avg->nacquired > 0;
+    default:
+        return avg->nacquired >= avg->count;
+    }
+}
+
+RC average_read(const Averager *avg, u16 *out, usize sz) {
+    if (sz > avg->sz) {
+        return RC_BUF_LENGTH;
+    }
+    if (avg->nacquired == 0) {
+        return RC_NOT_OPEN;
+    }
+    const u32 *acc = avg->acc;
+    switch (avg->mode) {
+    case AVERAGE_OFF:
+        for (usize i = 0; i < sz; ++i) {
+            out[i] = acc[i];
+        }
+        break;
+    case AVERAGE_ENSEMBLE: {
+        // divide only happens once per completed set, not per acquisition
+        u32 n = avg->nacquired;
+        u32 half = n >> 1;
+        for (usize i = 0; i < sz; ++i) {
+            out[i] = (acc[i] + half) / n;
+        }
+        break;
+    }
+    case AVERAGE_EXPONENTIAL: {
+        u32 half = 1u << (AVERAGE_FRAC_BITS - 1);
+        for (usize i = 0; i < sz; ++i) {
+            out[i] = (acc[i] + half) >> AVERAGE_FRAC_BITS;
+        }
+        break;
+    }
+    default:
+        return RC_INVALID_OPT;
+    }
+    return RC_OK;
+}
+
+RC average_read_envelope(const Averager *avg, u16 *lo, u16 *hi, usize sz) {
+    if (avg->mode != AVERAGE_ENVELOPE) {
+        return RC_INVALID_OPT;
+    }
+    if (sz > avg->sz) {
+        return RC_BUF_LENGTH;
+    }
+    if (avg->nacquired == 0) {
+        return RC_NOT_OPEN;
+    }
+    for (usize i = 0; i < sz; ++i) {
+        lo[i] = ENVELOPE_LO(avg->acc[i]);
+        hi[i] = ENVELOPE_HI(avg->acc[i]);
+    }
+    return RC_OK;
+}
+
+// the accumulation loops below are kept branch-free over `restrict` pointers
+// so the compiler can unroll and vectorize them
+static void seed(u32 *restrict acc, const u16 *restrict samples, usize sz,
+                 u32 shift) {
+    for (usize i = 0; i < sz; ++i) {
+        acc[i] = (u32)samples[i] << shift;
+    }
+}
+
+static void seed_envelope(u32 *restrict acc, const u16 *restrict samples,
+                          usize sz) {
+    for (usize i = 0; i < sz; ++i) {
+        acc[i] = ENVELOPE_PACK(samples[i], samples[i]);
+    }
+}
+
+static void accumulate_sum(u32 *restrict acc, const u16 *restrict samples,
+                           usize sz) {
+    // 256 acquisitions of 12-bit samples need 20 bits, so this cannot overflow
+    for (usize i = 0; i < sz; ++i) {
+        acc[i] += samples[i];
+    }
+}
+
+static void accumulate_exponential(u32 *restrict acc,
+                                   const u16 *restrict samples, usize sz,
+                                   usize shift) {
+    // acc += (x - acc) / 2^shift, in Q16 fixed point
+    for (usize i = 0; i < sz; ++i) {
+        i32 a = (i32)acc[i];
+        i32 x = (i32)samples[i] << AVERAGE_FRAC_BITS;
+        acc[i] = (u32)(a + ((x - a) >> shift));
+    }
+}
+
+static void accumulate_envelope(u32 *restrict acc, const u16 *restrict samples,
+                                usize sz) {
+    for (usize i = 0; i < sz; ++i) {
+        u16 lo = ENVELOPE_LO(acc[i]);
+        u16 hi = ENVELOPE_HI(acc[i]);
+        u16 x = samples[i];
+        lo = x < lo ? x : lo;
+        hi = x > hi ? x : hi;
+        acc[i] = ENVELOPE_PACK(lo, hi);
+    }
+}
@@ -0,0 +1,271 @@
+#include "command.h"
+#include <string.h>
+
+// ten to the power of anything past this is no setting this board has
+#define EXPONENT_MAX 30
+
+static void run(CommandParser *parser, char *cmd);
+static const Command *lookup(const CommandParser *parser, const char *header,
+                             usize len);
+static _Bool node_matches(const char *pattern, usize plen, const char *node,
+                          usize nlen);
+static void reply_error(CommandParser *parser, const char *header, usize len,
+                        const char *what);
+static usize append(char *buf, usize sz, usize len, const char *text,
+                    usize n);
+static _Bool is_space(char c);
+static _Bool is_digit(char c);
+static char to_upper(char c);
+
+RC command_init(CommandParser *parser, const Command *commands,
+                usize ncommands, CommandReply reply, void *ctx) {
+    if (commands == NULL || ncommands == 0 || reply == NULL) {
+        return RC_INVALID_OPT;
+    }
+    parser->commands = commands;
+    parser->ncommands = ncommands;
+    parser->reply = reply;
+    parser->ctx = ctx;
+    parser->len = 0;
+    parser->overflow = 0;
+    parser->stats = (CommandStats){0};
+    return RC_OK;
+}
+
+void command_feed(CommandParser *parser, const u8 *bytes, usize sz) {
+    for (usize i = 0; i < sz; ++i) {
+        char c = bytes[i];
+        if (c != '\n' && c != '\r') {
+            if (parser->len + 1 < COMMAND_LINE_MAX) {
+                parser->line[parser->len++] = c;
+            } else {
+                parser->overflow = 1;
+            }
+            continue;
+        }
+        // either ending works, and the empty line between \r and \n is
+        // ignored
+        if (parser->overflow) {
+            ++parser->stats.lines;
+            reply_error(parser, NULL, 0, "line too long");
+        } else if (parser->len > 0) {
+            parser->line[parser->len] = '\0';
+            command_execute(parser, parser->line);
+        }
+        parser->len = 0;
+        parser->overflow = 0;
+    }
+}
+
+void command_execute(CommandParser *parser, char *line) {
+    ++parser->stats.lines;
+    while (line != NULL) {
+        char *end = strchr(line, ';');
+        if (end != NULL) {
+            *end++ = '\0';
+        }
+        run(parser, line);
+        line = end;
+    }
+}
+
+RC command_parse_number(const char *text, double *value) {
+    const char *s = text;
+    _Bool negative = *s == '-';
+    if (*s == '+' || *s == '-') {
+        ++s;
+    }
+    double mantissa = 0;
+    i32 exponent = 0;
+    usize digits = 0;
+    for (; is_digit(*s); ++s, ++digits) {
+        mantissa = 10 * mantissa + (*s - '0');
+    }
+    if (*s == '.') {
+        for (++s; is_digit(*s); ++s, ++digits) {
+            mantissa = 10 * mantissa + (*s - '0');
+            --exponent;
+        }
+    }
+    if (digits == 0) {
+        return RC_INVALID_OPT;
+    }
+    if (*s == 'e' || *s == 'E') {
+        ++s;
+        _Bool exp_negative = *s == '-';
+        if (*s == '+' || *s == '-') {
+            ++s;
+        }
+        i32 exp = 0;
+        usize exp_digits = 0;
+        for (; is_digit(*s); ++s, ++exp_digits) {
+            // saturate, anything this large is rejected below anyway
+            exp = exp < 1000 ? 10 * exp + (*s - '0') : exp;
+        }
+        if (exp_digits == 0) {
+            return RC_INVALID_OPT;
+        }
+        exponent += exp_negative ? -exp : exp;
+    }
+    if (*s != '\0' || exponent > EXPONENT_MAX || exponent < -EXPONENT_MAX) {
+        return RC_INVALID_OPT;
+    }
+    // dividing for negative exponents, since 0.1 isn't exact
+    double scale = 1;
+    for (i32 i = exponent < 0 ? -exponent : exponent; i > 0; --i) {
+        scale *= 10;
+    }
+    mantissa = exponent < 0 ? mantissa / scale : mantissa * scale;
+    *value = negative ? -mantissa : mantissa;
+    return RC_OK;
+}
+
+static void run(CommandParser *parser, char *cmd) {
+    while (is_space(*cmd)) {
+        ++cmd;
+    }
+    if (*cmd == '\0') {
+        return;
+    }
+    const char *header = cmd;
+    while (*cmd != '\0' && !is_space(*cmd)) {
+        ++cmd;
+    }
+    usize len = cmd - header;
+    while (is_space(*cmd)) {
+        ++cmd;
+    }
+    char *arg = cmd;
+    char *end = arg + strlen(arg);
+    while (end > arg && is_space(end[-1])) {
+        --end;
+    }
+    *end = '\0';
+
+    _Bool query = header[len - 1] == '?';
+    const Command *command = lookup(parser, header, query ? len - 1 : len);
+    if (command == NULL) {
+        reply_error(parser, header, len, "undefined header");
+        return;
+    }
+    RC rc;
+    if (query) {
+        if (command->query == NULL) {
+            reply_error(parser, header, len, "not a query");
+            return;
+        }
+        if (*arg != '\0') {
+            reply_error(parser, header, len, "unexpected argument");
+            return;
+        }
+        parser->out[0] = '\0';
+        rc = command->query(parser->ctx, parser->out, sizeof(parser->out));
+        if (rc == RC_OK) {
+            ++parser->stats.executed;
+            parser->reply(parser->ctx, parser->out);
+            return;
+        }
+    } else {
+        double value;
+        if (command->set == NULL) {
+            reply_error(parser, header, len, "query only");
+            return;
+        }
+        if (command_parse_number(arg, &value) != RC_OK) {
+            reply_error(parser, header, len, "bad number");
+            return;
+        }
+        rc = command->set(parser->ctx, value);
+        if (rc == RC_OK) {
+            ++parser->stats.executed;
+            return;
+        }
+    }
+    reply_error(parser, header, len, rcstr(rc));
+}
+
+static const Command *lookup(const CommandParser *parser, const char *header,
+                             usize len) {
+    // the leading colon is optional on either side
+    if (len > 0 && header[0] == ':') {
+        ++header;
+        --len;
+    }
+    for (usize i = 0; i < parser->ncommands; ++i) {
+        const char *pattern = parser->commands[i].header;
+        pattern += *pattern == ':';
+        const char *node = header;
+        usize left = len;
+        while (1) {
+            usize plen = strcspn(pattern, ":");
+            usize nlen = 0;
+            while (nlen < left && node[nlen] != ':') {
+                ++nlen;
+            }
+            if (!node_matches(pattern, plen, node, nlen)) {
+                break;
+            }
+            pattern += plen;
+            node += nlen;
+            left -= nlen;
+            if (*pattern == '\0' && left == 0) {
+                return &parser->commands[i];
+            }
+            if (*pattern != ':' || left == 0) {
+                break;
+            }
+            ++pattern;
+            ++node;
+            --left;
+        }
+    }
+    return NULL;
+}
+
+static _Bool node_matches(const char *pattern, usize plen, const char *node,
+                          usize nlen) {
+    // the short form is everything up to the first lower case letter
+    usize slen = 0;
+    while (slen < plen && to_upper(pattern[slen]) == pattern[slen]) {
+        ++slen;
+    }
+    if (nlen == 0 || (nlen != slen && nlen != plen)) {
+        return 0;
+    }
+    for (usize i = 0; i < nlen; ++i) {
+        if (to_upper(node[i]) != to_upper(pattern[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void reply_error(CommandParser *parser, const char *header, usize len,
+                        const char *what) {
+    char *out = parser->out;
+    usize sz = sizeof(parser->out);
+    usize n = append(out, sz, 0, "ERR ", 4);
+    if (header != NULL) {
+        n = append(out, sz, n, header, len);
+        n = append(out, sz, n, ": ", 2);
+    }
+    append(out, sz, n, what, strlen(what));
+    ++parser->stats.errors;
+    parser->reply(parser->ctx, out);
+}
+
+static usize append(char *buf, usize sz, usize len, const char *text,
+                    usize n) {
+    // truncates rather than fails, an error is worth sending in part
+    while (n-- > 0 && len + 1 < sz) {
+        buf[len++] = *text++;
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+static _Bool is_space(char c) { return c == ' ' || c == '\t'; }
+
+static _Bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+static char to_upper(char c) { return c >= 'a' && c <= 'z' ? c - 32 : c; }
@@ -20,6 +20,14 @@ const char *rcstr(RC rc) {
         return "Too many channels";
     case RC_BUF_LENGTH:
         return "Buffer is too small";
+    case RC_NO_TRIGGER:
+        return "No trigger found";
+    case RC_TIMEOUT:
+        return "Timed out";
+    case RC_NOT_READY:
+        return "Not ready";
+    case RC_WRITE_FAILED:
+        return "Write failed";
     default:
         return "?";
     }
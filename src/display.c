@@ -1,4 +1,5 @@
 #include "display.h"
+#include "fmt.h"
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
@@ -6,59 +7,178 @@
 #define YAXIS_BAR "      *"
 #define START_COL sizeof(YAXIS_BAR)
 
+#define BRAILLE_BASE 0x2800
+#define BRAILLE_DOTS_WIDE 2
+#define BRAILLE_DOTS_TALL 4
+
 #define HIDE_CURSOR "\033[?25l"
 #define CLEAR_SCREEN "\033c"
+// left/right margin mode, needed before DECSLRM margins take effect
+#define ENABLE_LR_MARGINS "\033[?69h"
+#define DISABLE_LR_MARGINS "\033[?69l"
+#define RESET_TB_MARGINS "\033[r"
 
 #define RESET "\033[0m"
-#define BLACK "\033[30m"
-#define RED "\033[31m"
-#define GREEN "\033[32m"
-#define YELLOW "\033[33m"
-#define BLUE "\033[34m"
-#define MAGENTA "\033[35m"
-#define CYAN "\033[36m"
-#define WHITE "\033[37m"
-
-#define BOLDBLACK "\033[1m\033[30m"
-#define BOLDRED "\033[1m\033[31m"
-#define BOLDGREEN "\033[1m\033[32m"
-#define BOLDYELLOW "\033[1m\033[33m"
-#define BOLDBLUE "\033[1m\033[34m"
-#define BOLDMAGENTA "\033[1m\033[35m"
-#define BOLDCYAN "\033[1m\033[36m"
-#define BOLDWHITE "\033[1m\033[37m"
-
-const char *COLORS[CHANNEL_COUNT_MAX] = {
-    BOLDGREEN,
-    BOLDYELLOW,
+
+// xterm colour indices, the first 16 have short SGR encodings
+#define COLOR_DEFAULT 0
+#define COLOR_RED 1
+#define COLOR_GREEN 2
+#define COLOR_YELLOW 3
+#define COLOR_BLUE 4
+#define COLOR_MAGENTA 5
+#define COLOR_CYAN 6
+#define COLOR_WHITE 7
+#define COLOR_BRIGHT 8
+
+// xterm 256-colour heat ramp, dark blue (rarely hit) through red (always hit)
+static const u8 PERSIST_RAMP[] = {
+    17, 18, 19, 20, 21, 27, 33, 39, 45, 51, 50, 49, 48,
+    47, 46, 82, 118, 154, 190, 226, 220, 214, 208, 202, 196,
+};
+#define PERSIST_RAMP_LEN (sizeof(PERSIST_RAMP) / sizeof(PERSIST_RAMP[0]))
+
+// default trace colour for each channel handle, the last is xterm orange
+static const u8 COLORS[CHANNEL_COUNT_MAX] = {
+    COLOR_BRIGHT + COLOR_GREEN,   COLOR_BRIGHT + COLOR_YELLOW,
+    COLOR_BRIGHT + COLOR_CYAN,    COLOR_BRIGHT + COLOR_MAGENTA,
+    COLOR_BRIGHT + COLOR_RED,     COLOR_BRIGHT + COLOR_BLUE,
+    COLOR_BRIGHT + COLOR_WHITE,   208,
+};
+
+// RGB565 trace colour for each channel handle, matching the terminal's
+static const u16 LCD_COLORS[CHANNEL_COUNT_MAX] = {
+    0x07E0, 0xFFE0, 0x07FF, 0xF81F, 0xF800, 0x435F, 0xFFFF, 0xFD20,
+};
+// RGB565 versions of PERSIST_RAMP, dark blue through to red
+static const u16 LCD_PERSIST_RAMP[] = {
+    0x000C, 0x0010, 0x0015, 0x001A, 0x001F, 0x02FF, 0x043F, 0x057F, 0x06BF,
+    0x07FF, 0x07FA, 0x07F5, 0x07F0, 0x07EC, 0x07E0, 0x67E0, 0x87E0, 0xAFE0,
+    0xD7E0, 0xFFE0, 0xFEA0, 0xFD60, 0xFC20, 0xFAE0, 0xF800,
 };
+#define LCD_PERSIST_RAMP_LEN                                                   \
+    (sizeof(LCD_PERSIST_RAMP) / sizeof(LCD_PERSIST_RAMP[0]))
+#define LCD_BACKGROUND 0x0000
+#define LCD_GRID 0x4208
+// divisions across and down the plot, as on a bench scope
+#define LCD_GRID_DIVS_X 10
+#define LCD_GRID_DIVS_Y 8
+// spacing of the dots making up grid lines
+#define LCD_GRID_DOT 4
+#define LCD_GRID_NONE 0
+#define LCD_GRID_DOTS 1
+#define LCD_GRID_LINE 2
+// lo of an empty span, above any hi
+#define LCD_SPAN_NONE 0xFF
+// header cells per channel before its name: the value in brackets, padded
+// to the widest fmt_volts output so the names don't shift as it changes
+#define LCD_HEADER_VALUE_WIDTH 11
+
+// significant digits of the voltages in the header and on the axis
+#define HEADER_DIGITS 4
+#define AXIS_DIGITS 4
+// width the channel name is padded to in the header
+#define HEADER_NAME_WIDTH 25
+
+// bytes buffered before handing terminal output to stdout, sized so a full
+// block of samples plus the header goes out in one write
+#define TERMINAL_OUT_SZ 2048
+// unchanged cells re-sent to bridge two dirty runs instead of a cursor move
+#define TERMINAL_GAP_MAX 4
+
+// pattern bit for each dot within a Braille cell, indexed [dot row][dot col]
+static const u8 BRAILLE_BITS[BRAILLE_DOTS_TALL][BRAILLE_DOTS_WIDE] = {
+    {0x01, 0x08},
+    {0x02, 0x10},
+    {0x04, 0x20},
+    {0x40, 0x80},
+};
+
+static struct {
+    char buf[TERMINAL_OUT_SZ];
+    usize len;
+} OUT;
 
 // shared functions
 static double clamp(double value, double range);
-static RC add_channel(Channel *channels, usize *nchannels, const char *name,
-                      ChannelHandle *hdl);
-static RC remove_channel(Channel *channels, usize *nchannels,
-                         ChannelHandle hdl);
+static RC add_channel(Channels *channels, const char *name, ChannelHandle *hdl);
+static RC remove_channel(Channels *channels, ChannelHandle hdl);
+static _Bool channel_valid(const Channels *channels, ChannelHandle hdl);
+static RC channel_set_scale(Channels *channels, ChannelHandle hdl,
+                            double scale);
+static RC channel_set_offset(Channels *channels, ChannelHandle hdl,
+                             double offset);
+static RC channel_set_visible(Channels *channels, ChannelHandle hdl,
+                              _Bool visible);
+static RC channel_set_priority(Channels *channels, ChannelHandle hdl,
+                               u8 priority);
 
 // terminal function declarations
 static RC terminal_open(TerminalDisplay *term, DisplayFile **file);
+static void terminal_init(TerminalDisplay *term, _Bool headless);
 static RC terminal_close(TerminalDisplay *term);
 static RC terminal_clear(TerminalDisplay *term);
 static RC terminal_draw_header(TerminalDisplay *term);
 static RC terminal_draw_axis(TerminalDisplay *term);
 static RC terminal_redraw(TerminalDisplay *term);
+static RC terminal_flush(TerminalDisplay *term);
 static RC terminal_add_channel(TerminalDisplay *term, const char *name,
                                ChannelHandle *hdl);
 static RC terminal_remove_channel(TerminalDisplay *term, ChannelHandle hdl);
 static RC terminal_set_scale(TerminalDisplay *file, double scale);
+static RC terminal_set_channel_scale(TerminalDisplay *term, ChannelHandle hdl,
+                                     double scale);
+static RC terminal_set_channel_offset(TerminalDisplay *term, ChannelHandle hdl,
+                                      double offset);
+static RC terminal_set_channel_visible(TerminalDisplay *term,
+                                       ChannelHandle hdl, _Bool visible);
+static RC terminal_set_channel_priority(TerminalDisplay *term,
+                                        ChannelHandle hdl, u8 priority);
 static RC terminal_set_y(TerminalDisplay *term, usize chars_tall);
 static RC terminal_set_x(TerminalDisplay *term, usize chars_wide);
-static RC terminal_position_cursor(TerminalDisplay *term, usize row, usize col);
+static RC terminal_set_style(TerminalDisplay *term, PlotStyle style);
+static RC terminal_set_sweep(TerminalDisplay *term, SweepMode sweep);
+static void terminal_set_margins(TerminalDisplay *term);
+static void terminal_roll(TerminalDisplay *term);
+static void terminal_restart(TerminalDisplay *term);
+static void terminal_erase_channel(TerminalDisplay *term, ChannelHandle hdl);
 static RC terminal_writev(TerminalDisplay *term, ChannelHandle hdl,
                           double *values, usize sz);
 static RC terminal_write(TerminalDisplay *term, ChannelHandle hdl,
                          double value);
+static void terminal_plot(TerminalDisplay *term, ChannelHandle hdl,
+                          double value);
 static usize terminal_xaxis(TerminalDisplay *term);
+static usize terminal_value_row(TerminalDisplay *term, double value);
+static i32 terminal_value_dot(TerminalDisplay *term, double value);
+static _Bool terminal_may_draw(TerminalDisplay *term, const Cell *cell,
+                               ChannelHandle hdl);
+static void terminal_set_dot(TerminalDisplay *term, i32 x, i32 y,
+                             ChannelHandle hdl);
+static void terminal_draw_line(TerminalDisplay *term, i32 x0, i32 y0, i32 x1,
+                               i32 y1, ChannelHandle hdl);
+static Cell terminal_axis_cell(TerminalDisplay *term, usize row, usize col);
+static void terminal_put_text(TerminalDisplay *term, usize row, usize col,
+                              const char *text, u8 color);
+static RC terminal_plot_size(TerminalDisplay *term, usize *rows, usize *cols);
+static void terminal_plot_cells(TerminalDisplay *term, usize *rows,
+                                usize *cols);
+static RC terminal_draw_persistence(TerminalDisplay *term,
+                                    const Persistence *persist);
+static RC terminal_set_zoom(TerminalDisplay *term, usize samples_per_point);
+static RC terminal_set_pan(TerminalDisplay *term, usize samples);
+static RC terminal_draw_history(TerminalDisplay *term, ChannelHandle hdl,
+                                const Pyramid *pyr, double volts_per_count);
+static void terminal_emit(TerminalDisplay *term, const char *bytes, usize sz);
+static void terminal_emit_glyph(TerminalDisplay *term, u16 glyph);
+static void terminal_emit_escape(TerminalDisplay *term, usize n, char final);
+static void terminal_emit_color(TerminalDisplay *term, u8 color);
+static void terminal_move_cursor(TerminalDisplay *term, usize row, usize col);
+static void terminal_out_flush(void);
+static RC terminal_snapshot(TerminalDisplay *term, char *buf, usize sz);
+
+// memory function declarations
+static RC memory_open(TerminalDisplay *term, DisplayFile **file);
 
 // lcd function declarations
 static RC lcd_open(LcdDisplay *lcd, DisplayFile **file);
@@ -69,29 +189,83 @@ static RC lcd_add_channel(LcdDisplay *lcd, const char *name,
                           ChannelHandle *hdl);
 static RC lcd_remove_channel(LcdDisplay *lcd, ChannelHandle hdl);
 static RC lcd_set_scale(LcdDisplay *file, double scale);
+static RC lcd_set_channel_scale(LcdDisplay *lcd, ChannelHandle hdl,
+                                double scale);
+static RC lcd_set_channel_offset(LcdDisplay *lcd, ChannelHandle hdl,
+                                 double offset);
+static RC lcd_set_channel_visible(LcdDisplay *lcd, ChannelHandle hdl,
+                                  _Bool visible);
+static RC lcd_set_channel_priority(LcdDisplay *lcd, ChannelHandle hdl,
+                                   u8 priority);
 static RC lcd_set_y(LcdDisplay *lcd, usize pixels_tall);
 static RC lcd_set_x(LcdDisplay *lcd, usize pixels_wide);
+static RC lcd_set_style(LcdDisplay *lcd, PlotStyle style);
+static RC lcd_set_sweep(LcdDisplay *lcd, SweepMode sweep);
 static RC lcd_writev(LcdDisplay *lcd, ChannelHandle hdl, double *values,
                      usize sz);
 static RC lcd_write(LcdDisplay *lcd, ChannelHandle hdl, double value);
+static RC lcd_plot_size(LcdDisplay *lcd, usize *rows, usize *cols);
+static RC lcd_draw_persistence(LcdDisplay *lcd, const Persistence *persist);
+static RC lcd_set_zoom(LcdDisplay *lcd, usize samples_per_point);
+static RC lcd_set_pan(LcdDisplay *lcd, usize samples);
+static RC lcd_draw_history(LcdDisplay *lcd, ChannelHandle hdl,
+                           const Pyramid *pyr, double volts_per_count);
+static RC lcd_set_transport(LcdDisplay *lcd, const LcdTransport *transport);
+static void lcd_plot(LcdDisplay *lcd, ChannelHandle hdl, double value);
+static void lcd_set_span(LcdDisplay *lcd, ChannelHandle hdl, usize col, u8 lo,
+                         u8 hi);
+static i32 lcd_value_row(LcdDisplay *lcd, double value);
+static usize lcd_span_index(const LcdDisplay *lcd, usize col);
+static void lcd_roll(LcdDisplay *lcd);
+static void lcd_erase_channel(LcdDisplay *lcd, ChannelHandle hdl);
+static void lcd_reset_spans(LcdDisplay *lcd);
+static void lcd_mark_dirty(LcdDisplay *lcd, usize col, u8 lo, u8 hi);
+static void lcd_mark_all(LcdDisplay *lcd);
+static usize lcd_draw_order(const LcdDisplay *lcd, ChannelHandle *order);
+static void lcd_build_grid(LcdDisplay *lcd);
+static void lcd_draw_header(LcdDisplay *lcd);
+static RC lcd_flush_header(LcdDisplay *lcd);
+static _Bool lcd_header_changed(const LcdDisplay *lcd, usize col);
+static void lcd_compose(const LcdDisplay *lcd, usize col, usize y0, usize y1,
+                        const ChannelHandle *order, usize norder, u16 *px);
+static RC lcd_flush(LcdDisplay *lcd);
 
 // singletons
+static TerminalDisplay TERMINAL_STATE;
 static DisplayFile TERMINAL = {
     .variant = TERMINAL_DISPLAY,
     .status = DISPLAY_CLOSED,
+    .display.terminal = &TERMINAL_STATE,
 };
 
+static LcdDisplay LCD_STATE;
 static DisplayFile LCD = {
     .variant = LCD_DISPLAY,
     .status = DISPLAY_CLOSED,
+    .display.lcd = &LCD_STATE,
+};
+
+// a second terminal's worth of framebuffers only fits on a host build
+#ifdef DISPLAY_MEMORY
+static TerminalDisplay MEMORY_STATE;
+#define MEMORY_STATE_PTR &MEMORY_STATE
+#else
+#define MEMORY_STATE_PTR NULL
+#endif
+static DisplayFile MEMORY = {
+    .variant = MEMORY_DISPLAY,
+    .status = DISPLAY_CLOSED,
+    .display.terminal = MEMORY_STATE_PTR,
 };
 
 RC display_open(DisplayOption opt, DisplayFile **file) {
     switch (opt) {
     case TERMINAL_DISPLAY:
-        return terminal_open(&TERMINAL.display.terminal, file);
+        return terminal_open(TERMINAL.display.terminal, file);
     case LCD_DISPLAY:
-        return lcd_open(&TERMINAL.display.lcd, file);
+        return lcd_open(LCD.display.lcd, file);
+    case MEMORY_DISPLAY:
+        return memory_open(MEMORY.display.terminal, file);
     default:
         return RC_INVALID_OPT;
     }
@@ -103,16 +277,23 @@ RC display_close(DisplayFile *file) {
         if (TERMINAL.status == DISPLAY_CLOSED) {
             return RC_NOT_OPEN;
         }
-        terminal_close(&file->display.terminal);
+        terminal_close(file->display.terminal);
         TERMINAL.status = DISPLAY_CLOSED;
         break;
     case LCD_DISPLAY:
         if (LCD.status == DISPLAY_CLOSED) {
             return RC_NOT_OPEN;
         }
-        lcd_close(&file->display.lcd);
+        lcd_close(file->display.lcd);
         LCD.status = DISPLAY_CLOSED;
         break;
+    case MEMORY_DISPLAY:
+        if (MEMORY.status == DISPLAY_CLOSED) {
+            return RC_NOT_OPEN;
+        }
+        terminal_close(file->display.terminal);
+        MEMORY.status = DISPLAY_CLOSED;
+        break;
     default:
         return RC_CLOSE_FAILED;
     }
@@ -125,9 +306,10 @@ RC display_add_channel(DisplayFile *file, const char *name,
     case INVALID_DISPLAY:
         return RC_INVALID_OPT;
     case TERMINAL_DISPLAY:
-        return terminal_add_channel(&file->display.terminal, name, hdl);
+    case MEMORY_DISPLAY:
+        return terminal_add_channel(file->display.terminal, name, hdl);
     case LCD_DISPLAY:
-        return lcd_add_channel(&file->display.lcd, name, hdl);
+        return lcd_add_channel(file->display.lcd, name, hdl);
     }
 }
 
@@ -136,9 +318,10 @@ RC display_remove_channel(DisplayFile *file, ChannelHandle hdl) {
     case INVALID_DISPLAY:
         return RC_INVALID_OPT;
     case TERMINAL_DISPLAY:
-        return terminal_remove_channel(&file->display.terminal, hdl);
+    case MEMORY_DISPLAY:
+        return terminal_remove_channel(file->display.terminal, hdl);
     case LCD_DISPLAY:
-        return lcd_remove_channel(&file->display.lcd, hdl);
+        return lcd_remove_channel(file->display.lcd, hdl);
     }
 }
 
@@ -147,9 +330,73 @@ RC display_set_scale(DisplayFile *file, double scale) {
     case INVALID_DISPLAY:
         return RC_INVALID_OPT;
     case TERMINAL_DISPLAY:
-        return terminal_set_scale(&file->display.terminal, scale);
+    case MEMORY_DISPLAY:
+        return terminal_set_scale(file->display.terminal, scale);
+    case LCD_DISPLAY:
+        return lcd_set_scale(file->display.lcd, scale);
+    }
+}
+
+RC display_set_channel_scale(DisplayFile *file, ChannelHandle hdl,
+                             double scale) {
+    switch (file->variant) {
+    case INVALID_DISPLAY:
+        return RC_INVALID_OPT;
+    case TERMINAL_DISPLAY:
+    case MEMORY_DISPLAY:
+        return terminal_set_channel_scale(file->display.terminal, hdl, scale);
+    case LCD_DISPLAY:
+        return lcd_set_channel_scale(file->display.lcd, hdl, scale);
+    default:
+        return RC_INVALID_OPT;
+    }
+}
+
+RC display_set_channel_offset(DisplayFile *file, ChannelHandle hdl,
+                              double offset) {
+    switch (file->variant) {
+    case INVALID_DISPLAY:
+        return RC_INVALID_OPT;
+    case TERMINAL_DISPLAY:
+    case MEMORY_DISPLAY:
+        return terminal_set_channel_offset(file->display.terminal, hdl,
+                                           offset);
+    case LCD_DISPLAY:
+        return lcd_set_channel_offset(file->display.lcd, hdl, offset);
+    default:
+        return RC_INVALID_OPT;
+    }
+}
+
+RC display_set_channel_visible(DisplayFile *file, ChannelHandle hdl,
+                               _Bool visible) {
+    switch (file->variant) {
+    case INVALID_DISPLAY:
+        return RC_INVALID_OPT;
+    case TERMINAL_DISPLAY:
+    case MEMORY_DISPLAY:
+        return terminal_set_channel_visible(file->display.terminal, hdl,
+                                            visible);
     case LCD_DISPLAY:
-        return lcd_set_scale(&file->display.lcd, scale);
+        return lcd_set_channel_visible(file->display.lcd, hdl, visible);
+    default:
+        return RC_INVALID_OPT;
+    }
+}
+
+RC display_set_channel_priority(DisplayFile *file, ChannelHandle hdl,
+                                u8 priority) {
+    switch (file->variant) {
+    case INVALID_DISPLAY:
+        return RC_INVALID_OPT;
+    case TERMINAL_DISPLAY:
+    case MEMORY_DISPLAY:
+        return terminal_set_channel_priority(file->display.terminal, hdl,
+                                             priority);
+    case LCD_DISPLAY:
+        return lcd_set_channel_priority(file->display.lcd, hdl, priority);
+    default:
+        return RC_INVALID_OPT;
     }
 }
 
@@ -158,9 +405,10 @@ RC display_clear(DisplayFile *file) {
     case INVALID_DISPLAY:
         return RC_INVALID_OPT;
     case TERMINAL_DISPLAY:
-        return terminal_clear(&file->display.terminal);
+    case MEMORY_DISPLAY:
+        return terminal_clear(file->display.terminal);
     case LCD_DISPLAY:
-        return lcd_clear(&file->display.lcd);
+        return lcd_clear(file->display.lcd);
     }
 }
 
@@ -169,9 +417,10 @@ RC display_redraw(DisplayFile *file) {
     case INVALID_DISPLAY:
         return RC_INVALID_OPT;
     case TERMINAL_DISPLAY:
-        return terminal_redraw(&file->display.terminal);
+    case MEMORY_DISPLAY:
+        return terminal_redraw(file->display.terminal);
     case LCD_DISPLAY:
-        return lcd_redraw(&file->display.lcd);
+        return lcd_redraw(file->display.lcd);
     }
 }
 
@@ -180,9 +429,10 @@ RC display_set_y(DisplayFile *file, usize dim) {
     case INVALID_DISPLAY:
         return RC_INVALID_OPT;
     case TERMINAL_DISPLAY:
-        return terminal_set_y(&file->display.terminal, dim);
+    case MEMORY_DISPLAY:
+        return terminal_set_y(file->display.terminal, dim);
     case LCD_DISPLAY:
-        return lcd_set_y(&file->display.lcd, dim);
+        return lcd_set_y(file->display.lcd, dim);
     }
 }
 
@@ -191,9 +441,10 @@ RC display_set_x(DisplayFile *file, usize dim) {
     case INVALID_DISPLAY:
         return RC_INVALID_OPT;
     case TERMINAL_DISPLAY:
-        return terminal_set_x(&file->display.terminal, dim);
+    case MEMORY_DISPLAY:
+        return terminal_set_x(file->display.terminal, dim);
     case LCD_DISPLAY:
-        return lcd_set_x(&file->display.lcd, dim);
+        return lcd_set_x(file->display.lcd, dim);
     }
 }
 
@@ -203,9 +454,10 @@ RC display_writev(DisplayFile *file, ChannelHandle hdl, double *values,
     case INVALID_DISPLAY:
         return RC_INVALID_OPT;
     case TERMINAL_DISPLAY:
-        return terminal_writev(&file->display.terminal, hdl, values, sz);
+    case MEMORY_DISPLAY:
+        return terminal_writev(file->display.terminal, hdl, values, sz);
     case LCD_DISPLAY:
-        return lcd_writev(&file->display.lcd, hdl, values, sz);
+        return lcd_writev(file->display.lcd, hdl, values, sz);
     }
 }
 
@@ -214,9 +466,158 @@ RC display_write(DisplayFile *file, ChannelHandle hdl, double value) {
     case INVALID_DISPLAY:
         return RC_INVALID_OPT;
     case TERMINAL_DISPLAY:
-        return terminal_write(&file->display.terminal, hdl, value);
+    case MEMORY_DISPLAY:
+        return terminal_write(file->display.terminal, hdl, value);
+    case LCD_DISPLAY:
+        return lcd_write(file->display.lcd, hdl, value);
+    }
+}
+
+RC display_set_style(DisplayFile *file, PlotStyle style) {
+    switch (file->variant) {
+    case INVALID_DISPLAY:
+        return RC_INVALID_OPT;
+    case TERMINAL_DISPLAY:
+    case MEMORY_DISPLAY:
+        return terminal_set_style(file->display.terminal, style);
+    case LCD_DISPLAY:
+        return lcd_set_style(file->display.lcd, style);
+    default:
+        return RC_INVALID_OPT;
+    }
+}
+
+RC display_set_sweep(DisplayFile *file, SweepMode sweep) {
+    switch (file->variant) {
+    case INVALID_DISPLAY:
+        return RC_INVALID_OPT;
+    case TERMINAL_DISPLAY:
+    case MEMORY_DISPLAY:
+        return terminal_set_sweep(file->display.terminal, sweep);
+    case LCD_DISPLAY:
+        return lcd_set_sweep(file->display.lcd, sweep);
+    default:
+        return RC_INVALID_OPT;
+    }
+}
+
+RC display_plot_size(DisplayFile *file, usize *rows, usize *cols) {
+    switch (file->variant) {
+    case INVALID_DISPLAY:
+        return RC_INVALID_OPT;
+    case TERMINAL_DISPLAY:
+    case MEMORY_DISPLAY:
+        return terminal_plot_size(file->display.terminal, rows, cols);
+    case LCD_DISPLAY:
+        return lcd_plot_size(file->display.lcd, rows, cols);
+    default:
+        return RC_INVALID_OPT;
+    }
+}
+
+RC display_draw_persistence(DisplayFile *file, const Persistence *persist) {
+    switch (file->variant) {
+    case INVALID_DISPLAY:
+        return RC_INVALID_OPT;
+    case TERMINAL_DISPLAY:
+    case MEMORY_DISPLAY:
+        return terminal_draw_persistence(file->display.terminal, persist);
+    case LCD_DISPLAY:
+        return lcd_draw_persistence(file->display.lcd, persist);
+    default:
+        return RC_INVALID_OPT;
+    }
+}
+
+RC display_set_zoom(DisplayFile *file, usize samples_per_point) {
+    switch (file->variant) {
+    case INVALID_DISPLAY:
+        return RC_INVALID_OPT;
+    case TERMINAL_DISPLAY:
+    case MEMORY_DISPLAY:
+        return terminal_set_zoom(file->display.terminal, samples_per_point);
+    case LCD_DISPLAY:
+        return lcd_set_zoom(file->display.lcd, samples_per_point);
+    default:
+        return RC_INVALID_OPT;
+    }
+}
+
+RC display_set_pan(DisplayFile *file, usize samples) {
+    switch (file->variant) {
+    case INVALID_DISPLAY:
+        return RC_INVALID_OPT;
+    case TERMINAL_DISPLAY:
+    case MEMORY_DISPLAY:
+        return terminal_set_pan(file->display.terminal, samples);
+    case LCD_DISPLAY:
+        return lcd_set_pan(file->display.lcd, samples);
+    default:
+        return RC_INVALID_OPT;
+    }
+}
+
+RC display_draw_history(DisplayFile *file, ChannelHandle hdl,
+                        const Pyramid *pyr, double volts_per_count) {
+    switch (file->variant) {
+    case INVALID_DISPLAY:
+        return RC_INVALID_OPT;
+    case TERMINAL_DISPLAY:
+    case MEMORY_DISPLAY:
+        return terminal_draw_history(file->display.terminal, hdl, pyr,
+                                     volts_per_count);
     case LCD_DISPLAY:
-        return lcd_write(&file->display.lcd, hdl, value);
+        return lcd_draw_history(file->display.lcd, hdl, pyr,
+                                volts_per_count);
+    default:
+        return RC_INVALID_OPT;
+    }
+}
+
+RC display_set_transport(DisplayFile *file, const LcdTransport *transport) {
+    switch (file->variant) {
+    case LCD_DISPLAY:
+        return lcd_set_transport(file->display.lcd, transport);
+    default:
+        return RC_INVALID_OPT;
+    }
+}
+
+RC display_stats(DisplayFile *file, DisplayStats *stats) {
+    switch (file->variant) {
+    case TERMINAL_DISPLAY:
+    case MEMORY_DISPLAY:
+        *stats = file->display.terminal->stats;
+        return RC_OK;
+    case LCD_DISPLAY:
+        *stats = file->display.lcd->stats;
+        return RC_OK;
+    default:
+        return RC_INVALID_OPT;
+    }
+}
+
+RC display_reset_stats(DisplayFile *file) {
+    switch (file->variant) {
+    case TERMINAL_DISPLAY:
+    case MEMORY_DISPLAY:
+        memset(&file->display.terminal->stats, 0, sizeof(DisplayStats));
+        return RC_OK;
+    case LCD_DISPLAY:
+        memset(&file->display.lcd->stats, 0, sizeof(DisplayStats));
+        return RC_OK;
+    default:
+        return RC_INVALID_OPT;
+    }
+}
+
+RC display_snapshot(DisplayFile *file, char *buf, usize sz) {
+    switch (file->variant) {
+    case TERMINAL_DISPLAY:
+    case MEMORY_DISPLAY:
+        return terminal_snapshot(file->display.terminal, buf, sz);
+    default:
+        return RC_INVALID_OPT;
     }
 }
 
@@ -230,15 +631,14 @@ double clamp(double value, double range) {
     }
 }
 
-RC add_channel(Channel *channels, usize *nchannels, const char *name,
-               ChannelHandle *hdl) {
+RC add_channel(Channels *channels, const char *name, ChannelHandle *hdl) {
     _Bool found_opening = 0;
     usize ch, i;
     char *buf;
 
     // probe for open positions before incrementing channel count
-    for (ch = 0; ch < *nchannels; ++ch) {
-        if (!channels[ch].active) {
+    for (ch = 0; ch < channels->count; ++ch) {
+        if (!channels->active[ch]) {
             found_opening = 1;
             break;
         }
@@ -246,14 +646,14 @@ RC add_channel(Channel *channels, usize *nchannels, const char *name,
 
     // if there is no opening then add a new channel
     if (!found_opening) {
-        if (*nchannels + 1 > CHANNEL_COUNT_MAX) {
+        if (channels->count + 1 > CHANNEL_COUNT_MAX) {
             return RC_CHANNEL_COUNT;
         }
-        ch = *nchannels;
+        ch = channels->count;
     }
 
     // copy name into place
-    buf = channels[ch].name;
+    buf = channels->name[ch];
     for (i = 0; i < CHANNEL_NAME_MAX; ++i) {
         char c = name[i];
         buf[i] = c;
@@ -265,76 +665,154 @@ RC add_channel(Channel *channels, usize *nchannels, const char *name,
         return RC_BUF_LENGTH;
     }
     *hdl = ch;
-    channels[ch].active = 1;
+    channels->active[ch] = 1;
+    channels->visible[ch] = 1;
+    channels->color[ch] = COLORS[ch];
+    // later channels draw over earlier ones until told otherwise
+    channels->priority[ch] = ch;
+    channels->offset[ch] = 0;
+    channels->last_value[ch] = 0;
+    channels->x[ch] = 0;
+    channels->last_y[ch] = -1;
     // if everything succeeded and we added a new channel, then increment val
     if (!found_opening) {
-        ++(*nchannels);
+        ++channels->count;
     }
     return RC_OK;
 }
 
-RC remove_channel(Channel *channels, usize *nchannels, ChannelHandle hdl) {
-    if (hdl >= *nchannels) {
+RC remove_channel(Channels *channels, ChannelHandle hdl) {
+    if (hdl >= channels->count) {
         return RC_INVALID_OPT;
     }
-    channels[hdl].active = 0;
-    memset(channels[hdl].name, 0, CHANNEL_NAME_MAX);
-    if (hdl == *nchannels - 1) {
-        (*nchannels)--;
+    channels->active[hdl] = 0;
+    memset(channels->name[hdl], 0, CHANNEL_NAME_MAX);
+    if (hdl == channels->count - 1) {
+        channels->count--;
     }
     return RC_OK;
 }
 
+_Bool channel_valid(const Channels *channels, ChannelHandle hdl) {
+    return hdl < channels->count && channels->active[hdl];
+}
+
+RC channel_set_scale(Channels *channels, ChannelHandle hdl, double scale) {
+    if (!channel_valid(channels, hdl) || scale <= 0) {
+        return RC_INVALID_OPT;
+    }
+    channels->scale[hdl] = scale;
+    return RC_OK;
+}
+
+RC channel_set_offset(Channels *channels, ChannelHandle hdl, double offset) {
+    if (!channel_valid(channels, hdl)) {
+        return RC_INVALID_OPT;
+    }
+    channels->offset[hdl] = offset;
+    return RC_OK;
+}
+
+RC channel_set_visible(Channels *channels, ChannelHandle hdl, _Bool visible) {
+    if (!channel_valid(channels, hdl)) {
+        return RC_INVALID_OPT;
+    }
+    channels->visible[hdl] = visible;
+    return RC_OK;
+}
+
+RC channel_set_priority(Channels *channels, ChannelHandle hdl, u8 priority) {
+    if (!channel_valid(channels, hdl)) {
+        return RC_INVALID_OPT;
+    }
+    channels->priority[hdl] = priority;
+    return RC_OK;
+}
+
 // terminal implementations
 RC terminal_open(TerminalDisplay *term, DisplayFile **file) {
     if (TERMINAL.status == DISPLAY_OPEN) {
         return RC_ALREADY_OPEN;
     }
     TERMINAL.status = DISPLAY_OPEN;
-    term->col = START_COL;
+    terminal_init(term, 0);
     *file = &TERMINAL;
     return RC_OK;
 }
 
+void terminal_init(TerminalDisplay *term, _Bool headless) {
+    term->headless = headless;
+    term->style = PLOT_CELLS;
+    term->sweep = SWEEP_WRAP;
+    term->pending_roll = 0;
+    term->zoom = 1;
+    term->pan = 0;
+    term->cursor_row = -1;
+    term->cursor_col = -1;
+    term->color = -1;
+    // a display opened again, as the host tests do, starts with no channels
+    memset(&term->channels, 0, sizeof(Channels));
+    memset(&term->stats, 0, sizeof(DisplayStats));
+}
+
 RC terminal_close(TerminalDisplay *term) { return RC_OK; }
 
 RC terminal_clear(TerminalDisplay *term) {
-    printf(CLEAR_SCREEN HIDE_CURSOR "");
+    Cell blank = {.glyph = ' ', .color = COLOR_DEFAULT, .owner = 0};
+    terminal_emit(term, CLEAR_SCREEN HIDE_CURSOR,
+                  sizeof(CLEAR_SCREEN HIDE_CURSOR) - 1);
+    terminal_out_flush();
+    // a full reset leaves the cursor home with default attributes
+    for (usize row = 0; row < TERMINAL_ROWS_MAX; ++row) {
+        for (usize col = 0; col < TERMINAL_COLS_MAX; ++col) {
+            term->front[row][col] = blank;
+            term->back[row][col] = blank;
+        }
+    }
+    term->cursor_row = 0;
+    term->cursor_col = 0;
+    term->color = COLOR_DEFAULT;
     return RC_OK;
 }
 
 RC terminal_draw_header(TerminalDisplay *term) {
-    terminal_position_cursor(term, 0, 0);
-    for (usize i = 0; i < term->nchannels; ++i) {
-        Channel *ch = &term->channels[i];
-        if (ch->active) {
-            printf("%s(%.5lf) %-25s", COLORS[i], ch->last_value, ch->name);
+    char text[CHANNEL_NAME_MAX + 32];
+    usize col = 0;
+    Channels *ch = &term->channels;
+    for (usize i = 0; i < ch->count; ++i) {
+        if (ch->active[i] && ch->visible[i]) {
+            usize len = 0;
+            text[len++] = '(';
+            len += fmt_volts(text + len, sizeof(text) - len, ch->last_value[i],
+                             HEADER_DIGITS);
+            text[len++] = ')';
+            text[len++] = ' ';
+            usize name_start = len;
+            for (const char *c = ch->name[i]; *c; ++c) {
+                text[len++] = *c;
+            }
+            len = fmt_pad(text, sizeof(text), len,
+                          name_start + HEADER_NAME_WIDTH);
+            terminal_put_text(term, 0, col, text, ch->color[i]);
+            col += len;
         }
     }
-    printf(RESET "\n");
+    terminal_put_text(term, 0, col, "", COLOR_DEFAULT);
     return RC_OK;
 }
 
 RC terminal_draw_axis(TerminalDisplay *term) {
-    usize xaxis_row = terminal_xaxis(term);
-    usize last_row = term->chars_tall - 1;
+    char label[16];
     for (usize row = term->reserved_rows; row < term->chars_tall; ++row) {
-        if (row == term->reserved_rows) {
-            // top end label
-            printf("%.3lfV\n", term->scale);
-        } else if (row == last_row) {
-            // bottom end label
-            printf("-%.3lfV\n", term->scale);
-        } else if (row == xaxis_row) {
-            terminal_position_cursor(term, row, START_COL);
-            for (usize j = START_COL; j < term->chars_wide; ++j) {
-                printf("*");
-            }
-            printf("\n");
-        } else {
-            printf(YAXIS_BAR "\n");
+        for (usize col = 0; col < term->chars_wide; ++col) {
+            term->back[row][col] = terminal_axis_cell(term, row, col);
         }
     }
+    // end labels overwrite the start of the y axis bar
+    fmt_volts(label, sizeof(label), term->scale, AXIS_DIGITS);
+    terminal_put_text(term, term->reserved_rows, 0, label, COLOR_DEFAULT);
+    fmt_volts(label, sizeof(label), -term->scale, AXIS_DIGITS);
+    terminal_put_text(term, term->chars_tall - 1, 0, label, COLOR_DEFAULT);
     return RC_OK;
 }
 
@@ -344,6 +822,8 @@ RC terminal_redraw(TerminalDisplay *term) {
     if (rc != RC_OK) {
         return rc;
     }
+    // the reset also dropped any scroll margins
+    terminal_set_margins(term);
     rc = terminal_draw_header(term);
     if (rc != RC_OK) {
         return rc;
@@ -352,107 +832,1267 @@ RC terminal_redraw(TerminalDisplay *term) {
     if (rc != RC_OK) {
         return rc;
     }
+    return terminal_flush(term);
+}
+
+RC terminal_flush(TerminalDisplay *term) {
+    if (term->pending_roll) {
+        // SL (CSI n SP @) scrolls the area inside the margins left, the
+        // front buffer was already scrolled to match
+        char buf[FMT_INT_MAX + 4];
+        usize len = fmt_csi(buf, sizeof(buf) - 1, term->pending_roll, ' ');
+        buf[len++] = '@';
+        terminal_emit(term, buf, len);
+        term->pending_roll = 0;
+    }
+    ++term->stats.flushes;
+    for (usize row = 0; row < term->chars_tall; ++row) {
+        Cell *back = term->back[row];
+        Cell *front = term->front[row];
+        usize col = 0;
+        while (col < term->chars_wide) {
+            if (back[col].glyph == front[col].glyph &&
+                back[col].color == front[col].color) {
+                ++col;
+                continue;
+            }
+            terminal_move_cursor(term, row, col);
+            // emit the dirty run, re-sending short stretches of unchanged
+            // cells when that is cheaper than moving the cursor over them
+            while (col < term->chars_wide) {
+                usize gap = 0;
+                while (col + gap < term->chars_wide && gap <= TERMINAL_GAP_MAX &&
+                       back[col + gap].glyph == front[col + gap].glyph &&
+                       back[col + gap].color == front[col + gap].color) {
+                    ++gap;
+                }
+                if (gap > TERMINAL_GAP_MAX || col + gap == term->chars_wide) {
+                    break;
+                }
+                _Bool bridge = 1;
+                for (usize i = col; i < col + gap; ++i) {
+                    if (back[i].glyph != ' ' && back[i].color != term->color) {
+                        bridge = 0;
+                        break;
+                    }
+                }
+                if (!bridge) {
+                    break;
+                }
+                for (usize end = col + gap + 1; col < end; ++col) {
+                    // blanks look the same in any foreground colour
+                    if (back[col].glyph != ' ') {
+                        terminal_emit_color(term, back[col].color);
+                    }
+                    terminal_emit_glyph(term, back[col].glyph);
+                    front[col] = back[col];
+                }
+            }
+            // the cursor stays on the last column with a pending wrap, which
+            // terminals handle differently, so forget where it is
+            term->cursor_row = row;
+            term->cursor_col = col == term->chars_wide ? -1 : (i32)col;
+        }
+    }
+    terminal_out_flush();
     return RC_OK;
 }
 
 RC terminal_add_channel(TerminalDisplay *term, const char *name,
                         ChannelHandle *hdl) {
-    return add_channel(term->channels, &term->nchannels, name, hdl);
+    RC rc = add_channel(&term->channels, name, hdl);
+    if (rc == RC_OK) {
+        term->channels.scale[*hdl] = term->scale;
+    }
+    return rc;
 }
 
 RC terminal_remove_channel(TerminalDisplay *term, ChannelHandle hdl) {
-    return remove_channel(term->channels, &term->nchannels, hdl);
+    if (channel_valid(&term->channels, hdl)) {
+        terminal_erase_channel(term, hdl);
+    }
+    return remove_channel(&term->channels, hdl);
 }
 
 RC terminal_set_scale(TerminalDisplay *term, double scale) {
     term->scale = scale;
+    // the axis labels follow this scale, so every channel snaps back to it
+    for (usize i = 0; i < term->channels.count; ++i) {
+        term->channels.scale[i] = scale;
+    }
     // given a range of [-scale, scale] and one row reserved for the header,
     // determine how much of the signal each bin falls into
     term->binwidth = (2.0 * scale) / (term->chars_tall - term->reserved_rows);
     return RC_OK;
 }
 
+RC terminal_set_channel_scale(TerminalDisplay *term, ChannelHandle hdl,
+                              double scale) {
+    return channel_set_scale(&term->channels, hdl, scale);
+}
+
+RC terminal_set_channel_offset(TerminalDisplay *term, ChannelHandle hdl,
+                               double offset) {
+    return channel_set_offset(&term->channels, hdl, offset);
+}
+
+RC terminal_set_channel_visible(TerminalDisplay *term, ChannelHandle hdl,
+                                _Bool visible) {
+    RC rc = channel_set_visible(&term->channels, hdl, visible);
+    if (rc == RC_OK && !visible) {
+        terminal_erase_channel(term, hdl);
+    }
+    return rc;
+}
+
+RC terminal_set_channel_priority(TerminalDisplay *term, ChannelHandle hdl,
+                                 u8 priority) {
+    return channel_set_priority(&term->channels, hdl, priority);
+}
+
 RC terminal_set_y(TerminalDisplay *term, usize chars_tall) {
+    if (chars_tall > TERMINAL_ROWS_MAX) {
+        return RC_BUF_LENGTH;
+    }
     term->chars_tall = chars_tall;
     term->reserved_rows = term->chars_tall & 1 ? 2 : 1;
     return RC_OK;
 }
 
 RC terminal_set_x(TerminalDisplay *term, usize chars_wide) {
+    if (chars_wide > TERMINAL_COLS_MAX) {
+        return RC_BUF_LENGTH;
+    }
     term->chars_wide = chars_wide;
     return RC_OK;
 }
 
-RC terminal_writev(TerminalDisplay *term, ChannelHandle hdl, double *values,
-                   usize sz) {
-    return RC_OK;
-}
-
-RC terminal_position_cursor(TerminalDisplay *term, usize row, usize col) {
-    printf("\033[%u;%uH", row, col);
-    return RC_OK;
+RC terminal_set_style(TerminalDisplay *term, PlotStyle style) {
+    if (style != PLOT_CELLS && style != PLOT_BRAILLE) {
+        return RC_INVALID_OPT;
+    }
+    term->style = style;
+    // start a fresh sweep, positions differ between styles
+    terminal_restart(term);
+    return terminal_draw_axis(term);
 }
 
-usize terminal_xaxis(TerminalDisplay *term) {
-    // don't include header
-    return term->reserved_rows + (term->chars_tall - term->reserved_rows) / 2;
+RC terminal_set_sweep(TerminalDisplay *term, SweepMode sweep) {
+    if (sweep != SWEEP_WRAP && sweep != SWEEP_ROLL) {
+        return RC_INVALID_OPT;
+    }
+    term->sweep = sweep;
+    terminal_restart(term);
+    terminal_set_margins(term);
+    return terminal_draw_axis(term);
 }
 
-RC terminal_write(TerminalDisplay *term, ChannelHandle hdl, double value) {
-    if (term->col == term->chars_wide) {
-        term->col = START_COL;
-        terminal_redraw(term);
+void terminal_set_margins(TerminalDisplay *term) {
+    char buf[2 * FMT_INT_MAX + 4];
+    usize len;
+    if (term->sweep != SWEEP_ROLL) {
+        terminal_emit(term, RESET_TB_MARGINS DISABLE_LR_MARGINS,
+                      sizeof(RESET_TB_MARGINS DISABLE_LR_MARGINS) - 1);
     } else {
-        ++term->col;
+        // DECSTBM keeps the header out of the scroll region and DECSLRM
+        // keeps the y axis labels out of it, both one based and inclusive
+        terminal_emit(term, ENABLE_LR_MARGINS, sizeof(ENABLE_LR_MARGINS) - 1);
+        len = fmt_cursor(buf, sizeof(buf), term->reserved_rows + 1,
+                         term->chars_tall);
+        buf[len - 1] = 'r';
+        terminal_emit(term, buf, len);
+        len = fmt_cursor(buf, sizeof(buf), START_COL + 1, term->chars_wide);
+        buf[len - 1] = 's';
+        terminal_emit(term, buf, len);
     }
+    // setting margins homes the cursor
+    term->cursor_row = -1;
+    term->cursor_col = -1;
+}
 
-    double clamped = clamp(value, term->scale);
-    _Bool is_negative = clamped < 0;
-    if (is_negative) {
-        clamped *= -1;
+void terminal_roll(TerminalDisplay *term) {
+    // scroll both buffers one column so the diff stays relative to what the
+    // terminal shows once the pending SL reaches it
+    usize rows, cols;
+    terminal_plot_cells(term, &rows, &cols);
+    Cell blank = {.glyph = ' ', .color = COLOR_DEFAULT, .owner = 0};
+    for (usize row = term->reserved_rows; row < term->chars_tall; ++row) {
+        Cell *front = term->front[row] + START_COL;
+        Cell *back = term->back[row] + START_COL;
+        memmove(front, front + 1, (cols - 1) * sizeof(Cell));
+        memmove(back, back + 1, (cols - 1) * sizeof(Cell));
+        front[cols - 1] = blank;
+        back[cols - 1] = terminal_axis_cell(term, row, term->chars_wide - 1);
+    }
+    ++term->pending_roll;
+    // every trace moves left with the screen
+    usize step = term->style == PLOT_BRAILLE ? BRAILLE_DOTS_WIDE : 1;
+    Channels *ch = &term->channels;
+    for (usize i = 0; i < ch->count; ++i) {
+        if (ch->x[i] >= step) {
+            ch->x[i] -= step;
+        } else {
+            ch->x[i] = 0;
+            ch->last_y[i] = -1;
+        }
     }
-    // (0,0) is top left
-    usize row_offset = round(clamped / term->binwidth);
-    usize xaxis_row = terminal_xaxis(term);
-    usize row = xaxis_row + (is_negative ? row_offset : -row_offset);
-    terminal_position_cursor(term, row, term->col);
-    printf("%s*", COLORS[hdl]);
-    term->channels[hdl].last_value = value;
-    terminal_draw_header(term);
-
-    return RC_OK;
 }
 
-// lcd implementations
-RC lcd_open(LcdDisplay *lcd, DisplayFile **file) {
-    if (LCD.status == DISPLAY_OPEN) {
-        return RC_ALREADY_OPEN;
+void terminal_restart(TerminalDisplay *term) {
+    Channels *ch = &term->channels;
+    for (usize i = 0; i < ch->count; ++i) {
+        ch->x[i] = 0;
+        ch->last_y[i] = -1;
     }
-    LCD.status = DISPLAY_OPEN;
-    *file = &LCD;
-    return RC_OK;
 }
 
-RC lcd_close(LcdDisplay *lcd) { return RC_OK; }
-
-RC lcd_clear(LcdDisplay *lcd) { return RC_OK; }
+void terminal_erase_channel(TerminalDisplay *term, ChannelHandle hdl) {
+    // put the axis back wherever this channel's trace is showing, anything
+    // it had covered reappears on that channel's next sweep
+    u8 owner = hdl + 1;
+    for (usize row = term->reserved_rows; row < term->chars_tall; ++row) {
+        Cell *cells = term->back[row];
+        for (usize col = START_COL; col < term->chars_wide; ++col) {
+            if (cells[col].owner == owner) {
+                cells[col] = terminal_axis_cell(term, row, col);
+            }
+        }
+    }
+}
 
-RC lcd_redraw(LcdDisplay *lcd) { return RC_OK; }
+RC terminal_writev(TerminalDisplay *term, ChannelHandle hdl, double *values,
+                   usize sz) {
+    if (!channel_valid(&term->channels, hdl)) {
+        return RC_INVALID_OPT;
+    }
+    if (sz == 0) {
+        return RC_OK;
+    }
+    // plot the whole block into the back buffer, then send one diff
+    if (term->channels.visible[hdl]) {
+        for (usize i = 0; i < sz; ++i) {
+            terminal_plot(term, hdl, values[i]);
+        }
+    }
+    term->stats.samples += sz;
+    term->channels.last_value[hdl] = values[sz - 1];
+    terminal_draw_header(term);
+    return terminal_flush(term);
+}
+
+void terminal_plot(TerminalDisplay *term, ChannelHandle hdl, double value) {
+    Channels *ch = &term->channels;
+    usize rows, cols;
+    terminal_plot_size(term, &rows, &cols);
+    if (ch->x[hdl] == cols && term->sweep == SWEEP_ROLL) {
+        terminal_roll(term);
+    } else if (ch->x[hdl] == cols) {
+        ch->x[hdl] = 0;
+        ch->last_y[hdl] = -1;
+        terminal_erase_channel(term, hdl);
+    }
+    // map the channel's own range onto the axis
+    value = (value + ch->offset[hdl]) * term->scale / ch->scale[hdl];
+    usize x = ch->x[hdl];
+    if (term->style == PLOT_BRAILLE) {
+        // join consecutive samples so steep edges stay continuous
+        i32 y = terminal_value_dot(term, value);
+        if (ch->last_y[hdl] < 0) {
+            terminal_set_dot(term, x, y, hdl);
+        } else {
+            terminal_draw_line(term, x - 1, ch->last_y[hdl], x, y, hdl);
+        }
+        ch->last_y[hdl] = y;
+    } else {
+        usize row = terminal_value_row(term, value);
+        Cell *cell = &term->back[row][START_COL + x];
+        if (terminal_may_draw(term, cell, hdl)) {
+            cell->glyph = '*';
+            cell->color = ch->color[hdl];
+            cell->owner = hdl + 1;
+        }
+    }
+    ch->x[hdl] = x + 1;
+}
+
+usize terminal_xaxis(TerminalDisplay *term) {
+    // don't include header
+    return term->reserved_rows + (term->chars_tall - term->reserved_rows) / 2;
+}
+
+usize terminal_value_row(TerminalDisplay *term, double value) {
+    double clamped = clamp(value, term->scale);
+    _Bool is_negative = clamped < 0;
+    if (is_negative) {
+        clamped *= -1;
+    }
+    // (0,0) is top left
+    usize row_offset = round(clamped / term->binwidth);
+    usize xaxis_row = terminal_xaxis(term);
+    if (is_negative) {
+        usize last_row = term->chars_tall - 1;
+        return xaxis_row + row_offset > last_row ? last_row
+                                                 : xaxis_row + row_offset;
+    }
+    return xaxis_row < term->reserved_rows + row_offset
+               ? term->reserved_rows
+               : xaxis_row - row_offset;
+}
+
+i32 terminal_value_dot(TerminalDisplay *term, double value) {
+    // dot 0 is +scale, the last dot is -scale
+    usize rows, cols;
+    terminal_plot_size(term, &rows, &cols);
+    double clamped = clamp(value, term->scale);
+    return round((term->scale - clamped) / (2.0 * term->scale) * (rows - 1));
+}
+
+_Bool terminal_may_draw(TerminalDisplay *term, const Cell *cell,
+                        ChannelHandle hdl) {
+    if (cell->owner == 0 || cell->owner == hdl + 1) {
+        return 1;
+    }
+    const u8 *priority = term->channels.priority;
+    return priority[hdl] >= priority[cell->owner - 1];
+}
+
+void terminal_set_dot(TerminalDisplay *term, i32 x, i32 y, ChannelHandle hdl) {
+    // the back buffer glyphs double as the packed dot buffer, anything that
+    // isn't already this channel's pattern (axis, blanks, a trace it is
+    // allowed to cover) is replaced by an empty one
+    Cell *cell = &term->back[term->reserved_rows + y / BRAILLE_DOTS_TALL]
+                            [START_COL + x / BRAILLE_DOTS_WIDE];
+    if (!terminal_may_draw(term, cell, hdl)) {
+        return;
+    }
+    if (cell->glyph < BRAILLE_BASE || cell->owner != hdl + 1) {
+        cell->glyph = BRAILLE_BASE;
+    }
+    cell->glyph |= BRAILLE_BITS[y % BRAILLE_DOTS_TALL][x % BRAILLE_DOTS_WIDE];
+    cell->color = term->channels.color[hdl];
+    cell->owner = hdl + 1;
+}
+
+void terminal_draw_line(TerminalDisplay *term, i32 x0, i32 y0, i32 x1, i32 y1,
+                        ChannelHandle hdl) {
+    // integer Bresenham over all octants
+    i32 dx = x1 > x0 ? x1 - x0 : x0 - x1;
+    i32 dy = y1 > y0 ? y0 - y1 : y1 - y0;
+    i32 sx = x0 < x1 ? 1 : -1;
+    i32 sy = y0 < y1 ? 1 : -1;
+    i32 err = dx + dy;
+    while (1) {
+        terminal_set_dot(term, x0, y0, hdl);
+        if (x0 == x1 && y0 == y1) {
+            break;
+        }
+        i32 e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+Cell terminal_axis_cell(TerminalDisplay *term, usize row, usize col) {
+    Cell cell = {.glyph = ' ', .color = COLOR_DEFAULT, .owner = 0};
+    if (row == terminal_xaxis(term) ? col >= START_COL - 1
+                                    : col == START_COL - 2) {
+        cell.glyph = '*';
+    }
+    return cell;
+}
+
+void terminal_put_text(TerminalDisplay *term, usize row, usize col,
+                       const char *text, u8 color) {
+    // text runs to the end of the string, blanks fill the rest of a header
+    _Bool fill = *text == '\0';
+    for (; col < term->chars_wide; ++col) {
+        if (*text == '\0') {
+            if (!fill) {
+                break;
+            }
+            term->back[row][col].glyph = ' ';
+        } else {
+            term->back[row][col].glyph = (u8)*text++;
+        }
+        term->back[row][col].color = color;
+    }
+}
+
+RC terminal_write(TerminalDisplay *term, ChannelHandle hdl, double value) {
+    return terminal_writev(term, hdl, &value, 1);
+}
+
+RC terminal_plot_size(TerminalDisplay *term, usize *rows, usize *cols) {
+    terminal_plot_cells(term, rows, cols);
+    if (term->style == PLOT_BRAILLE) {
+        *rows *= BRAILLE_DOTS_TALL;
+        *cols *= BRAILLE_DOTS_WIDE;
+    }
+    return RC_OK;
+}
+
+void terminal_plot_cells(TerminalDisplay *term, usize *rows, usize *cols) {
+    *rows = term->chars_tall - term->reserved_rows;
+    // samples are plotted from the column after the y axis bar up to the edge
+    *cols = term->chars_wide - START_COL;
+}
+
+RC terminal_draw_persistence(TerminalDisplay *term,
+                             const Persistence *persist) {
+    usize rows, cols;
+    terminal_plot_cells(term, &rows, &cols);
+    rows = persist->rows < rows ? persist->rows : rows;
+    cols = persist->cols < cols ? persist->cols : cols;
+    for (usize row = 0; row < rows; ++row) {
+        usize trow = term->reserved_rows + row;
+        for (usize col = 0; col < cols; ++col) {
+            u8 hits = persist_hits(persist, row, col);
+            Cell *cell = &term->back[trow][START_COL + col];
+            if (hits == 0) {
+                *cell = terminal_axis_cell(term, trow, START_COL + col);
+                continue;
+            }
+            cell->glyph = '*';
+            cell->owner = 0;
+            cell->color = PERSIST_RAMP[hits * PERSIST_RAMP_LEN /
+                                       (PERSIST_HITS_MAX + 1)];
+        }
+    }
+    return terminal_flush(term);
+}
+
+RC terminal_set_zoom(TerminalDisplay *term, usize samples_per_point) {
+    if (samples_per_point == 0) {
+        return RC_INVALID_OPT;
+    }
+    term->zoom = samples_per_point;
+    return RC_OK;
+}
+
+RC terminal_set_pan(TerminalDisplay *term, usize samples) {
+    term->pan = samples;
+    return RC_OK;
+}
+
+RC terminal_draw_history(TerminalDisplay *term, ChannelHandle hdl,
+                         const Pyramid *pyr, double volts_per_count) {
+    static u16 lo[TERMINAL_COLS_MAX * BRAILLE_DOTS_WIDE];
+    static u16 hi[TERMINAL_COLS_MAX * BRAILLE_DOTS_WIDE];
+    Channels *ch = &term->channels;
+    if (!channel_valid(ch, hdl)) {
+        return RC_INVALID_OPT;
+    }
+    usize rows, cols;
+    terminal_plot_size(term, &rows, &cols);
+
+    // right edge `pan` samples behind the newest, and as much history to
+    // the left of it as the zoom asks for or the pyramid still holds
+    u64 first, end;
+    pyramid_bounds(pyr, &first, &end);
+    u64 right = end - first > term->pan ? end - term->pan : first;
+    u64 span = (u64)term->zoom * cols;
+    u64 start = right - first > span ? right - span : first;
+    usize points = (right - start) / term->zoom;
+    terminal_erase_channel(term, hdl);
+    if (points > 0) {
+        RC rc = pyramid_read(pyr, right - (u64)points * term->zoom,
+                             (u64)points * term->zoom, lo, hi, points);
+        if (rc != RC_OK) {
+            return rc;
+        }
+    }
+
+    // the envelope fills each point from its min to its max, stretched to
+    // meet the previous point so slow edges stay joined
+    double gain = volts_per_count * term->scale / ch->scale[hdl];
+    double offset = ch->offset[hdl] * term->scale / ch->scale[hdl];
+    i32 prev_top = -1, prev_bottom = -1;
+    for (usize x = 0; x < points; ++x) {
+        double top = hi[x] * gain + offset;
+        double bottom = lo[x] * gain + offset;
+        if (term->style == PLOT_BRAILLE) {
+            i32 y0 = terminal_value_dot(term, top);
+            i32 y1 = terminal_value_dot(term, bottom);
+            if (prev_top >= 0) {
+                y0 = y0 > prev_bottom ? prev_bottom : y0;
+                y1 = y1 < prev_top ? prev_top : y1;
+            }
+            terminal_draw_line(term, x, y0, x, y1, hdl);
+            prev_top = terminal_value_dot(term, top);
+            prev_bottom = terminal_value_dot(term, bottom);
+        } else {
+            usize r0 = terminal_value_row(term, top);
+            usize r1 = terminal_value_row(term, bottom);
+            for (usize row = r0; row <= r1; ++row) {
+                Cell *cell = &term->back[row][START_COL + x];
+                if (terminal_may_draw(term, cell, hdl)) {
+                    cell->glyph = '*';
+                    cell->color = ch->color[hdl];
+                    cell->owner = hdl + 1;
+                }
+            }
+        }
+    }
+    // the live sweep starts over once it takes the channel back
+    ch->x[hdl] = 0;
+    ch->last_y[hdl] = -1;
+    terminal_draw_header(term);
+    return terminal_flush(term);
+}
+
+void terminal_emit(TerminalDisplay *term, const char *bytes, usize sz) {
+    term->stats.bytes += sz;
+    if (term->headless) {
+        return;
+    }
+    for (usize i = 0; i < sz; ++i) {
+        if (OUT.len == TERMINAL_OUT_SZ) {
+            terminal_out_flush();
+        }
+        OUT.buf[OUT.len++] = bytes[i];
+    }
+}
+
+void terminal_emit_glyph(TerminalDisplay *term, u16 glyph) {
+    ++term->stats.glyphs;
+    if (glyph < 0x80) {
+        char c = glyph;
+        terminal_emit(term, &c, 1);
+        return;
+    }
+    // every glyph outside ASCII is in the Basic Multilingual Plane, and the
+    // ones used here are all above U+0800, so three UTF-8 bytes
+    char utf8[3] = {
+        0xE0 | (glyph >> 12),
+        0x80 | ((glyph >> 6) & 0x3F),
+        0x80 | (glyph & 0x3F),
+    };
+    terminal_emit(term, utf8, sizeof(utf8));
+}
+
+void terminal_emit_escape(TerminalDisplay *term, usize n, char final) {
+    char buf[FMT_INT_MAX + 3];
+    terminal_emit(term, buf, fmt_csi(buf, sizeof(buf), n, final));
+}
+
+void terminal_emit_color(TerminalDisplay *term, u8 color) {
+    if (term->color == color) {
+        return;
+    }
+    term->color = color;
+    ++term->stats.color_changes;
+    char buf[16];
+    terminal_emit(term, buf, fmt_color(buf, sizeof(buf), color));
+}
+
+static usize digits(usize n) {
+    usize count = 1;
+    while (n >= 10) {
+        n /= 10;
+        ++count;
+    }
+    return count;
+}
+
+static usize escape_cost(usize n) { return n == 1 ? 3 : 3 + digits(n); }
+
+void terminal_move_cursor(TerminalDisplay *term, usize row, usize col) {
+    // absolute position: CSI row ; col H, one based
+    usize absolute = 4 + digits(row + 1) + digits(col + 1);
+    ++term->stats.cursor_moves;
+    // CR and relative moves stop at or jump to the margins in roll mode, so
+    // only absolute positioning is safe there
+    if (term->cursor_row < 0 || term->cursor_col < 0 ||
+        term->sweep == SWEEP_ROLL) {
+        char buf[2 * FMT_INT_MAX + 4];
+        usize len = fmt_cursor(buf, sizeof(buf), row + 1, col + 1);
+        terminal_emit(term, buf, len);
+        term->cursor_row = row;
+        term->cursor_col = col;
+        return;
+    }
+
+    // relative position: up/down, then either back/forward or a carriage
+    // return followed by forward
+    usize cur_row = term->cursor_row;
+    usize cur_col = term->cursor_col;
+    usize vertical = row == cur_row ? 0
+                     : row > cur_row ? escape_cost(row - cur_row)
+                                     : escape_cost(cur_row - row);
+    usize horizontal = col == cur_col ? 0
+                       : col > cur_col ? escape_cost(col - cur_col)
+                                       : escape_cost(cur_col - col);
+    usize carriage = 1 + (col ? escape_cost(col) : 0);
+    _Bool use_carriage = col < cur_col && carriage < horizontal;
+    if (use_carriage) {
+        horizontal = carriage;
+    }
+
+    if (absolute < vertical + horizontal) {
+        char buf[2 * FMT_INT_MAX + 4];
+        usize len = fmt_cursor(buf, sizeof(buf), row + 1, col + 1);
+        terminal_emit(term, buf, len);
+    } else {
+        if (row > cur_row) {
+            terminal_emit_escape(term, row - cur_row, 'B');
+        } else if (row < cur_row) {
+            terminal_emit_escape(term, cur_row - row, 'A');
+        }
+        if (use_carriage) {
+            terminal_emit(term, "\r", 1);
+            if (col) {
+                terminal_emit_escape(term, col, 'C');
+            }
+        } else if (col > cur_col) {
+            terminal_emit_escape(term, col - cur_col, 'C');
+        } else if (col < cur_col) {
+            terminal_emit_escape(term, cur_col - col, 'D');
+        }
+    }
+    term->cursor_row = row;
+    term->cursor_col = col;
+}
+
+void terminal_out_flush(void) {
+    if (OUT.len) {
+        fwrite(OUT.buf, 1, OUT.len, stdout);
+        OUT.len = 0;
+    }
+}
+
+RC terminal_snapshot(TerminalDisplay *term, char *buf, usize sz) {
+    // `front` is what the terminal shows once the last flush has landed
+    usize len = 0;
+    for (usize row = 0; row < term->chars_tall; ++row) {
+        for (usize col = 0; col < term->chars_wide; ++col) {
+            u16 glyph = term->front[row][col].glyph;
+            usize width = glyph < 0x80 ? 1 : 3;
+            if (len + width + 2 > sz) {
+                return RC_BUF_LENGTH;
+            }
+            if (width == 1) {
+                buf[len++] = glyph;
+            } else {
+                buf[len++] = 0xE0 | (glyph >> 12);
+                buf[len++] = 0x80 | ((glyph >> 6) & 0x3F);
+                buf[len++] = 0x80 | (glyph & 0x3F);
+            }
+        }
+        if (len + 2 > sz) {
+            return RC_BUF_LENGTH;
+        }
+        buf[len++] = '\n';
+    }
+    if (sz == 0) {
+        return RC_BUF_LENGTH;
+    }
+    buf[len] = '\0';
+    return RC_OK;
+}
+
+// memory implementations
+RC memory_open(TerminalDisplay *term, DisplayFile **file) {
+    if (term == NULL) {
+        return RC_INVALID_OPT;
+    }
+    if (MEMORY.status == DISPLAY_OPEN) {
+        return RC_ALREADY_OPEN;
+    }
+    MEMORY.status = DISPLAY_OPEN;
+    terminal_init(term, 1);
+    *file = &MEMORY;
+    return RC_OK;
+}
+
+// lcd implementations
+RC lcd_open(LcdDisplay *lcd, DisplayFile **file) {
+    if (LCD.status == DISPLAY_OPEN) {
+        return RC_ALREADY_OPEN;
+    }
+    LCD.status = DISPLAY_OPEN;
+    lcd->transport = (LcdTransport){0};
+    lcd->pixels_wide = LCD_WIDTH;
+    lcd->pixels_tall = LCD_HEIGHT;
+    lcd->sweep = SWEEP_WRAP;
+    lcd->scale = 1.0;
+    lcd->zoom = 1;
+    lcd->pan = 0;
+    lcd->persist = NULL;
+    lcd->next_column = 0;
+    glyph_cache_init(&lcd->glyphs);
+    lcd_build_grid(lcd);
+    lcd_reset_spans(lcd);
+    memset(&lcd->stats, 0, sizeof(DisplayStats));
+    *file = &LCD;
+    return RC_OK;
+}
+
+RC lcd_close(LcdDisplay *lcd) { return RC_OK; }
+
+RC lcd_clear(LcdDisplay *lcd) {
+    lcd_reset_spans(lcd);
+    return lcd_flush(lcd);
+}
+
+RC lcd_redraw(LcdDisplay *lcd) {
+    lcd_mark_all(lcd);
+    return lcd_flush(lcd);
+}
+
+RC lcd_set_transport(LcdDisplay *lcd, const LcdTransport *transport) {
+    if (transport == NULL || transport->window == NULL ||
+        transport->pixels == NULL) {
+        return RC_INVALID_OPT;
+    }
+    lcd->transport = *transport;
+    // nothing is known about what the new panel shows
+    lcd_mark_all(lcd);
+    return RC_OK;
+}
 
 RC lcd_add_channel(LcdDisplay *lcd, const char *name, ChannelHandle *hdl) {
+    RC rc = add_channel(&lcd->channels, name, hdl);
+    if (rc == RC_OK) {
+        lcd->channels.scale[*hdl] = lcd->scale;
+    }
+    return rc;
+}
+
+RC lcd_remove_channel(LcdDisplay *lcd, ChannelHandle hdl) {
+    if (channel_valid(&lcd->channels, hdl)) {
+        lcd_erase_channel(lcd, hdl);
+    }
+    return remove_channel(&lcd->channels, hdl);
+}
+
+RC lcd_set_scale(LcdDisplay *lcd, double scale) {
+    if (scale <= 0) {
+        return RC_INVALID_OPT;
+    }
+    lcd->scale = scale;
+    for (usize i = 0; i < lcd->channels.count; ++i) {
+        lcd->channels.scale[i] = scale;
+    }
     return RC_OK;
 }
 
-RC lcd_remove_channel(LcdDisplay *lcd, ChannelHandle hdl) { return RC_OK; }
+RC lcd_set_channel_scale(LcdDisplay *lcd, ChannelHandle hdl, double scale) {
+    return channel_set_scale(&lcd->channels, hdl, scale);
+}
+
+RC lcd_set_channel_offset(LcdDisplay *lcd, ChannelHandle hdl, double offset) {
+    return channel_set_offset(&lcd->channels, hdl, offset);
+}
+
+RC lcd_set_channel_visible(LcdDisplay *lcd, ChannelHandle hdl, _Bool visible) {
+    RC rc = channel_set_visible(&lcd->channels, hdl, visible);
+    if (rc == RC_OK && !visible) {
+        lcd_erase_channel(lcd, hdl);
+    }
+    return rc;
+}
+
+RC lcd_set_channel_priority(LcdDisplay *lcd, ChannelHandle hdl, u8 priority) {
+    RC rc = channel_set_priority(&lcd->channels, hdl, priority);
+    if (rc == RC_OK) {
+        // overlaps are settled when columns are composed, so repaint them
+        lcd_mark_all(lcd);
+    }
+    return rc;
+}
+
+RC lcd_set_y(LcdDisplay *lcd, usize pixels_tall) {
+    // the header always fits, with at least a row of plot below it
+    if (pixels_tall <= LCD_HEADER_ROWS || pixels_tall > LCD_HEIGHT) {
+        return RC_BUF_LENGTH;
+    }
+    lcd->pixels_tall = pixels_tall;
+    lcd_build_grid(lcd);
+    lcd_reset_spans(lcd);
+    return RC_OK;
+}
 
-RC lcd_set_scale(LcdDisplay *lcd, double scale) { return RC_OK; }
+RC lcd_set_x(LcdDisplay *lcd, usize pixels_wide) {
+    if (pixels_wide > LCD_WIDTH) {
+        return RC_BUF_LENGTH;
+    }
+    lcd->pixels_wide = pixels_wide;
+    lcd_build_grid(lcd);
+    lcd_reset_spans(lcd);
+    return RC_OK;
+}
 
-RC lcd_set_y(LcdDisplay *lcd, usize pixels_tall) { return RC_OK; }
+// traces are always drawn as joined pixel columns
+RC lcd_set_style(LcdDisplay *lcd, PlotStyle style) { return RC_OK; }
 
-RC lcd_set_x(LcdDisplay *lcd, usize pixels_wide) { return RC_OK; }
+RC lcd_set_sweep(LcdDisplay *lcd, SweepMode sweep) {
+    if (sweep != SWEEP_WRAP && sweep != SWEEP_ROLL) {
+        return RC_INVALID_OPT;
+    }
+    lcd->sweep = sweep;
+    lcd_reset_spans(lcd);
+    return RC_OK;
+}
 
 RC lcd_writev(LcdDisplay *lcd, ChannelHandle hdl, double *values, usize sz) {
+    if (!channel_valid(&lcd->channels, hdl)) {
+        return RC_INVALID_OPT;
+    }
+    if (sz == 0 || lcd->pixels_wide == 0 || lcd->pixels_tall == 0) {
+        return RC_OK;
+    }
+    // update the spans for the whole block, then send the changed columns
+    if (lcd->channels.visible[hdl]) {
+        for (usize i = 0; i < sz; ++i) {
+            lcd_plot(lcd, hdl, values[i]);
+        }
+    }
+    lcd->stats.samples += sz;
+    lcd->channels.last_value[hdl] = values[sz - 1];
+    return lcd_flush(lcd);
+}
+
+RC lcd_write(LcdDisplay *lcd, ChannelHandle hdl, double value) {
+    return lcd_writev(lcd, hdl, &value, 1);
+}
+
+RC lcd_plot_size(LcdDisplay *lcd, usize *rows, usize *cols) {
+    *rows = lcd->pixels_tall - LCD_HEADER_ROWS;
+    *cols = lcd->pixels_wide;
+    return RC_OK;
+}
+
+RC lcd_draw_persistence(LcdDisplay *lcd, const Persistence *persist) {
+    if (persist->rows == 0 || persist->cols == 0) {
+        return RC_INVALID_OPT;
+    }
+    // the counts are painted as each column is composed, so every plot row
+    // is repainted while they're set. The caller keeps the counts, so
+    // they're only looked at during this flush
+    for (usize col = 0; col < lcd->pixels_wide; ++col) {
+        lcd_mark_dirty(lcd, col, LCD_HEADER_ROWS, lcd->pixels_tall - 1);
+    }
+    lcd->persist = persist;
+    RC rc = lcd_flush(lcd);
+    lcd->persist = NULL;
+    return rc;
+}
+
+RC lcd_set_zoom(LcdDisplay *lcd, usize samples_per_point) {
+    if (samples_per_point == 0) {
+        return RC_INVALID_OPT;
+    }
+    lcd->zoom = samples_per_point;
     return RC_OK;
 }
 
-RC lcd_write(LcdDisplay *lcd, ChannelHandle hdl, double value) { return RC_OK; }
+RC lcd_set_pan(LcdDisplay *lcd, usize samples) {
+    lcd->pan = samples;
+    return RC_OK;
+}
+
+RC lcd_draw_history(LcdDisplay *lcd, ChannelHandle hdl, const Pyramid *pyr,
+                    double volts_per_count) {
+    static u16 lo[LCD_WIDTH];
+    static u16 hi[LCD_WIDTH];
+    Channels *ch = &lcd->channels;
+    if (!channel_valid(ch, hdl)) {
+        return RC_INVALID_OPT;
+    }
+
+    // the same window as the terminal's, a column per point
+    u64 first, end;
+    pyramid_bounds(pyr, &first, &end);
+    u64 right = end - first > lcd->pan ? end - lcd->pan : first;
+    u64 span = (u64)lcd->zoom * lcd->pixels_wide;
+    u64 start = right - first > span ? right - span : first;
+    usize points = (right - start) / lcd->zoom;
+    if (!ch->visible[hdl]) {
+        points = 0;
+    }
+    if (points > 0) {
+        RC rc = pyramid_read(pyr, right - (u64)points * lcd->zoom,
+                             (u64)points * lcd->zoom, lo, hi, points);
+        if (rc != RC_OK) {
+            return rc;
+        }
+    }
+
+    // each column spans its min to its max, stretched to meet the previous
+    // column so slow edges stay joined. Columns past the last point are
+    // emptied
+    double gain = volts_per_count * lcd->scale / ch->scale[hdl];
+    double offset = ch->offset[hdl] * lcd->scale / ch->scale[hdl];
+    i32 prev_top = -1, prev_bottom = -1;
+    for (usize col = 0; col < lcd->pixels_wide; ++col) {
+        if (col >= points) {
+            lcd_set_span(lcd, hdl, col, LCD_SPAN_NONE, 0);
+            continue;
+        }
+        i32 top = lcd_value_row(lcd, hi[col] * gain + offset);
+        i32 bottom = lcd_value_row(lcd, lo[col] * gain + offset);
+        i32 y0 = top, y1 = bottom;
+        if (prev_top >= 0) {
+            y0 = y0 > prev_bottom ? prev_bottom : y0;
+            y1 = y1 < prev_top ? prev_top : y1;
+        }
+        lcd_set_span(lcd, hdl, col, y0, y1);
+        prev_top = top;
+        prev_bottom = bottom;
+    }
+    return lcd_flush(lcd);
+}
+
+void lcd_plot(LcdDisplay *lcd, ChannelHandle hdl, double value) {
+    Channels *ch = &lcd->channels;
+    if (ch->x[hdl] == lcd->pixels_wide && lcd->sweep == SWEEP_ROLL) {
+        lcd_roll(lcd);
+    } else if (ch->x[hdl] == lcd->pixels_wide) {
+        // the old trace is replaced column by column as the new sweep
+        // passes over it, so unlike the terminal nothing is erased here
+        ch->x[hdl] = 0;
+        ch->last_y[hdl] = -1;
+    }
+    value = (value + ch->offset[hdl]) * lcd->scale / ch->scale[hdl];
+    i32 y = lcd_value_row(lcd, value);
+    // cover the rows back to the previous sample so steep edges stay joined
+    i32 prev = ch->last_y[hdl] < 0 ? y : ch->last_y[hdl];
+    lcd_set_span(lcd, hdl, ch->x[hdl], prev < y ? prev : y,
+                 prev < y ? y : prev);
+    ch->last_y[hdl] = y;
+    ++ch->x[hdl];
+}
+
+void lcd_set_span(LcdDisplay *lcd, ChannelHandle hdl, usize col, u8 lo,
+                  u8 hi) {
+    usize idx = lcd_span_index(lcd, col);
+    if (lcd->span_lo[hdl][idx] != lo || lcd->span_hi[hdl][idx] != hi) {
+        // erase the old span and draw the new one, nothing else in the
+        // column changes
+        lcd_mark_dirty(lcd, col, lcd->span_lo[hdl][idx],
+                       lcd->span_hi[hdl][idx]);
+        lcd_mark_dirty(lcd, col, lo, hi);
+        lcd->span_lo[hdl][idx] = lo;
+        lcd->span_hi[hdl][idx] = hi;
+    }
+}
+
+i32 lcd_value_row(LcdDisplay *lcd, double value) {
+    // the row under the header is +scale, the last row is -scale
+    double clamped = clamp(value, lcd->scale);
+    return LCD_HEADER_ROWS +
+           round((lcd->scale - clamped) / (2.0 * lcd->scale) *
+                 (lcd->pixels_tall - LCD_HEADER_ROWS - 1));
+}
+
+usize lcd_span_index(const LcdDisplay *lcd, usize col) {
+    usize idx = lcd->origin + col;
+    return idx < lcd->pixels_wide ? idx : idx - lcd->pixels_wide;
+}
+
+void lcd_roll(LcdDisplay *lcd) {
+    // the oldest column comes round as the newest, empty for every channel,
+    // and every column moves so the whole plot is repainted
+    lcd->origin = lcd_span_index(lcd, 1);
+    usize idx = lcd_span_index(lcd, lcd->pixels_wide - 1);
+    Channels *ch = &lcd->channels;
+    for (usize i = 0; i < ch->count; ++i) {
+        lcd->span_lo[i][idx] = LCD_SPAN_NONE;
+        lcd->span_hi[i][idx] = 0;
+        if (ch->x[i] > 0) {
+            --ch->x[i];
+        } else {
+            ch->last_y[i] = -1;
+        }
+    }
+    lcd_mark_all(lcd);
+}
+
+void lcd_erase_channel(LcdDisplay *lcd, ChannelHandle hdl) {
+    for (usize col = 0; col < lcd->pixels_wide; ++col) {
+        usize idx = lcd_span_index(lcd, col);
+        lcd_mark_dirty(lcd, col, lcd->span_lo[hdl][idx],
+                       lcd->span_hi[hdl][idx]);
+        lcd->span_lo[hdl][idx] = LCD_SPAN_NONE;
+        lcd->span_hi[hdl][idx] = 0;
+    }
+}
+
+void lcd_reset_spans(LcdDisplay *lcd) {
+    memset(lcd->span_lo, LCD_SPAN_NONE, sizeof(lcd->span_lo));
+    memset(lcd->span_hi, 0, sizeof(lcd->span_hi));
+    lcd->origin = 0;
+    Channels *ch = &lcd->channels;
+    for (usize i = 0; i < ch->count; ++i) {
+        ch->x[i] = 0;
+        ch->last_y[i] = -1;
+    }
+    lcd_mark_all(lcd);
+}
+
+void lcd_mark_dirty(LcdDisplay *lcd, usize col, u8 lo, u8 hi) {
+    // an empty span has lo > hi and leaves the column as it was
+    if (lo > hi) {
+        return;
+    }
+    lcd->dirty_lo[col] = lo < lcd->dirty_lo[col] ? lo : lcd->dirty_lo[col];
+    lcd->dirty_hi[col] = hi > lcd->dirty_hi[col] ? hi : lcd->dirty_hi[col];
+}
+
+void lcd_mark_all(LcdDisplay *lcd) {
+    // nothing on the panel can be trusted, so every column is drawn from top
+    // to bottom and every header cell is redrawn
+    memset(lcd->dirty_lo, LCD_HEADER_ROWS, sizeof(lcd->dirty_lo));
+    memset(lcd->dirty_hi, lcd->pixels_tall - 1, sizeof(lcd->dirty_hi));
+    memset(lcd->shown, 0, sizeof(lcd->shown));
+}
+
+usize lcd_draw_order(const LcdDisplay *lcd, ChannelHandle *order) {
+    // lowest priority first so the highest is painted last, on top. Ties go
+    // to the higher handle
+    const Channels *ch = &lcd->channels;
+    usize n = 0;
+    for (usize hdl = 0; hdl < ch->count; ++hdl) {
+        if (!ch->active[hdl] || !ch->visible[hdl]) {
+            continue;
+        }
+        usize i = n++;
+        while (i > 0 && ch->priority[order[i - 1]] > ch->priority[hdl]) {
+            order[i] = order[i - 1];
+            --i;
+        }
+        order[i] = hdl;
+    }
+    return n;
+}
+
+void lcd_build_grid(LcdDisplay *lcd) {
+    // dotted lines on the division boundaries, including the plot edges
+    memset(lcd->grid, 0, sizeof(lcd->grid));
+    memset(lcd->grid_kind, LCD_GRID_NONE, sizeof(lcd->grid_kind));
+    if (lcd->pixels_wide == 0 || lcd->pixels_tall == 0) {
+        return;
+    }
+    usize plot_rows = lcd->pixels_tall - LCD_HEADER_ROWS;
+    for (usize i = 0; i <= LCD_GRID_DIVS_Y; ++i) {
+        usize row = LCD_HEADER_ROWS + i * (plot_rows - 1) / LCD_GRID_DIVS_Y;
+        lcd->grid[LCD_GRID_DOTS][row / 32] |= 1u << (row % 32);
+        lcd->grid[LCD_GRID_LINE][row / 32] |= 1u << (row % 32);
+    }
+    for (usize row = LCD_HEADER_ROWS; row < lcd->pixels_tall;
+         row += LCD_GRID_DOT) {
+        lcd->grid[LCD_GRID_LINE][row / 32] |= 1u << (row % 32);
+    }
+    for (usize col = 0; col < lcd->pixels_wide; col += LCD_GRID_DOT) {
+        lcd->grid_kind[col] = LCD_GRID_DOTS;
+    }
+    for (usize i = 0; i <= LCD_GRID_DIVS_X; ++i) {
+        lcd->grid_kind[i * (lcd->pixels_wide - 1) / LCD_GRID_DIVS_X] =
+            LCD_GRID_LINE;
+    }
+}
+
+void lcd_draw_header(LcdDisplay *lcd) {
+    // the value and name of each visible channel in its trace colour, as in
+    // the terminal header, cut off at the edge of the panel
+    char text[LCD_HEADER_VALUE_WIDTH + CHANNEL_NAME_MAX + 1];
+    usize cols = lcd->pixels_wide / FONT_CELL_WIDTH;
+    usize col = 0;
+    const Channels *ch = &lcd->channels;
+    for (usize i = 0; i < ch->count && col < cols; ++i) {
+        if (!ch->active[i] || !ch->visible[i]) {
+            continue;
+        }
+        // the widest value and a full name overrun the value's column, so
+        // every append is bounded by the buffer rather than assumed to fit
+        usize len = 0;
+        text[len++] = '(';
+        // a NaN would reach fmt_volts' conversion to an integer
+        if (isfinite(ch->last_value[i])) {
+            len += fmt_volts(text + len, sizeof(text) - len - 1,
+                             ch->last_value[i], HEADER_DIGITS);
+        } else {
+            text[len++] = '?';
+        }
+        text[len++] = ')';
+        if (len < LCD_HEADER_VALUE_WIDTH) {
+            len = fmt_pad(text, sizeof(text), len, LCD_HEADER_VALUE_WIDTH);
+        }
+        for (const char *c = ch->name[i]; *c && len < sizeof(text); ++c) {
+            text[len++] = *c;
+        }
+        if (len < sizeof(text)) {
+            text[len++] = ' ';
+        }
+        for (usize j = 0; j < len && col < cols; ++j, ++col) {
+            lcd->text[col] = text[j];
+            lcd->text_color[col] = LCD_COLORS[i];
+        }
+    }
+    for (; col < cols; ++col) {
+        lcd->text[col] = ' ';
+    }
+    // blanks look the same in any colour, so a channel's colour changing
+    // hands doesn't redraw them
+    for (col = 0; col < cols; ++col) {
+        if (lcd->text[col] == ' ') {
+            lcd->text_color[col] = LCD_BACKGROUND;
+        }
+    }
+}
+
+RC lcd_flush_header(LcdDisplay *lcd) {
+    // a run of changed cells shares one window, the glyphs following each
+    // other column by column just as the window is filled
+    const LcdTransport *tr = &lcd->transport;
+    usize cols = lcd->pixels_wide / FONT_CELL_WIDTH;
+    usize col = 0;
+    while (col < cols) {
+        if (!lcd_header_changed(lcd, col)) {
+            ++col;
+            continue;
+        }
+        usize end = col + 1;
+        while (end < cols && lcd_header_changed(lcd, end)) {
+            ++end;
+        }
+        RC rc = tr->window(tr->ctx, col * FONT_CELL_WIDTH, 0,
+                           end * FONT_CELL_WIDTH - 1, LCD_HEADER_ROWS - 1);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        ++lcd->stats.cursor_moves;
+        lcd->stats.bytes += LCD_WINDOW_BYTES;
+        for (; col < end; ++col) {
+            Glyph *glyph;
+            if (!glyph_lookup(&lcd->glyphs, lcd->text[col],
+                              lcd->text_color[col], LCD_BACKGROUND, &glyph)) {
+                // the entry taken over is never the one just sent, which
+                // the transport may still be reading
+                glyph_render(glyph);
+            }
+            rc = tr->pixels(tr->ctx, glyph->px,
+                            FONT_CELL_WIDTH * FONT_CELL_HEIGHT);
+            if (rc != RC_OK) {
+                return rc;
+            }
+            lcd->shown[col] = lcd->text[col];
+            lcd->shown_color[col] = lcd->text_color[col];
+            ++lcd->stats.glyphs;
+            lcd->stats.bytes += sizeof(glyph->px);
+        }
+    }
+    return RC_OK;
+}
+
+_Bool lcd_header_changed(const LcdDisplay *lcd, usize col) {
+    return lcd->text[col] != lcd->shown[col] ||
+           lcd->text_color[col] != lcd->shown_color[col];
+}
+
+void lcd_compose(const LcdDisplay *lcd, usize col, usize y0, usize y1,
+                 const ChannelHandle *order, usize norder, u16 *px) {
+    // restore the grid over rows [y0, y1], then paint the traces over it
+    const u32 *grid = lcd->grid[lcd->grid_kind[col]];
+    for (usize row = y0; row <= y1; ++row) {
+        px[row - y0] = grid[row / 32] & (1u << (row % 32)) ? LCD_GRID
+                                                           : LCD_BACKGROUND;
+    }
+    const Persistence *persist = lcd->persist;
+    if (persist != NULL) {
+        // each pixel takes the count of the cell it falls in, however
+        // coarse the counts are
+        usize plot_rows = lcd->pixels_tall - LCD_HEADER_ROWS;
+        usize pcol = col * persist->cols / lcd->pixels_wide;
+        for (usize row = y0 > LCD_HEADER_ROWS ? y0 : LCD_HEADER_ROWS;
+             row <= y1; ++row) {
+            usize prow = (row - LCD_HEADER_ROWS) * persist->rows / plot_rows;
+            u8 hits = persist_hits(persist, prow, pcol);
+            if (hits > 0) {
+                px[row - y0] = LCD_PERSIST_RAMP[hits * LCD_PERSIST_RAMP_LEN /
+                                                (PERSIST_HITS_MAX + 1)];
+            }
+        }
+    }
+    usize idx = lcd_span_index(lcd, col);
+    for (usize i = 0; i < norder; ++i) {
+        ChannelHandle hdl = order[i];
+        u16 color = LCD_COLORS[hdl];
+        usize lo = lcd->span_lo[hdl][idx] > y0 ? lcd->span_lo[hdl][idx] : y0;
+        usize hi = lcd->span_hi[hdl][idx] < y1 ? lcd->span_hi[hdl][idx] : y1;
+        for (usize row = lo; row <= hi; ++row) {
+            px[row - y0] = color;
+        }
+    }
+}
+
+RC lcd_flush(LcdDisplay *lcd) {
+    const LcdTransport *tr = &lcd->transport;
+    if (tr->window == NULL) {
+        return RC_NOT_OPEN;
+    }
+    ++lcd->stats.flushes;
+    lcd_draw_header(lcd);
+    RC rc = lcd_flush_header(lcd);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    ChannelHandle order[CHANNEL_COUNT_MAX];
+    usize norder = lcd_draw_order(lcd, order);
+    u8 *dirty_lo = lcd->dirty_lo;
+    u8 *dirty_hi = lcd->dirty_hi;
+    usize col = 0;
+    while (col < lcd->pixels_wide) {
+        if (dirty_lo[col] > dirty_hi[col]) {
+            ++col;
+            continue;
+        }
+        // take following columns into the same window while padding them
+        // to its rows costs less than a window of their own
+        u8 lo = dirty_lo[col];
+        u8 hi = dirty_hi[col];
+        usize end = col + 1;
+        while (end < lcd->pixels_wide && dirty_lo[end] <= dirty_hi[end]) {
+            u8 merged_lo = dirty_lo[end] < lo ? dirty_lo[end] : lo;
+            u8 merged_hi = dirty_hi[end] > hi ? dirty_hi[end] : hi;
+            usize merged = (end - col + 1) * (merged_hi - merged_lo + 1);
+            usize apart = (end - col) * (hi - lo + 1) +
+                          (dirty_hi[end] - dirty_lo[end] + 1) +
+                          LCD_WINDOW_BYTES / sizeof(u16);
+            if (merged > apart) {
+                break;
+            }
+            lo = merged_lo;
+            hi = merged_hi;
+            ++end;
+        }
+        rc = tr->window(tr->ctx, col, lo, end - 1, hi);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        ++lcd->stats.cursor_moves;
+        lcd->stats.bytes += LCD_WINDOW_BYTES;
+        usize rows = hi - lo + 1;
+        for (; col < end; ++col) {
+            // compose into the buffer the transport finished with when the
+            // previous column was handed over
+            u16 *px = lcd->column[lcd->next_column];
+            lcd->next_column ^= 1;
+            lcd_compose(lcd, col, lo, hi, order, norder, px);
+            rc = tr->pixels(tr->ctx, px, rows);
+            if (rc != RC_OK) {
+                return rc;
+            }
+            dirty_lo[col] = LCD_SPAN_NONE;
+            dirty_hi[col] = 0;
+            lcd->stats.bytes += rows * sizeof(u16);
+        }
+    }
+    return RC_OK;
+}
@@ -0,0 +1,86 @@
+#include "fanout.h"
+
+RC fanout_init(Fanout *fan, RenderScheduler *source) {
+    if (source == NULL) {
+        return RC_INVALID_OPT;
+    }
+    fan->source = source;
+    fan->frame = NULL;
+    fan->seq = 0;
+    fan->nsinks = 0;
+    return RC_OK;
+}
+
+RC fanout_add(Fanout *fan, FanoutDraw draw, void *ctx, u32 fps, usize *idx) {
+    if (draw == NULL) {
+        return RC_INVALID_OPT;
+    }
+    if (fan->nsinks == FANOUT_SINKS_MAX) {
+        return RC_CHANNEL_COUNT;
+    }
+    FanoutSink *sink = &fan->sinks[fan->nsinks];
+    RC rc = render_pacer_init(&sink->pacer, fps);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    sink->draw = draw;
+    sink->ctx = ctx;
+    // frames already shared before the sink joined don't count as skipped
+    sink->seq = fan->seq;
+    sink->drawn = 0;
+    sink->skipped = 0;
+    *idx = fan->nsinks++;
+    return RC_OK;
+}
+
+RC fanout_set_fps(Fanout *fan, usize idx, u32 fps) {
+    if (idx >= fan->nsinks) {
+        return RC_INVALID_OPT;
+    }
+    return render_pacer_init(&fan->sinks[idx].pacer, fps);
+}
+
+RC fanout_poll(Fanout *fan, u32 now_ms) {
+    void *frame;
+    if (render_take(fan->source, now_ms, &frame) == RC_OK) {
+        fan->frame = frame;
+        ++fan->seq;
+    }
+    if (fan->frame == NULL) {
+        return RC_NOT_READY;
+    }
+
+    FanoutSink *next = NULL;
+    for (usize i = 0; i < fan->nsinks; ++i) {
+        FanoutSink *sink = &fan->sinks[i];
+        render_pacer_update(&sink->pacer, now_ms);
+        if (sink->seq == fan->seq || !render_pacer_due(&sink->pacer, now_ms)) {
+            continue;
+        }
+        // most overdue first, wrap safe
+        if (next == NULL ||
+            (i32)(sink->pacer.next_ms - next->pacer.next_ms) < 0) {
+            next = sink;
+        }
+    }
+    if (next == NULL) {
+        return RC_NOT_READY;
+    }
+    next->skipped += fan->seq - next->seq - 1;
+    next->seq = fan->seq;
+    ++next->drawn;
+    render_pacer_tick(&next->pacer, now_ms);
+    return next->draw(next->ctx, fan->frame);
+}
+
+RC fanout_stats(const Fanout *fan, usize idx, RenderStats *stats) {
+    if (idx >= fan->nsinks) {
+        return RC_INVALID_OPT;
+    }
+    const FanoutSink *sink = &fan->sinks[idx];
+    stats->published = fan->seq;
+    stats->rendered = sink->drawn;
+    stats->dropped = sink->skipped;
+    stats->fps = sink->pacer.effective_fps;
+    return RC_OK;
+}
@@ -0,0 +1,200 @@
+#include "fmt.h"
+
+#define DECIMALS_MAX 9
+
+static const u32 POW10[DECIMALS_MAX + 1] = {
+    1,         10,         100,         1000,         10000,
+    100000,    1000000,    10000000,    100000000,    1000000000,
+};
+
+static usize digits_u32(u32 value);
+static usize put_u32(char *out, u32 value, usize width);
+static usize finish(char *buf, usize sz, const char *tmp, usize len);
+
+usize fmt_u32(char *buf, usize sz, u32 value) {
+    char tmp[FMT_INT_MAX];
+    usize len = put_u32(tmp, value, 0);
+    return finish(buf, sz, tmp, len);
+}
+
+usize fmt_i32(char *buf, usize sz, i32 value) {
+    char tmp[FMT_INT_MAX];
+    usize len = 0;
+    // negate as unsigned so INT32_MIN doesn't overflow
+    u32 magnitude = value < 0 ? -(u32)value : (u32)value;
+    if (value < 0) {
+        tmp[len++] = '-';
+    }
+    len += put_u32(tmp + len, magnitude, 0);
+    return finish(buf, sz, tmp, len);
+}
+
+usize fmt_fixed(char *buf, usize sz, i32 value, u8 decimals) {
+    if (decimals > DECIMALS_MAX) {
+        return 0;
+    }
+    char tmp[2 * FMT_INT_MAX];
+    usize len = 0;
+    u32 magnitude = value < 0 ? -(u32)value : (u32)value;
+    if (value < 0) {
+        tmp[len++] = '-';
+    }
+    len += put_u32(tmp + len, magnitude / POW10[decimals], 0);
+    if (decimals) {
+        tmp[len++] = '.';
+        len += put_u32(tmp + len, magnitude % POW10[decimals], decimals);
+    }
+    return finish(buf, sz, tmp, len);
+}
+
+usize fmt_double(char *buf, usize sz, double value, u8 decimals) {
+    if (decimals > DECIMALS_MAX) {
+        return 0;
+    }
+    double scaled = value * POW10[decimals];
+    scaled += scaled < 0 ? -0.5 : 0.5;
+    if (scaled >= 2147483647.0 || scaled <= -2147483647.0) {
+        return 0;
+    }
+    return fmt_fixed(buf, sz, (i32)scaled, decimals);
+}
+
+usize fmt_volts(char *buf, usize sz, double volts, u8 digits) {
+    static const char *UNITS[] = {"V", "mV", "uV"};
+    if (digits == 0 || digits > DECIMALS_MAX) {
+        return 0;
+    }
+    _Bool negative = volts < 0;
+    double mantissa = negative ? -volts : volts;
+    usize unit = 0;
+    while (mantissa != 0 && mantissa < 1 && unit < 2) {
+        mantissa *= 1000;
+        ++unit;
+    }
+
+    // round to the requested significant digits, then check the rounding
+    // didn't carry into another integer digit (999.96mV -> 1.000V)
+    u32 scaled;
+    usize decimals;
+    while (1) {
+        if (mantissa >= POW10[DECIMALS_MAX]) {
+            return 0;
+        }
+        usize whole = digits_u32(mantissa);
+        decimals = digits > whole ? digits - whole : 0;
+        scaled = mantissa * POW10[decimals] + 0.5;
+        if (scaled < POW10[whole + decimals]) {
+            break;
+        }
+        if (unit > 0 && whole == 3) {
+            mantissa /= 1000;
+            --unit;
+        } else {
+            mantissa = (double)scaled / POW10[decimals];
+        }
+    }
+
+    char tmp[2 * FMT_INT_MAX + 4];
+    usize len = 0;
+    if (negative && scaled) {
+        tmp[len++] = '-';
+    }
+    len += fmt_fixed(tmp + len, sizeof(tmp) - len, scaled, decimals);
+    for (const char *u = UNITS[unit]; *u; ++u) {
+        tmp[len++] = *u;
+    }
+    return finish(buf, sz, tmp, len);
+}
+
+usize fmt_csi(char *buf, usize sz, u32 n, char final) {
+    char tmp[FMT_INT_MAX + 3];
+    usize len = 0;
+    tmp[len++] = '\033';
+    tmp[len++] = '[';
+    if (n != 1) {
+        len += put_u32(tmp + len, n, 0);
+    }
+    tmp[len++] = final;
+    return finish(buf, sz, tmp, len);
+}
+
+usize fmt_cursor(char *buf, usize sz, u32 row, u32 col) {
+    char tmp[2 * FMT_INT_MAX + 4];
+    usize len = 0;
+    tmp[len++] = '\033';
+    tmp[len++] = '[';
+    len += put_u32(tmp + len, row, 0);
+    tmp[len++] = ';';
+    len += put_u32(tmp + len, col, 0);
+    tmp[len++] = 'H';
+    return finish(buf, sz, tmp, len);
+}
+
+usize fmt_color(char *buf, usize sz, u8 color) {
+    char tmp[16];
+    usize len = 0;
+    tmp[len++] = '\033';
+    tmp[len++] = '[';
+    if (color == 0) {
+        tmp[len++] = '0';
+    } else if (color < 8) {
+        tmp[len++] = '3';
+        tmp[len++] = '0' + color;
+    } else if (color < 16) {
+        // bright variants have their own short form
+        tmp[len++] = '9';
+        tmp[len++] = '0' + color - 8;
+    } else {
+        const char *prefix = "38;5;";
+        while (*prefix) {
+            tmp[len++] = *prefix++;
+        }
+        len += put_u32(tmp + len, color, 0);
+    }
+    tmp[len++] = 'm';
+    return finish(buf, sz, tmp, len);
+}
+
+usize fmt_pad(char *buf, usize sz, usize len, usize width) {
+    if (width + 1 > sz) {
+        return 0;
+    }
+    while (len < width) {
+        buf[len++] = ' ';
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+static usize digits_u32(u32 value) {
+    usize count = 1;
+    while (count <= DECIMALS_MAX && value >= POW10[count]) {
+        ++count;
+    }
+    return count;
+}
+
+static usize put_u32(char *out, u32 value, usize width) {
+    // digits come out least significant first, so fill from the end
+    usize len = digits_u32(value);
+    len = len < width ? width : len;
+    for (usize i = len; i > 0; --i) {
+        out[i - 1] = '0' + value % 10;
+        value /= 10;
+    }
+    return len;
+}
+
+static usize finish(char *buf, usize sz, const char *tmp, usize len) {
+    if (len + 1 > sz) {
+        if (sz) {
+            buf[0] = '\0';
+        }
+        return 0;
+    }
+    for (usize i = 0; i < len; ++i) {
+        buf[i] = tmp[i];
+    }
+    buf[len] = '\0';
+    return len;
+}
@@ -0,0 +1,57 @@
+#include "framebuffer.h"
+
+static RC framebuffer_window(void *ctx, u16 x0, u16 y0, u16 x1, u16 y1);
+static RC framebuffer_pixels(void *ctx, const u16 *px, usize n);
+
+RC framebuffer_init(Framebuffer *fb, u16 *px, usize width, usize height) {
+    if (px == NULL || width == 0 || height == 0) {
+        return RC_BUF_LENGTH;
+    }
+    fb->px = px;
+    fb->width = width;
+    fb->height = height;
+    fb->x0 = fb->x = 0;
+    fb->y0 = fb->y = 0;
+    fb->x1 = width - 1;
+    fb->y1 = height - 1;
+    fb->windows = 0;
+    fb->pixels = 0;
+    fb->bytes = 0;
+    return RC_OK;
+}
+
+void framebuffer_transport(Framebuffer *fb, LcdTransport *transport) {
+    transport->window = framebuffer_window;
+    transport->pixels = framebuffer_pixels;
+    transport->ctx = fb;
+}
+
+static RC framebuffer_window(void *ctx, u16 x0, u16 y0, u16 x1, u16 y1) {
+    Framebuffer *fb = ctx;
+    if (x0 > x1 || y0 > y1 || x1 >= fb->width || y1 >= fb->height) {
+        return RC_INVALID_OPT;
+    }
+    fb->x0 = fb->x = x0;
+    fb->y0 = fb->y = y0;
+    fb->x1 = x1;
+    fb->y1 = y1;
+    ++fb->windows;
+    fb->bytes += LCD_WINDOW_BYTES;
+    return RC_OK;
+}
+
+static RC framebuffer_pixels(void *ctx, const u16 *px, usize n) {
+    Framebuffer *fb = ctx;
+    for (usize i = 0; i < n; ++i) {
+        fb->px[fb->y * fb->width + fb->x] = px[i];
+        if (fb->y < fb->y1) {
+            ++fb->y;
+            continue;
+        }
+        fb->y = fb->y0;
+        fb->x = fb->x < fb->x1 ? fb->x + 1 : fb->x0;
+    }
+    fb->pixels += n;
+    fb->bytes += n * sizeof(u16);
+    return RC_OK;
+}
@@ -0,0 +1,227 @@
+#include "ili9341.h"
+#include "stm32f4xx_hal.h"
+
+SPI_HandleTypeDef hspi2;
+DMA_HandleTypeDef hdma_spi2_tx;
+
+#define CS_PORT GPIOB
+#define CS_PIN GPIO_PIN_12
+#define DC_PORT GPIOA
+#define DC_PIN GPIO_PIN_8
+#define RST_PORT GPIOA
+#define RST_PIN GPIO_PIN_9
+
+#define CMD_SWRESET 0x01
+#define CMD_SLPOUT 0x11
+#define CMD_DISPON 0x29
+#define CMD_CASET 0x2A
+#define CMD_PASET 0x2B
+#define CMD_RAMWR 0x2C
+#define CMD_MADCTL 0x36
+#define CMD_PIXFMT 0x3A
+
+// BGR panel, no row/column exchange. Set MX or MY as well if the panel is
+// mounted the other way round
+#define MADCTL_BGR 0x08
+// 16 bits per pixel over the serial interface
+#define PIXFMT_RGB565 0x55
+
+// a whole column at 21MHz takes well under a millisecond
+#define ILI9341_TIMEOUT_MS 100
+
+static volatile struct {
+    // a pixel DMA transfer is in flight
+    _Bool busy : 1;
+} STATE;
+
+static RC spi_init(void);
+static RC dma_init(void);
+static RC wait_idle(void);
+static void set_datasize(u32 datasize);
+static RC command(u8 cmd, const u8 *params, usize sz);
+static RC ili9341_window(void *ctx, u16 x0, u16 y0, u16 x1, u16 y1);
+static RC ili9341_pixels(void *ctx, const u16 *px, usize n);
+
+RC ili9341_init(void) {
+    if (dma_init() != RC_OK || spi_init() != RC_OK) {
+        return RC_OPEN_FAILED;
+    }
+    // the panel stays selected, it is the only device on the bus
+    HAL_GPIO_WritePin(CS_PORT, CS_PIN, GPIO_PIN_RESET);
+    HAL_GPIO_WritePin(RST_PORT, RST_PIN, GPIO_PIN_RESET);
+    HAL_Delay(10);
+    HAL_GPIO_WritePin(RST_PORT, RST_PIN, GPIO_PIN_SET);
+    HAL_Delay(120);
+
+    RC rc = command(CMD_SWRESET, NULL, 0);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    HAL_Delay(5);
+    if ((rc = command(CMD_SLPOUT, NULL, 0)) != RC_OK) {
+        return rc;
+    }
+    // sleep out needs 120ms before the next command
+    HAL_Delay(120);
+    u8 madctl = MADCTL_BGR;
+    u8 pixfmt = PIXFMT_RGB565;
+    if ((rc = command(CMD_MADCTL, &madctl, 1)) != RC_OK ||
+        (rc = command(CMD_PIXFMT, &pixfmt, 1)) != RC_OK) {
+        return rc;
+    }
+    return command(CMD_DISPON, NULL, 0);
+}
+
+void ili9341_transport(LcdTransport *transport) {
+    transport->window = ili9341_window;
+    transport->pixels = ili9341_pixels;
+    transport->ctx = NULL;
+}
+
+static RC ili9341_window(void *ctx, u16 x0, u16 y0, u16 x1, u16 y1) {
+    RC rc = wait_idle();
+    if (rc != RC_OK) {
+        return rc;
+    }
+    // screen rows are the panel's columns and screen columns its pages
+    u8 rows[] = {y0 >> 8, y0 & 0xFF, y1 >> 8, y1 & 0xFF};
+    u8 cols[] = {x0 >> 8, x0 & 0xFF, x1 >> 8, x1 & 0xFF};
+    if ((rc = command(CMD_CASET, rows, sizeof(rows))) != RC_OK ||
+        (rc = command(CMD_PASET, cols, sizeof(cols))) != RC_OK ||
+        (rc = command(CMD_RAMWR, NULL, 0)) != RC_OK) {
+        return rc;
+    }
+    // pixels go out as whole 16 bit frames, high byte first as the panel
+    // expects, so they're sent straight from the caller's buffer
+    set_datasize(SPI_DATASIZE_16BIT);
+    return RC_OK;
+}
+
+static RC ili9341_pixels(void *ctx, const u16 *px, usize n) {
+    // the previous buffer is free once its transfer is done, which is what
+    // lets the caller alternate between two
+    RC rc = wait_idle();
+    if (rc != RC_OK) {
+        return rc;
+    }
+    STATE.busy = 1;
+    if (HAL_SPI_Transmit_DMA(&hspi2, (u8 *)px, n) != HAL_OK) {
+        STATE.busy = 0;
+        return RC_START_FAILED;
+    }
+    return RC_OK;
+}
+
+static RC wait_idle(void) {
+    u32 start = HAL_GetTick();
+    while (STATE.busy) {
+        if (HAL_GetTick() - start > ILI9341_TIMEOUT_MS) {
+            return RC_TIMEOUT;
+        }
+    }
+    return RC_OK;
+}
+
+static void set_datasize(u32 datasize) {
+    if (hspi2.Init.DataSize == datasize) {
+        return;
+    }
+    // the frame format can only change with the peripheral disabled, the
+    // next transfer enables it again
+    __HAL_SPI_DISABLE(&hspi2);
+    hspi2.Init.DataSize = datasize;
+    MODIFY_REG(hspi2.Instance->CR1, SPI_CR1_DFF, datasize);
+}
+
+static RC command(u8 cmd, const u8 *params, usize sz) {
+    // commands and their parameters are a handful of bytes, not worth a DMA
+    // transfer
+    set_datasize(SPI_DATASIZE_8BIT);
+    HAL_GPIO_WritePin(DC_PORT, DC_PIN, GPIO_PIN_RESET);
+    if (HAL_SPI_Transmit(&hspi2, &cmd, 1, ILI9341_TIMEOUT_MS) != HAL_OK) {
+        return RC_TIMEOUT;
+    }
+    HAL_GPIO_WritePin(DC_PORT, DC_PIN, GPIO_PIN_SET);
+    if (sz > 0 && HAL_SPI_Transmit(&hspi2, (u8 *)params, sz,
+                                   ILI9341_TIMEOUT_MS) != HAL_OK) {
+        return RC_TIMEOUT;
+    }
+    return RC_OK;
+}
+
+static RC spi_init(void) {
+    hspi2.Instance = SPI2;
+    hspi2.Init.Mode = SPI_MODE_MASTER;
+    hspi2.Init.Direction = SPI_DIRECTION_2LINES;
+    hspi2.Init.DataSize = SPI_DATASIZE_8BIT;
+    hspi2.Init.CLKPolarity = SPI_POLARITY_LOW;
+    hspi2.Init.CLKPhase = SPI_PHASE_1EDGE;
+    hspi2.Init.NSS = SPI_NSS_SOFT;
+    // 42MHz APB1 / 2, past the datasheet's write cycle but fine in practice
+    hspi2.Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_2;
+    hspi2.Init.FirstBit = SPI_FIRSTBIT_MSB;
+    hspi2.Init.TIMode = SPI_TIMODE_DISABLE;
+    hspi2.Init.CRCCalculation = SPI_CRCCALCULATION_DISABLE;
+    hspi2.Init.CRCPolynomial = 10;
+    if (HAL_SPI_Init(&hspi2) != HAL_OK) {
+        return RC_OPEN_FAILED;
+    }
+    return RC_OK;
+}
+
+static RC dma_init(void) {
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    hdma_spi2_tx.Instance = DMA1_Stream4;
+    hdma_spi2_tx.Init.Channel = DMA_CHANNEL_0;
+    hdma_spi2_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    hdma_spi2_tx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_spi2_tx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_spi2_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+    hdma_spi2_tx.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+    hdma_spi2_tx.Init.Mode = DMA_NORMAL;
+    hdma_spi2_tx.Init.Priority = DMA_PRIORITY_LOW;
+    hdma_spi2_tx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    if (HAL_DMA_Init(&hdma_spi2_tx) != HAL_OK) {
+        return RC_OPEN_FAILED;
+    }
+    __HAL_LINKDMA(&hspi2, hdmatx, hdma_spi2_tx);
+
+    // below the ADC, whose buffers must never be late
+    HAL_NVIC_SetPriority(DMA1_Stream4_IRQn, 2, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Stream4_IRQn);
+    HAL_NVIC_SetPriority(SPI2_IRQn, 2, 0);
+    HAL_NVIC_EnableIRQ(SPI2_IRQn);
+    return RC_OK;
+}
+
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi) {
+    if (hspi->Instance == SPI2) {
+        STATE.busy = 0;
+    }
+}
+
+void HAL_SPI_MspInit(SPI_HandleTypeDef *hspi) {
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+    if (hspi->Instance == SPI2) {
+        __HAL_RCC_SPI2_CLK_ENABLE();
+        __HAL_RCC_GPIOA_CLK_ENABLE();
+        __HAL_RCC_GPIOB_CLK_ENABLE();
+        GPIO_InitStruct.Pin = GPIO_PIN_13 | GPIO_PIN_15;
+        GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+        GPIO_InitStruct.Pull = GPIO_NOPULL;
+        GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+        GPIO_InitStruct.Alternate = GPIO_AF5_SPI2;
+        HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
+
+        GPIO_InitStruct.Pin = CS_PIN;
+        GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+        GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+        GPIO_InitStruct.Alternate = 0;
+        HAL_GPIO_Init(CS_PORT, &GPIO_InitStruct);
+        GPIO_InitStruct.Pin = DC_PIN;
+        HAL_GPIO_Init(DC_PORT, &GPIO_InitStruct);
+        GPIO_InitStruct.Pin = RST_PIN;
+        HAL_GPIO_Init(RST_PORT, &GPIO_InitStruct);
+    }
+}
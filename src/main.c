@@ -4,30 +4,151 @@
 #include "defs.h"
 #include "main.h"
 
+#include "autoset.h"
+#include "average.h"
+#include "command.h"
 #include "display.h"
+#include "fanout.h"
+#include "fmt.h"
+#include "ili9341.h"
+#include "mask.h"
 #include "probe.h"
+#include "render.h"
 #include "serial.h"
+#include "stream.h"
 #include "stm32f4xx_hal.h"
 
-#define SZ 16
+#define SZ 1024
+#define RECORD_SZ (SZ / 4)
 #define VOLTAGE_MAX 3.3
 #define ADC_MAX 4095.0
 #define WINDOW_SZ 16
+#define AVERAGE_COUNT 16
+#define AUTOSET_TIMEOUT_MS 100
+#define DISPLAY_COLS 80
+#define DISPLAY_ROWS 25
+// plot hit counts across acquisitions instead of a single trace
+#define DISPLAY_PERSISTENCE 0
+// persistence is graded per character cell, traces use Braille sub-cells
+#define DISPLAY_STYLE (DISPLAY_PERSISTENCE ? PLOT_CELLS : PLOT_BRAILLE)
+#define PERSIST_DECAY_SHIFT 3
+// samples of capture history kept for zooming out, 6 bytes each
+#define HISTORY_SZ 4096
+// draw the history envelope at this many samples per point instead of the
+// live trace, 0 for the live trace
+#define HISTORY_ZOOM 0
+// test each record against a mask captured by pressing B1
+#define MASK_TEST 0
+#define MASK_TOLERANCE_Y 64
+#define MASK_TOLERANCE_X 2
+#define MASK_REPORT_INTERVAL 64
+// refresh rate of each display, acquisitions in between are processed but
+// not drawn
+#define TERMINAL_FPS 20
+// mirror the trace onto the LCD as well as the terminal
+#define DISPLAY_LCD 0
+#define LCD_FPS 30
+// print effective frame rate, dropped frames and the serial output totals
+// every interval
+#define RENDER_REPORT 0
+#define RENDER_REPORT_INTERVAL_MS 5000
+// send raw samples as binary frames in place of the terminal plot. Other
+// text output still goes out between frames and is skipped by the decoder
+#define STREAM_BINARY 0
+#define STREAM_BAUD 2000000
+#define STREAM_FRAME_SAMPLES 256
+// Rice code frames that compress, packing the rest
+#define STREAM_COMPRESS 1
+// take SCPI style commands over the serial port, see command.h
+#define SERIAL_COMMANDS 1
+// bytes taken from the serial port per pass of the main loop
+#define COMMAND_READ_SZ 32
 
 #define LED_PIN GPIO_PIN_5
 
-static struct {
+static volatile struct {
     _Bool dma_complete : 1;
+    _Bool capture_reference : 1;
     u16 *buf;
     usize sz;
 } STATE;
 
 volatile u16 ADC_SAMPLES[SZ];
 volatile double CONVERTED[SZ];
+static u32 AVERAGE_ACC[RECORD_SZ];
+static u16 AVERAGED[RECORD_SZ];
+static u16 AUTOSET_BUF[SZ / 2];
+// copy of the newest acquisition for :MEAS?, which the DMA can't overwrite
+static u16 MEASURED[SZ / 2];
+static u8 PERSIST_HITS[DISPLAY_ROWS * DISPLAY_COLS];
+static u16 MASK_LO[RECORD_SZ];
+static u16 MASK_HI[RECORD_SZ];
+static u16 HISTORY_SAMPLES[HISTORY_SZ];
+static u32 HISTORY_LEVELS[HISTORY_SZ];
+static u8 STREAM_FRAME[STREAM_FRAME_SZ(STREAM_FRAME_SAMPLES)];
+// core clock cycles spent encoding frames since the last report
+static u64 STREAM_CYCLES;
+
+// what the renderer needs from one processed acquisition
+typedef struct {
+#if DISPLAY_PERSISTENCE
+    u8 hits[DISPLAY_ROWS * DISPLAY_COLS];
+#else
+    double trace[RECORD_SZ];
+#endif
+} Frame;
+static Frame FRAMES[RENDER_SLOTS];
+
+// a display fed by the fan-out, with the plot size that display was given
+typedef struct {
+    DisplayFile *file;
+    ChannelHandle hdl;
+#if DISPLAY_PERSISTENCE
+    const Persistence *persist;
+#endif
+#if HISTORY_ZOOM
+    const Pyramid *history;
+#endif
+    usize cols;
+} DisplaySink;
+
+// what serial commands can change, and the newest acquisition to measure
+typedef struct {
+    u32 rate;
+    Trigger *trigger;
+    double scale;
+    DisplayFile *displays[2];
+    usize ndisplays;
+    Persistence *persist;
+    StreamEncoder *stream;
+    const u16 *last;
+    usize last_sz;
+} Controls;
 
 static void sysclock_init(void);
 static void gpio_init(void);
 static void handle_error(void);
+static RC autoset_capture(void *ctx, u32 rate, u16 *buf, usize sz,
+                          u32 *actual_rate);
+static RC draw_display(void *ctx, const void *frame);
+static void stream_send(StreamEncoder *enc, const u16 *buf, usize sz);
+static RC set_rate(void *ctx, double rate);
+static RC get_rate(void *ctx, char *reply, usize sz);
+static RC set_level(void *ctx, double volts);
+static RC get_level(void *ctx, char *reply, usize sz);
+static RC set_scale(void *ctx, double volts);
+static RC get_scale(void *ctx, char *reply, usize sz);
+static RC get_measurements(void *ctx, char *reply, usize sz);
+static RC get_identity(void *ctx, char *reply, usize sz);
+static void command_reply(void *ctx, const char *reply);
+
+static const Command COMMANDS[] = {
+    {"*IDN", NULL, get_identity},
+    {":ACQuire:RATE", set_rate, get_rate},
+    {":TRIGger:LEVel", set_level, get_level},
+    {":DISPlay:SCALe", set_scale, get_scale},
+    {":MEASure", NULL, get_measurements},
+};
 
 double adc_to_voltage(u16 val) { return VOLTAGE_MAX * val / ADC_MAX; }
 
@@ -70,17 +191,54 @@ int main(void) {
         printf("error adding channel 1\n");
         handle_error();
     }
-    rc = display_set_x(display, 80);
+    rc = display_set_x(display, DISPLAY_COLS);
     if (rc != RC_OK) {
         printf("error setting x dimension on display\n");
         handle_error();
     }
-    rc = display_set_y(display, 25);
+    rc = display_set_y(display, DISPLAY_ROWS);
     if (rc != RC_OK) {
         printf("error setting y dimension on display\n");
         handle_error();
     }
-    rc = display_set_scale(display, VOLTAGE_MAX);
+    rc = display_set_style(display, DISPLAY_STYLE);
+    if (rc != RC_OK) {
+        printf("error setting display style\n");
+        handle_error();
+    }
+
+    usize plot_rows, plot_cols;
+    rc = display_plot_size(display, &plot_rows, &plot_cols);
+    if (rc != RC_OK || plot_cols > RECORD_SZ) {
+        printf("error sizing display plot\n");
+        handle_error();
+    }
+
+    const u32 *rates;
+    usize nrates;
+    probe_rates(&rates, &nrates);
+    AutosetConfig autoset_cfg = {
+        .rates = rates,
+        .nrates = nrates,
+        .screen_samples = plot_cols,
+        .full_scale = VOLTAGE_MAX,
+        .adc_max = ADC_MAX,
+        .buf = AUTOSET_BUF,
+        .sz = SZ / 2,
+    };
+    AutosetResult autoset;
+    rc = autoset_run(&autoset_cfg, autoset_capture, NULL, &autoset);
+    if (rc != RC_OK) {
+        printf("error running autoset: %s\n", rcstr(rc));
+        handle_error();
+    }
+    u32 rate;
+    rc = probe_set_rate(autoset.rate, &rate);
+    if (rc != RC_OK) {
+        printf("error setting sample rate\n");
+        handle_error();
+    }
+    rc = display_set_scale(display, autoset.scale);
     if (rc != RC_OK) {
         printf("error setting display scale\n");
         handle_error();
@@ -91,21 +249,286 @@ int main(void) {
         handle_error();
     }
 
+    Averager averager;
+    rc = average_init(&averager, AVERAGE_EXPONENTIAL, AVERAGE_ACC, RECORD_SZ);
+    if (rc == RC_OK) {
+        rc = average_set_count(&averager, AVERAGE_COUNT);
+    }
+    if (rc != RC_OK) {
+        printf("error initializing averaging\n");
+        handle_error();
+    }
+
+    Persistence persist;
+    rc = persist_init(&persist, PERSIST_HITS, plot_rows, plot_cols);
+    if (rc == RC_OK) {
+        // match the [-scale, scale] range the trace is plotted over
+        i32 range = autoset.scale * ADC_MAX / VOLTAGE_MAX;
+        rc = persist_set_range(&persist, -range, range);
+    }
+    if (rc == RC_OK) {
+        rc = persist_set_decay(&persist, PERSIST_DECAY_SHIFT);
+    }
+    if (rc != RC_OK) {
+        printf("error initializing persistence\n");
+        handle_error();
+    }
+
+    Pyramid history;
+    rc = pyramid_init(&history, HISTORY_SAMPLES, HISTORY_LEVELS, HISTORY_SZ);
+#if HISTORY_ZOOM
+    if (rc == RC_OK) {
+        rc = display_set_zoom(display, HISTORY_ZOOM);
+    }
+#endif
+    if (rc != RC_OK) {
+        printf("error initializing capture history\n");
+        handle_error();
+    }
+
+    Mask mask;
+    MaskStats mask_stats;
+    mask_stats_reset(&mask_stats);
+    rc = mask_init(&mask, MASK_LO, MASK_HI, RECORD_SZ);
+    if (rc != RC_OK) {
+        printf("error initializing mask\n");
+        handle_error();
+    }
+
+    // frames are handed over unthrottled, each sink limits its own rate
+    RenderScheduler render;
+    Fanout fanout;
+    rc = render_init(&render, FRAMES, sizeof(Frame), 0);
+    if (rc == RC_OK) {
+        rc = fanout_init(&fanout, &render);
+    }
+    if (rc != RC_OK) {
+        printf("error initializing render scheduler\n");
+        handle_error();
+    }
+#if !STREAM_BINARY
+    usize terminal_sink;
+    DisplaySink terminal = {
+        .file = display,
+        .hdl = ch1_hdl,
+#if DISPLAY_PERSISTENCE
+        .persist = &persist,
+#endif
+#if HISTORY_ZOOM
+        .history = &history,
+#endif
+        .cols = plot_cols,
+    };
+    rc = fanout_add(&fanout, draw_display, &terminal, TERMINAL_FPS,
+                    &terminal_sink);
+    if (rc != RC_OK) {
+        printf("error adding terminal sink\n");
+        handle_error();
+    }
+#endif
+#if DISPLAY_LCD
+    DisplaySink lcd = {
+#if DISPLAY_PERSISTENCE
+        .persist = &persist,
+#endif
+#if HISTORY_ZOOM
+        .history = &history,
+#endif
+    };
+    usize lcd_sink, lcd_rows;
+    LcdTransport lcd_transport;
+    ili9341_transport(&lcd_transport);
+    rc = ili9341_init();
+    if (rc == RC_OK) {
+        rc = display_open(LCD_DISPLAY, &lcd.file);
+    }
+    if (rc == RC_OK) {
+        rc = display_set_transport(lcd.file, &lcd_transport);
+    }
+    if (rc == RC_OK) {
+        rc = display_add_channel(lcd.file, "Channel 1", &lcd.hdl);
+    }
+    if (rc == RC_OK) {
+        rc = display_set_scale(lcd.file, autoset.scale);
+    }
+    if (rc == RC_OK) {
+        rc = display_plot_size(lcd.file, &lcd_rows, &lcd.cols);
+    }
+    if (rc == RC_OK) {
+        // the LCD shows as much of the record as fits across it
+        lcd.cols = lcd.cols < plot_cols ? lcd.cols : plot_cols;
+        rc = fanout_add(&fanout, draw_display, &lcd, LCD_FPS, &lcd_sink);
+    }
+    if (rc != RC_OK) {
+        printf("error adding lcd sink\n");
+        handle_error();
+    }
+#endif
+#if STREAM_BINARY
+    StreamEncoder stream;
+    rc = stream_init(&stream, 1, rate);
+#if STREAM_COMPRESS
+    if (rc == RC_OK) {
+        rc = stream_set_coding(&stream, STREAM_CODING_RICE);
+    }
+#endif
+    if (rc == RC_OK) {
+        printf("streaming at %lu baud\n", (unsigned long)STREAM_BAUD);
+        rc = serial_set_baud(STREAM_BAUD);
+    }
+    if (rc != RC_OK) {
+        printf("error starting binary stream\n");
+        handle_error();
+    }
+#endif
+#if SERIAL_COMMANDS
+    Controls controls = {
+        .rate = rate,
+        .trigger = &autoset.trigger,
+        .scale = autoset.scale,
+        .persist = &persist,
+    };
+#if !STREAM_BINARY
+    controls.displays[controls.ndisplays++] = display;
+#else
+    controls.stream = &stream;
+#endif
+#if DISPLAY_LCD
+    controls.displays[controls.ndisplays++] = lcd.file;
+#endif
+    CommandParser commands;
+    rc = command_init(&commands, COMMANDS,
+                      sizeof(COMMANDS) / sizeof(COMMANDS[0]), command_reply,
+                      &controls);
+    if (rc != RC_OK) {
+        printf("error initializing commands\n");
+        handle_error();
+    }
+#endif
+#if RENDER_REPORT
+    u32 report_ms = HAL_GetTick();
+#endif
+
     usize per_buffer_sz = SZ / 2;
     while (1) {
-        toggle_led();
         if (STATE.dma_complete) {
-            u64 sum = 0;
-            for (usize i = 0; i < per_buffer_sz; ++i) {
-                sum += STATE.buf[i];
+            STATE.dma_complete = 0;
+            u16 *buf = STATE.buf;
+            pyramid_append(&history, buf, per_buffer_sz);
+#if STREAM_BINARY
+            stream_send(&stream, buf, per_buffer_sz);
+#endif
+            // align each record on the trigger, free running if none found
+            usize start;
+            if (trigger_find(&autoset.trigger, buf, per_buffer_sz - RECORD_SZ,
+                             &start) != RC_OK) {
+                start = 0;
             }
-            u16 avg = sum / per_buffer_sz;
-            double avg_voltage = adc_to_voltage(avg);
-            display_write(display, ch1_hdl, avg_voltage);
-        } else {
-            printf("not yet\n");
+            average_update(&averager, buf + start, RECORD_SZ);
+#if SERIAL_COMMANDS
+            // commands are answered later in the loop, by which time the
+            // DMA may be writing this half again
+            memcpy(MEASURED, buf, per_buffer_sz * sizeof(u16));
+            controls.last = MEASURED;
+            controls.last_sz = per_buffer_sz;
+#endif
+            average_read(&averager, AVERAGED, RECORD_SZ);
+#if MASK_TEST
+            if (STATE.capture_reference) {
+                STATE.capture_reference = 0;
+                mask_from_reference(&mask, AVERAGED, RECORD_SZ,
+                                    MASK_TOLERANCE_Y, MASK_TOLERANCE_X);
+                mask_stats_reset(&mask_stats);
+            }
+            // raw record, so averaging cannot hide a glitch
+            mask_test(&mask, buf + start, RECORD_SZ, &mask_stats);
+            if (mask_stats.acquisitions % MASK_REPORT_INTERVAL == 0) {
+                printf("mask: %lu passed, %lu failed, %llu violations\n",
+                       (unsigned long)mask_stats.passed,
+                       (unsigned long)mask_stats.failed,
+                       (unsigned long long)mask_stats.violations);
+            }
+#endif
+            // hand the result over, replacing any frame not yet drawn
+            Frame *frame = render_back(&render);
+#if DISPLAY_PERSISTENCE
+            persist_accumulate(&persist, AVERAGED, RECORD_SZ);
+            memcpy(frame->hits, persist.hits, plot_rows * plot_cols);
+#else
+            for (usize i = 0; i < plot_cols; ++i) {
+                frame->trace[i] = adc_to_voltage(AVERAGED[i]);
+            }
+#endif
+            render_publish(&render);
         }
-        HAL_Delay(500);
+
+        u32 now = HAL_GetTick();
+        if (fanout_poll(&fanout, now) == RC_OK) {
+            toggle_led();
+        }
+#if SERIAL_COMMANDS
+        // a bounded bite per pass, so a flood of input can't hold up the
+        // acquisitions waiting behind it
+        u8 input[COMMAND_READ_SZ];
+        usize got = serial_read(input, sizeof(input));
+        if (got > 0) {
+            command_feed(&commands, input, got);
+        }
+#endif
+#if RENDER_REPORT
+        if (now - report_ms >= RENDER_REPORT_INTERVAL_MS) {
+            for (usize i = 0; i < fanout.nsinks; ++i) {
+                RenderStats stats;
+                DisplayStats totals;
+                const DisplaySink *sink = fanout.sinks[i].ctx;
+                char fps[16];
+                fanout_stats(&fanout, i, &stats);
+                fmt_double(fps, sizeof(fps), stats.fps, 1);
+                // average cost of a frame on the wire since startup
+                usize per_frame = 0;
+                if (display_stats(sink->file, &totals) == RC_OK &&
+                    totals.flushes > 0) {
+                    per_frame = totals.bytes / totals.flushes;
+                }
+                printf("sink %u: %s fps, %lu drawn, %lu skipped, %lu "
+                       "bytes/frame\n",
+                       (unsigned)i, fps, (unsigned long)stats.rendered,
+                       (unsigned long)stats.dropped, (unsigned long)per_frame);
+            }
+            // share of the core's cycles spent in _write since the last report
+            SerialStats serial;
+            char busy[16];
+            serial_stats(&serial);
+            double cycles =
+                (double)(now - report_ms) * (SystemCoreClock / 1000);
+            fmt_double(busy, sizeof(busy), 100.0 * serial.write_cycles / cycles,
+                       2);
+            printf("serial: %lu bytes queued, %lu dropped, %s%% cpu in "
+                   "_write\n",
+                   (unsigned long)serial.queued, (unsigned long)serial.dropped,
+                   busy);
+            serial_reset_stats();
+#if STREAM_BINARY
+            // payload against what packing every frame would have taken
+            StreamStats *sent = &stream.stats;
+            char ratio[16];
+            fmt_double(ratio, sizeof(ratio),
+                       sent->payload_bytes
+                           ? 1.5 * sent->samples / sent->payload_bytes
+                           : 0,
+                       2);
+            printf("stream: %lu rice, %lu packed, %sx, %lu cycles/sample\n",
+                   (unsigned long)sent->rice, (unsigned long)sent->packed,
+                   ratio,
+                   (unsigned long)(sent->samples
+                                       ? STREAM_CYCLES / sent->samples
+                                       : 0));
+            stream.stats = (StreamStats){0};
+            STREAM_CYCLES = 0;
+#endif
+            report_ms = now;
+        }
+#endif
     }
 }
 
@@ -160,6 +583,8 @@ static void gpio_init(void) {
     GPIO_InitStruct.Mode = GPIO_MODE_IT_FALLING;
     GPIO_InitStruct.Pull = GPIO_NOPULL;
     HAL_GPIO_Init(B1_GPIO_Port, &GPIO_InitStruct);
+    HAL_NVIC_SetPriority(EXTI15_10_IRQn, 1, 0);
+    HAL_NVIC_EnableIRQ(EXTI15_10_IRQn);
 
     /*Configure GPIO pin : LD2_Pin */
     GPIO_InitStruct.Pin = LD2_Pin;
@@ -171,9 +596,13 @@ static void gpio_init(void) {
 
 void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc) {
     if (hadc->Instance == ADC1) {
-        if (probe_fetch(&STATE.buf, &STATE.sz) != RC_OK) {
+        u16 *buf;
+        usize sz;
+        if (probe_fetch(&buf, &sz) != RC_OK) {
             handle_error();
         } else {
+            STATE.buf = buf;
+            STATE.sz = sz;
             STATE.dma_complete = 1;
         }
     } else {
@@ -183,9 +612,13 @@ void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc) {
 
 void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef *hadc) {
     if (hadc->Instance == ADC1) {
-        if (probe_fetch(&STATE.buf, &STATE.sz) != RC_OK) {
+        u16 *buf;
+        usize sz;
+        if (probe_fetch(&buf, &sz) != RC_OK) {
             handle_error();
         } else {
+            STATE.buf = buf;
+            STATE.sz = sz;
             STATE.dma_complete = 1;
         }
     } else {
@@ -193,10 +626,202 @@ void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef *hadc) {
     }
 }
 
+static RC autoset_capture(void *ctx, u32 rate, u16 *buf, usize sz,
+                          u32 *actual_rate) {
+    if (sz > SZ / 2) {
+        return RC_BUF_LENGTH;
+    }
+    RC rc = probe_set_rate(rate, actual_rate);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    // skip the half that may have straddled the rate change
+    for (usize i = 0; i < 2; ++i) {
+        u32 start = HAL_GetTick();
+        STATE.dma_complete = 0;
+        while (!STATE.dma_complete) {
+            if (HAL_GetTick() - start > AUTOSET_TIMEOUT_MS) {
+                return RC_TIMEOUT;
+            }
+        }
+    }
+    memcpy(buf, (const u16 *)STATE.buf, sz * sizeof(u16));
+    return RC_OK;
+}
+
+static RC draw_display(void *ctx, const void *frame) {
+    const DisplaySink *sink = ctx;
+    const Frame *f = frame;
+#if HISTORY_ZOOM
+    // the history only changes in the main loop, which is also where sinks
+    // are drawn, so it can be read in place
+    (void)f;
+    return display_draw_history(sink->file, sink->hdl, sink->history,
+                                VOLTAGE_MAX / ADC_MAX);
+#elif DISPLAY_PERSISTENCE
+    Persistence view = *sink->persist;
+    view.hits = (u8 *)f->hits;
+    return display_draw_persistence(sink->file, &view);
+#else
+    // one screen width of the record per frame, sent in one write
+    return display_writev(sink->file, sink->hdl, (double *)f->trace,
+                          sink->cols);
+#endif
+}
+
+static void stream_send(StreamEncoder *enc, const u16 *buf, usize sz) {
+    // whole frames or nothing, since a partly queued frame would only fail
+    // its CRC. A compressed frame's size is only known once it's encoded,
+    // so every frame is, and one that doesn't fit has still used up its
+    // sequence number
+    u32 now = HAL_GetTick();
+    for (usize i = 0; i < sz; i += STREAM_FRAME_SAMPLES) {
+        usize n = sz - i < STREAM_FRAME_SAMPLES ? sz - i : STREAM_FRAME_SAMPLES;
+        usize len;
+        u32 start = DWT->CYCCNT;
+        RC rc = stream_encode(enc, buf + i, n, now, STREAM_FRAME,
+                              sizeof(STREAM_FRAME), &len);
+        STREAM_CYCLES += DWT->CYCCNT - start;
+        if (rc != RC_OK) {
+            stream_skip(enc);
+            continue;
+        }
+        if (serial_room() >= len) {
+            serial_write(STREAM_FRAME, len);
+        }
+    }
+}
+
+static RC set_rate(void *ctx, double rate) {
+    // the ADC restarts at the nearest rate it has, losing a buffer at most
+    Controls *controls = ctx;
+    if (rate < 1 || rate > UINT32_MAX) {
+        return RC_INVALID_OPT;
+    }
+    RC rc = probe_set_rate(rate, &controls->rate);
+    if (rc == RC_OK && controls->stream != NULL) {
+        controls->stream->sample_rate = controls->rate;
+    }
+    return rc;
+}
+
+static RC get_rate(void *ctx, char *reply, usize sz) {
+    Controls *controls = ctx;
+    return fmt_u32(reply, sz, controls->rate) ? RC_OK : RC_BUF_LENGTH;
+}
+
+static RC set_level(void *ctx, double volts) {
+    Controls *controls = ctx;
+    if (volts < 0 || volts > VOLTAGE_MAX) {
+        return RC_INVALID_OPT;
+    }
+    controls->trigger->level = volts * ADC_MAX / VOLTAGE_MAX + 0.5;
+    return RC_OK;
+}
+
+static RC get_level(void *ctx, char *reply, usize sz) {
+    Controls *controls = ctx;
+    double volts = adc_to_voltage(controls->trigger->level);
+    return fmt_double(reply, sz, volts, 3) ? RC_OK : RC_BUF_LENGTH;
+}
+
+static RC set_scale(void *ctx, double volts) {
+    Controls *controls = ctx;
+    if (volts <= 0 || volts > VOLTAGE_MAX) {
+        return RC_INVALID_OPT;
+    }
+    // hits binned at the old scale would be in the wrong rows
+    i32 range = volts * ADC_MAX / VOLTAGE_MAX;
+    RC rc = persist_set_range(controls->persist, -range, range);
+    if (rc == RC_OK) {
+        rc = persist_clear(controls->persist);
+    }
+    for (usize i = 0; rc == RC_OK && i < controls->ndisplays; ++i) {
+        rc = display_set_scale(controls->displays[i], volts);
+        if (rc == RC_OK) {
+            rc = display_redraw(controls->displays[i]);
+        }
+    }
+    if (rc == RC_OK) {
+        controls->scale = volts;
+    }
+    return rc;
+}
+
+static RC get_scale(void *ctx, char *reply, usize sz) {
+    Controls *controls = ctx;
+    return fmt_double(reply, sz, controls->scale, 3) ? RC_OK : RC_BUF_LENGTH;
+}
+
+static RC get_measurements(void *ctx, char *reply, usize sz) {
+    // min, max, mean and peak to peak in volts, then frequency in Hz
+    Controls *controls = ctx;
+    AutosetEstimate est;
+    if (controls->last == NULL) {
+        return RC_NOT_READY;
+    }
+    RC rc = autoset_estimate(controls->last, controls->last_sz, controls->rate,
+                             &est);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    double values[] = {
+        adc_to_voltage(est.min),
+        adc_to_voltage(est.max),
+        adc_to_voltage(est.mean),
+        adc_to_voltage(est.max - est.min),
+    };
+    usize len = 0;
+    for (usize i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+        usize n = fmt_double(reply + len, sz - len, values[i], 3);
+        if (n == 0 || len + n + 1 >= sz) {
+            return RC_BUF_LENGTH;
+        }
+        len += n;
+        reply[len++] = ',';
+    }
+    return fmt_double(reply + len, sz - len, est.frequency, 1) ? RC_OK
+                                                              : RC_BUF_LENGTH;
+}
+
+static RC get_identity(void *ctx, char *reply, usize sz) {
+    static const char IDENTITY[] = "STMScope,NUCLEO-F446RE,0,1";
+    if (sz < sizeof(IDENTITY)) {
+        return RC_BUF_LENGTH;
+    }
+    memcpy(reply, IDENTITY, sizeof(IDENTITY));
+    return RC_OK;
+}
+
+static void command_reply(void *ctx, const char *reply) {
+    printf("%s\n", reply);
+}
+
+void HAL_GPIO_EXTI_Callback(u16 pin) {
+    if (pin == B1_Pin) {
+        STATE.capture_reference = 1;
+    }
+}
+
 void DMA2_Stream0_IRQHandler(void) { HAL_DMA_IRQHandler(&hdma_adc1); }
 
+void DMA1_Stream4_IRQHandler(void) { HAL_DMA_IRQHandler(&hdma_spi2_tx); }
+
+void SPI2_IRQHandler(void) { HAL_SPI_IRQHandler(&hspi2); }
+
+void DMA1_Stream5_IRQHandler(void) { HAL_DMA_IRQHandler(&hdma_usart2_rx); }
+
+void DMA1_Stream6_IRQHandler(void) { HAL_DMA_IRQHandler(&hdma_usart2_tx); }
+
+void USART2_IRQHandler(void) { HAL_UART_IRQHandler(&huart2); }
+
+void EXTI15_10_IRQHandler(void) { HAL_GPIO_EXTI_IRQHandler(B1_Pin); }
+
 static void handle_error(void) {
     __disable_irq();
+    // the error's message is only queued, and with interrupts off nothing
+    // else would send it
+    serial_drain();
     while (1) {
         toggle_led();
         HAL_Delay(500);
@@ -0,0 +1,118 @@
+#include "mask.h"
+
+static RC rasterize(u16 *bound, usize sz, const MaskPoint *pts, usize npts);
+
+RC mask_init(Mask *mask, u16 *lo, u16 *hi, usize sz) {
+    if (lo == NULL || hi == NULL || sz == 0) {
+        return RC_BUF_LENGTH;
+    }
+    mask->lo = lo;
+    mask->hi = hi;
+    mask->sz = sz;
+    // start fully open so nothing fails before a mask is loaded
+    for (usize i = 0; i < sz; ++i) {
+        lo[i] = 0;
+        hi[i] = UINT16_MAX;
+    }
+    return RC_OK;
+}
+
+RC mask_from_reference(Mask *mask, const u16 *ref, usize sz, u16 tol_y,
+                       usize tol_x) {
+    if (sz > mask->sz) {
+        return RC_BUF_LENGTH;
+    }
+    for (usize i = 0; i < sz; ++i) {
+        // widen horizontally by taking the extremes within +/- tol_x
+        usize first = i > tol_x ? i - tol_x : 0;
+        usize end = i + tol_x + 1 < sz ? i + tol_x + 1 : sz;
+        u16 lo = ref[i];
+        u16 hi = ref[i];
+        for (usize j = first; j < end; ++j) {
+            lo = ref[j] < lo ? ref[j] : lo;
+            hi = ref[j] > hi ? ref[j] : hi;
+        }
+        mask->lo[i] = lo > tol_y ? lo - tol_y : 0;
+        mask->hi[i] = UINT16_MAX - hi > tol_y ? hi + tol_y : UINT16_MAX;
+    }
+    return RC_OK;
+}
+
+RC mask_from_polylines(Mask *mask, const MaskPoint *lower, usize nlower,
+                       const MaskPoint *upper, usize nupper) {
+    RC rc = rasterize(mask->lo, mask->sz, lower, nlower);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    return rasterize(mask->hi, mask->sz, upper, nupper);
+}
+
+RC mask_check(const Mask *mask, const u16 *samples, usize sz,
+              u32 *violations) {
+    if (sz > mask->sz) {
+        return RC_BUF_LENGTH;
+    }
+    const u16 *restrict lo = mask->lo;
+    const u16 *restrict hi = mask->hi;
+    u32 count = 0;
+    // comparisons produce 0/1, so there is no branch per sample
+    for (usize i = 0; i < sz; ++i) {
+        u16 x = samples[i];
+        count += (x < lo[i]) | (x > hi[i]);
+    }
+    *violations = count;
+    return RC_OK;
+}
+
+RC mask_test(const Mask *mask, const u16 *samples, usize sz,
+             MaskStats *stats) {
+    u32 violations;
+    RC rc = mask_check(mask, samples, sz, &violations);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    ++stats->acquisitions;
+    if (violations) {
+        ++stats->failed;
+    } else {
+        ++stats->passed;
+    }
+    stats->violations += violations;
+    return RC_OK;
+}
+
+RC mask_stats_reset(MaskStats *stats) {
+    stats->acquisitions = 0;
+    stats->passed = 0;
+    stats->failed = 0;
+    stats->violations = 0;
+    return RC_OK;
+}
+
+static RC rasterize(u16 *bound, usize sz, const MaskPoint *pts, usize npts) {
+    if (npts == 0) {
+        return RC_BUF_LENGTH;
+    }
+    for (usize i = 1; i < npts; ++i) {
+        if (pts[i].x < pts[i - 1].x) {
+            return RC_INVALID_OPT;
+        }
+    }
+    // linear interpolation between vertices, held flat beyond either end
+    usize seg = 0;
+    for (usize i = 0; i < sz; ++i) {
+        while (seg + 1 < npts && pts[seg + 1].x <= i) {
+            ++seg;
+        }
+        const MaskPoint *a = &pts[seg];
+        if (i <= a->x || seg + 1 == npts) {
+            bound[i] = a->y;
+            continue;
+        }
+        const MaskPoint *b = &pts[seg + 1];
+        i32 dx = b->x - a->x;
+        i32 dy = (i32)b->y - a->y;
+        bound[i] = a->y + dy * (i32)(i - a->x) / dx;
+    }
+    return RC_OK;
+}
@@ -0,0 +1,78 @@
+#include "persist.h"
+#include <string.h>
+
+#define ROW_FRAC_BITS 16
+
+RC persist_init(Persistence *persist, u8 *hits, usize rows, usize cols) {
+    if (hits == NULL || rows == 0 || cols == 0) {
+        return RC_BUF_LENGTH;
+    }
+    persist->hits = hits;
+    persist->rows = rows;
+    persist->cols = cols;
+    persist->increment = PERSIST_INCREMENT;
+    persist->decay_shift = 0;
+    persist->lo = 0;
+    persist->hi = 1;
+    return persist_clear(persist);
+}
+
+RC persist_clear(Persistence *persist) {
+    memset(persist->hits, 0, persist->rows * persist->cols);
+    return RC_OK;
+}
+
+RC persist_set_range(Persistence *persist, i32 lo, i32 hi) {
+    if (hi <= lo) {
+        return RC_INVALID_OPT;
+    }
+    persist->lo = lo;
+    persist->hi = hi;
+    return RC_OK;
+}
+
+RC persist_set_decay(Persistence *persist, u8 decay_shift) {
+    if (decay_shift >= 8) {
+        return RC_INVALID_OPT;
+    }
+    persist->decay_shift = decay_shift;
+    return RC_OK;
+}
+
+RC persist_accumulate(Persistence *persist, const u16 *samples, usize sz) {
+    if (sz == 0) {
+        return RC_BUF_LENGTH;
+    }
+    usize rows = persist->rows;
+    usize cols = persist->cols;
+    i32 hi = persist->hi;
+    i32 last_row = rows - 1;
+    // fixed-point rows per count so mapping a sample is a multiply and shift
+    i64 row_scale = ((i64)last_row << ROW_FRAC_BITS) / (hi - persist->lo);
+    u8 shift = persist->decay_shift;
+    u8 round = shift ? (1u << shift) - 1 : 0;
+    u16 increment = persist->increment;
+
+    // one pass over the grid: decay each column, then add that column's hits
+    for (usize col = 0; col < cols; ++col) {
+        u8 *column = persist->hits + col * rows;
+        if (shift) {
+            for (usize row = 0; row < rows; ++row) {
+                column[row] -= (column[row] + round) >> shift;
+            }
+        }
+        usize first = col * sz / cols;
+        usize end = (col + 1) * sz / cols;
+        if (end <= first) {
+            end = first + 1;
+        }
+        for (usize i = first; i < end; ++i) {
+            i64 offset = (i64)(hi - samples[i]) * row_scale;
+            i32 row = (offset + (1 << (ROW_FRAC_BITS - 1))) >> ROW_FRAC_BITS;
+            row = row < 0 ? 0 : row > last_row ? last_row : row;
+            u16 hits = column[row] + increment;
+            column[row] = hits > PERSIST_HITS_MAX ? PERSIST_HITS_MAX : hits;
+        }
+    }
+    return RC_OK;
+}
@@ -4,41 +4,117 @@
 ADC_HandleTypeDef hadc1;
 DMA_HandleTypeDef hdma_adc1;
 
-static RC adc_init(void);
+// conversion takes this many ADC clocks on top of the sampling time
+#define ADC_CONVERSION_CYCLES 12
+// PCLK2 / 2 would exceed the 36MHz ADC clock limit at 84MHz
+static const u32 PRESCALERS[] = {
+    ADC_CLOCK_SYNC_PCLK_DIV4,
+    ADC_CLOCK_SYNC_PCLK_DIV8,
+};
+static const u32 PRESCALER_DIVIDERS[] = {4, 8};
+static const u32 SAMPLING_TIMES[] = {
+    ADC_SAMPLETIME_3CYCLES,   ADC_SAMPLETIME_15CYCLES,
+    ADC_SAMPLETIME_28CYCLES,  ADC_SAMPLETIME_56CYCLES,
+    ADC_SAMPLETIME_84CYCLES,  ADC_SAMPLETIME_112CYCLES,
+    ADC_SAMPLETIME_144CYCLES, ADC_SAMPLETIME_480CYCLES,
+};
+static const u32 SAMPLING_CYCLES[] = {3, 15, 28, 56, 84, 112, 144, 480};
+
+#define NPRESCALERS (sizeof(PRESCALERS) / sizeof(PRESCALERS[0]))
+#define NSAMPLING_TIMES (sizeof(SAMPLING_TIMES) / sizeof(SAMPLING_TIMES[0]))
+#define NRATES (NPRESCALERS * NSAMPLING_TIMES)
+
+// every achievable continuous-mode rate, sorted fastest first
+static struct {
+    u32 rate;
+    u32 prescaler;
+    u32 sampling_time;
+} RATES[NRATES];
+static u32 RATE_VALUES[NRATES];
+
+static RC adc_init(u32 prescaler, u32 sampling_time);
 static RC dma_init(void);
+static void rates_init(void);
 
 static volatile struct {
     _Bool active_buf : 1;
     _Bool dma_complete : 1;
     volatile u16 *buf;
     usize sz_per_half;
+    usize rate_idx;
 } STATE = {
     .active_buf = 0,
     .dma_complete = 0,
     .buf = NULL,
     .sz_per_half = 0,
+    .rate_idx = 0,
 };
 
 RC probe_fetch(u16 **buf, usize *sz) {
     if (STATE.buf == NULL) {
         return RC_NOT_OPEN;
     }
-    *buf = (u16 *)STATE.buf + STATE.sz_per_half;
+    // half and full transfer callbacks alternate, starting with the first half
+    *buf = (u16 *)STATE.buf + (STATE.active_buf ? STATE.sz_per_half : 0);
+    *sz = STATE.sz_per_half;
+    STATE.active_buf = !STATE.active_buf;
     return RC_OK;
 }
 
 RC probe_init(void) {
+    rates_init();
     if (dma_init() != RC_OK) {
         return RC_OPEN_FAILED;
     }
-    if (adc_init() != RC_OK) {
+    if (adc_init(RATES[STATE.rate_idx].prescaler,
+                 RATES[STATE.rate_idx].sampling_time) != RC_OK) {
         return RC_OPEN_FAILED;
     }
     return RC_OK;
 }
 
+RC probe_rates(const u32 **rates, usize *nrates) {
+    *rates = RATE_VALUES;
+    *nrates = NRATES;
+    return RC_OK;
+}
+
+RC probe_set_rate(u32 rate, u32 *actual_rate) {
+    // closest achievable rate by ratio, since the table is roughly geometric
+    usize best = 0;
+    u64 best_err = UINT64_MAX;
+    for (usize i = 0; i < NRATES; ++i) {
+        u64 hi = RATES[i].rate > rate ? RATES[i].rate : rate;
+        u64 lo = RATES[i].rate > rate ? rate : RATES[i].rate;
+        u64 err = lo == 0 ? UINT64_MAX : (hi << 16) / lo;
+        if (err < best_err) {
+            best = i;
+            best_err = err;
+        }
+    }
+    *actual_rate = RATES[best].rate;
+    if (best == STATE.rate_idx) {
+        return RC_OK;
+    }
+
+    _Bool running = STATE.buf != NULL;
+    if (running && HAL_ADC_Stop_DMA(&hadc1) != HAL_OK) {
+        return RC_START_FAILED;
+    }
+    STATE.rate_idx = best;
+    if (adc_init(RATES[best].prescaler, RATES[best].sampling_time) !=
+        RC_OK) {
+        return RC_OPEN_FAILED;
+    }
+    if (running) {
+        return probe_start((u16 *)STATE.buf, STATE.sz_per_half << 1);
+    }
+    return RC_OK;
+}
+
 RC probe_start(u16 *buf, usize sz) {
     STATE.buf = buf;
+    STATE.active_buf = 0;
     // double buffered but uses a flat buffer, `sz` is size per buffer
     STATE.sz_per_half = sz >> 1;
     if (HAL_ADC_Start_DMA(&hadc1, (u32 *)buf, sz) != HAL_OK) {
@@ -75,11 +151,34 @@ static RC dma_init(void) {
     return RC_OK;
 }
 
-static RC adc_init() {
+static void rates_init(void) {
+    u32 pclk2 = HAL_RCC_GetPCLK2Freq();
+    usize n = 0;
+    for (usize p = 0; p < NPRESCALERS; ++p) {
+        for (usize t = 0; t < NSAMPLING_TIMES; ++t) {
+            u32 rate = pclk2 / PRESCALER_DIVIDERS[p] /
+                       (SAMPLING_CYCLES[t] + ADC_CONVERSION_CYCLES);
+            // insertion sort, fastest first
+            usize i = n++;
+            while (i > 0 && RATES[i - 1].rate < rate) {
+                RATES[i] = RATES[i - 1];
+                --i;
+            }
+            RATES[i].rate = rate;
+            RATES[i].prescaler = PRESCALERS[p];
+            RATES[i].sampling_time = SAMPLING_TIMES[t];
+        }
+    }
+    for (usize i = 0; i < NRATES; ++i) {
+        RATE_VALUES[i] = RATES[i].rate;
+    }
+}
+
+static RC adc_init(u32 prescaler, u32 sampling_time) {
     ADC_ChannelConfTypeDef sConfig = {0};
 
     hadc1.Instance = ADC1;
-    hadc1.Init.ClockPrescaler = ADC_CLOCK_SYNC_PCLK_DIV4;
+    hadc1.Init.ClockPrescaler = prescaler;
     hadc1.Init.Resolution = ADC_RESOLUTION_12B;
     hadc1.Init.ScanConvMode = DISABLE;
     hadc1.Init.ContinuousConvMode = ENABLE;
@@ -98,7 +197,7 @@ static RC adc_init() {
      * the sequencer and its sample time. */
     sConfig.Channel = ADC_CHANNEL_0;
     sConfig.Rank = 1;
-    sConfig.SamplingTime = ADC_SAMPLETIME_3CYCLES;
+    sConfig.SamplingTime = sampling_time;
     if (HAL_ADC_ConfigChannel(&hadc1, &sConfig) != HAL_OK) {
         return RC_OPEN_FAILED;
     }
@@ -0,0 +1,114 @@
+#include "pyramid.h"
+
+#define ENVELOPE_LO(word) ((u16)((word) & 0xFFFF))
+#define ENVELOPE_HI(word) ((u16)((word) >> 16))
+#define ENVELOPE_PACK(lo, hi) (((u32)(hi) << 16) | (u32)(lo))
+
+static u32 *level_base(const Pyramid *pyr, usize level);
+static u32 entry(const Pyramid *pyr, usize level, u64 idx);
+static u32 merge(u32 a, u32 b);
+
+RC pyramid_init(Pyramid *pyr, u16 *samples, u32 *levels, usize cap) {
+    if (samples == NULL || levels == NULL || cap < 2) {
+        return RC_BUF_LENGTH;
+    }
+    if (cap & (cap - 1)) {
+        return RC_INVALID_OPT;
+    }
+    pyr->samples = samples;
+    pyr->levels = levels;
+    pyr->cap = cap;
+    pyr->nlevels = 1;
+    while ((cap >> pyr->nlevels) > 0 && pyr->nlevels < PYRAMID_LEVELS_MAX) {
+        ++pyr->nlevels;
+    }
+    pyramid_reset(pyr);
+    return RC_OK;
+}
+
+void pyramid_reset(Pyramid *pyr) { pyr->count = 0; }
+
+void pyramid_append(Pyramid *pyr, const u16 *samples, usize sz) {
+    usize mask = pyr->cap - 1;
+    for (usize i = 0; i < sz; ++i) {
+        u64 n = pyr->count++;
+        pyr->samples[n & mask] = samples[i];
+        // every sample completes a pair at level 1, every other sample one
+        // at level 2 and so on, so this loop averages one iteration
+        u32 env = ENVELOPE_PACK(samples[i], samples[i]);
+        if (n & 1) {
+            env = merge(env, entry(pyr, 0, n - 1));
+        }
+        for (usize level = 1; level < pyr->nlevels && (n & 1); ++level) {
+            n >>= 1;
+            u32 *base = level_base(pyr, level);
+            base[n & ((pyr->cap >> level) - 1)] = env;
+            if (n & 1) {
+                env = merge(env, base[(n - 1) & ((pyr->cap >> level) - 1)]);
+            }
+        }
+    }
+}
+
+void pyramid_bounds(const Pyramid *pyr, u64 *first, u64 *end) {
+    *end = pyr->count;
+    *first = pyr->count > pyr->cap ? pyr->count - pyr->cap : 0;
+}
+
+RC pyramid_read(const Pyramid *pyr, u64 start, u64 span, u16 *lo, u16 *hi,
+                usize cols) {
+    u64 first, end;
+    pyramid_bounds(pyr, &first, &end);
+    if (cols == 0 || span < cols) {
+        return RC_INVALID_OPT;
+    }
+    if (start < first || start + span > end) {
+        return RC_BUF_LENGTH;
+    }
+    // coarsest level whose entries still fit inside a column
+    u64 per_col = span / cols;
+    usize level = 0;
+    while (level + 1 < pyr->nlevels && (2ull << level) <= per_col) {
+        ++level;
+    }
+    for (usize col = 0; col < cols; ++col) {
+        u64 a = start + span * col / cols;
+        u64 b = start + span * (col + 1) / cols;
+        u32 env = entry(pyr, level, a >> level);
+        for (u64 idx = (a >> level) + 1; idx <= (b - 1) >> level; ++idx) {
+            env = merge(env, entry(pyr, level, idx));
+        }
+        lo[col] = ENVELOPE_LO(env);
+        hi[col] = ENVELOPE_HI(env);
+    }
+    return RC_OK;
+}
+
+static u32 *level_base(const Pyramid *pyr, usize level) {
+    // level 1 starts at 0, and each level is cap >> level entries long
+    return pyr->levels + (pyr->cap - (pyr->cap >> (level - 1)));
+}
+
+static u32 entry(const Pyramid *pyr, usize level, u64 idx) {
+    if (level == 0) {
+        u16 x = pyr->samples[idx & (pyr->cap - 1)];
+        return ENVELOPE_PACK(x, x);
+    }
+    // the newest entry of a level may still be waiting on its second half,
+    // so build it from whatever the level below has
+    u64 width = 1ull << level;
+    if ((idx + 1) * width > pyr->count) {
+        u32 env = entry(pyr, level - 1, 2 * idx);
+        if ((2 * idx + 1) * (width >> 1) < pyr->count) {
+            env = merge(env, entry(pyr, level - 1, 2 * idx + 1));
+        }
+        return env;
+    }
+    return level_base(pyr, level)[idx & ((pyr->cap >> level) - 1)];
+}
+
+static u32 merge(u32 a, u32 b) {
+    u16 lo = ENVELOPE_LO(a) < ENVELOPE_LO(b) ? ENVELOPE_LO(a) : ENVELOPE_LO(b);
+    u16 hi = ENVELOPE_HI(a) > ENVELOPE_HI(b) ? ENVELOPE_HI(a) : ENVELOPE_HI(b);
+    return ENVELOPE_PACK(lo, hi);
+}
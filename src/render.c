@@ -0,0 +1,117 @@
+#include "render.h"
+
+// state word layout: two bits per slot role and a flag set while the ready
+// slot holds a frame the renderer hasn't taken yet
+#define SLOT_BACK(state) ((state) & 3)
+#define SLOT_READY(state) (((state) >> 2) & 3)
+#define SLOT_FRONT(state) (((state) >> 4) & 3)
+#define STATE_FRESH (1u << 6)
+#define STATE_PACK(back, ready, front) ((back) | (ready) << 2 | (front) << 4)
+
+static u32 swap_state(RenderScheduler *sched, _Bool publish);
+
+RC render_init(RenderScheduler *sched, void *slots, usize slot_sz, u32 fps) {
+    if (slots == NULL || slot_sz == 0) {
+        return RC_BUF_LENGTH;
+    }
+    sched->slots = slots;
+    sched->slot_sz = slot_sz;
+    sched->state = STATE_PACK(0, 1, 2);
+    sched->stats = (RenderStats){0};
+    return render_pacer_init(&sched->pacer, fps);
+}
+
+RC render_set_fps(RenderScheduler *sched, u32 fps) {
+    return render_pacer_init(&sched->pacer, fps);
+}
+
+void *render_back(RenderScheduler *sched) {
+    return sched->slots + SLOT_BACK(sched->state) * sched->slot_sz;
+}
+
+void render_publish(RenderScheduler *sched) {
+    u32 old = swap_state(sched, 1);
+    ++sched->stats.published;
+    if (old & STATE_FRESH) {
+        ++sched->stats.dropped;
+    }
+}
+
+RC render_take(RenderScheduler *sched, u32 now_ms, void **frame) {
+    render_pacer_update(&sched->pacer, now_ms);
+    sched->stats.fps = sched->pacer.effective_fps;
+    if (!render_pacer_due(&sched->pacer, now_ms) ||
+        !(sched->state & STATE_FRESH)) {
+        return RC_NOT_READY;
+    }
+    u32 state = swap_state(sched, 0);
+    *frame = sched->slots + SLOT_READY(state) * sched->slot_sz;
+    render_pacer_tick(&sched->pacer, now_ms);
+    ++sched->stats.rendered;
+    return RC_OK;
+}
+
+void render_stats(const RenderScheduler *sched, RenderStats *stats) {
+    *stats = sched->stats;
+}
+
+RC render_pacer_init(RenderPacer *pacer, u32 fps) {
+    if (fps > RENDER_FPS_MAX) {
+        return RC_INVALID_OPT;
+    }
+    pacer->fps = fps;
+    pacer->interval_ms = fps ? 1000 / fps : 0;
+    pacer->remainder = 0;
+    pacer->next_ms = 0;
+    pacer->window_start_ms = 0;
+    pacer->window_count = 0;
+    pacer->effective_fps = 0;
+    return RC_OK;
+}
+
+void render_pacer_update(RenderPacer *pacer, u32 now_ms) {
+    u32 elapsed = now_ms - pacer->window_start_ms;
+    if (elapsed >= RENDER_FPS_WINDOW_MS) {
+        pacer->effective_fps = pacer->window_count * 1000.0 / elapsed;
+        pacer->window_start_ms = now_ms;
+        pacer->window_count = 0;
+    }
+}
+
+_Bool render_pacer_due(const RenderPacer *pacer, u32 now_ms) {
+    // wrap safe comparison against the tick counter
+    return (i32)(now_ms - pacer->next_ms) >= 0;
+}
+
+void render_pacer_tick(RenderPacer *pacer, u32 now_ms) {
+    // keep a fixed cadence, but don't try to catch up after a stall
+    pacer->next_ms += pacer->interval_ms;
+    if (pacer->fps) {
+        pacer->remainder += 1000 % pacer->fps;
+        if (pacer->remainder >= pacer->fps) {
+            pacer->remainder -= pacer->fps;
+            ++pacer->next_ms;
+        }
+    }
+    if ((i32)(now_ms - pacer->next_ms) >= 0) {
+        pacer->next_ms = now_ms + pacer->interval_ms;
+    }
+    ++pacer->window_count;
+}
+
+static u32 swap_state(RenderScheduler *sched, _Bool publish) {
+    // publishing swaps back and ready and marks the frame fresh, taking
+    // swaps ready and front and clears it. Returns the state before the swap
+    u32 old = __atomic_load_n(&sched->state, __ATOMIC_ACQUIRE);
+    u32 new;
+    do {
+        u32 back = SLOT_BACK(old);
+        u32 ready = SLOT_READY(old);
+        u32 front = SLOT_FRONT(old);
+        new = publish ? STATE_PACK(ready, back, front) | STATE_FRESH
+                      : STATE_PACK(back, front, ready);
+    } while (!__atomic_compare_exchange_n(&sched->state, &old, new, 1,
+                                          __ATOMIC_ACQ_REL,
+                                          __ATOMIC_ACQUIRE));
+    return old;
+}
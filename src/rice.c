@@ -0,0 +1,187 @@
+#include "rice.h"
+
+#define SAMPLE_MAX 0xFFF
+
+typedef struct {
+    u8 *out;
+    usize sz;
+    usize at;
+    // bits not yet written out, the newest in the low `bits` bits
+    u32 acc;
+    u32 bits;
+    _Bool full;
+} BitWriter;
+
+typedef struct {
+    const u8 *in;
+    usize sz;
+    usize at;
+    u32 acc;
+    u32 bits;
+    _Bool empty;
+} BitReader;
+
+static usize choose_order(const u16 *samples, usize n);
+static i32 predict(const u16 *samples, usize i, usize order);
+static u32 rice_param(u32 sum, usize n);
+static void put_bits(BitWriter *w, u32 value, u32 n);
+static void put_rice(BitWriter *w, u32 u, u32 k);
+static u32 get_bits(BitReader *r, u32 n);
+static u32 get_rice(BitReader *r, u32 k);
+
+RC rice_encode(const u16 *samples, usize n, u8 *out, usize sz, usize *len) {
+    if (n == 0) {
+        return RC_INVALID_OPT;
+    }
+    BitWriter w = {.out = out, .sz = sz};
+    usize order = choose_order(samples, n);
+    put_bits(&w, order, 2);
+    for (usize i = 0; i < order && i < n; ++i) {
+        put_bits(&w, samples[i] & SAMPLE_MAX, 12);
+    }
+
+    // residuals are mapped a partition at a time, since k depends on them all
+    u16 res[RICE_PARTITION];
+    for (usize i = order; i < n && !w.full; i += RICE_PARTITION) {
+        usize m = n - i < RICE_PARTITION ? n - i : RICE_PARTITION;
+        // a step leaves one or two huge residuals that would drag k up for
+        // the whole partition, so the largest two are left out of the mean
+        // and escaped instead
+        u32 sum = 0, top[2] = {0, 0};
+        for (usize j = 0; j < m; ++j) {
+            i32 d = (samples[i + j] & SAMPLE_MAX) - predict(samples, i + j,
+                                                            order);
+            u32 u = d < 0 ? -2 * d - 1 : 2 * d;
+            res[j] = u;
+            sum += u;
+            if (u > top[1]) {
+                top[1] = u > top[0] ? top[0] : u;
+                top[0] = u > top[0] ? u : top[0];
+            }
+        }
+        u32 k = m > 2 ? rice_param(sum - top[0] - top[1], m - 2)
+                      : rice_param(sum, m);
+        put_bits(&w, k, 4);
+        for (usize j = 0; j < m; ++j) {
+            put_rice(&w, res[j], k);
+        }
+    }
+    if (w.bits > 0 && !w.full) {
+        put_bits(&w, 0, 8 - w.bits);
+    }
+    if (w.full) {
+        return RC_BUF_LENGTH;
+    }
+    *len = w.at;
+    return RC_OK;
+}
+
+RC rice_decode(const u8 *in, usize sz, usize n, u16 *samples) {
+    BitReader r = {.in = in, .sz = sz};
+    usize order = get_bits(&r, 2);
+    if (order != 1 && order != 2) {
+        return RC_INVALID_OPT;
+    }
+    for (usize i = 0; i < order && i < n; ++i) {
+        samples[i] = get_bits(&r, 12);
+    }
+    for (usize i = order; i < n && !r.empty; i += RICE_PARTITION) {
+        usize m = n - i < RICE_PARTITION ? n - i : RICE_PARTITION;
+        u32 k = get_bits(&r, 4);
+        if (k > RICE_K_MAX) {
+            return RC_INVALID_OPT;
+        }
+        for (usize j = i; j < i + m; ++j) {
+            u32 u = get_rice(&r, k);
+            i32 d = u & 1 ? -(i32)(u >> 1) - 1 : (i32)(u >> 1);
+            i32 sample = predict(samples, j, order) + d;
+            if (sample < 0 || sample > SAMPLE_MAX) {
+                return RC_INVALID_OPT;
+            }
+            samples[j] = sample;
+        }
+    }
+    return r.empty ? RC_BUF_LENGTH : RC_OK;
+}
+
+static usize choose_order(const u16 *samples, usize n) {
+    // whichever order leaves the smaller residuals overall, which tracks
+    // the coded size closely enough and costs one pass
+    u32 sum1 = 0, sum2 = 0;
+    for (usize i = 2; i < n; ++i) {
+        i32 d1 = (samples[i] & SAMPLE_MAX) - predict(samples, i, 1);
+        i32 d2 = (samples[i] & SAMPLE_MAX) - predict(samples, i, 2);
+        sum1 += d1 < 0 ? -d1 : d1;
+        sum2 += d2 < 0 ? -d2 : d2;
+    }
+    return sum2 < sum1 ? 2 : 1;
+}
+
+static i32 predict(const u16 *samples, usize i, usize order) {
+    i32 prev = samples[i - 1] & SAMPLE_MAX;
+    if (order == 1) {
+        return prev;
+    }
+    return 2 * prev - (samples[i - 2] & SAMPLE_MAX);
+}
+
+static u32 rice_param(u32 sum, usize n) {
+    // the k with 2^k <= mean < 2^(k + 1), close to the best for residuals
+    // that fall off geometrically
+    u32 k = 0;
+    while (k < RICE_K_MAX && (u32)n << (k + 1) <= sum) {
+        ++k;
+    }
+    return k;
+}
+
+static void put_bits(BitWriter *w, u32 value, u32 n) {
+    // n is at most 16, so with up to 7 bits left over the accumulator
+    // never holds more than 23
+    w->acc = w->acc << n | value;
+    w->bits += n;
+    while (w->bits >= 8 && !w->full) {
+        if (w->at == w->sz) {
+            w->full = 1;
+            return;
+        }
+        w->bits -= 8;
+        w->out[w->at++] = w->acc >> w->bits;
+    }
+}
+
+static void put_rice(BitWriter *w, u32 u, u32 k) {
+    u32 q = u >> k;
+    if (q >= RICE_ESCAPE) {
+        put_bits(w, (1u << RICE_ESCAPE) - 1, RICE_ESCAPE);
+        put_bits(w, u, RICE_RAW_BITS);
+        return;
+    }
+    // q ones and the zero ending them
+    put_bits(w, (1u << (q + 1)) - 2, q + 1);
+    put_bits(w, u & ((1u << k) - 1), k);
+}
+
+static u32 get_bits(BitReader *r, u32 n) {
+    while (r->bits < n) {
+        if (r->at == r->sz) {
+            r->empty = 1;
+            return 0;
+        }
+        r->acc = r->acc << 8 | r->in[r->at++];
+        r->bits += 8;
+    }
+    r->bits -= n;
+    return r->acc >> r->bits & ((1u << n) - 1);
+}
+
+static u32 get_rice(BitReader *r, u32 k) {
+    u32 q = 0;
+    while (q < RICE_ESCAPE && get_bits(r, 1)) {
+        ++q;
+    }
+    if (q == RICE_ESCAPE) {
+        return get_bits(r, RICE_RAW_BITS);
+    }
+    return q << k | get_bits(r, k);
+}
@@ -1,28 +1,429 @@
 #include "serial.h"
-#include "stm32f4xx_hal.h"
+#include <string.h>
 
-static UART_HandleTypeDef huart2;
+// 0 sends with a blocking HAL_UART_Transmit instead of the ring, to compare
+// the time spent in _write
+#define SERIAL_TX_DMA 1
+// a full ring takes about 180ms to drain at 115200 baud
+#define SERIAL_FLUSH_TIMEOUT_MS 1000
+#define SERIAL_DRAIN_TIMEOUT_CYCLES                                            \
+    (SystemCoreClock / 1000 * SERIAL_FLUSH_TIMEOUT_MS)
+// errors that end reception, a DMA error only when it was the receive's
+#define SERIAL_RX_ERRORS                                                       \
+    (HAL_UART_ERROR_PE | HAL_UART_ERROR_NE | HAL_UART_ERROR_FE |              \
+     HAL_UART_ERROR_ORE | HAL_UART_ERROR_DMA)
 
-static RC uart2_init(void);
+UART_HandleTypeDef huart2;
+DMA_HandleTypeDef hdma_usart2_tx;
+DMA_HandleTypeDef hdma_usart2_rx;
 
-RC serial_init() { return uart2_init(); }
+// byte counts since init, reduced modulo SERIAL_TX_SZ to index the ring.
+// [sent, next) is being sent and [next, head) is queued behind it
+static u8 TX_RING[SERIAL_TX_SZ];
+static volatile struct {
+    u32 head;
+    u32 next;
+    u32 sent;
+    _Bool busy;
+    SerialFullPolicy policy;
+} TX;
+// written by the DMA. `received` counts the bytes it has reported and
+// `read` those handed out, `pos` is where in the ring it had got to
+static u8 RX_RING[SERIAL_RX_SZ];
+static volatile struct {
+    u32 received;
+    u32 read;
+    u16 pos;
+} RX;
+static SerialStats STATS;
 
-static RC uart2_init(void) {
+static RC uart2_init(u32 baud);
+static RC dma_init(void);
+static RC rx_dma_init(void);
+static void rx_start(void);
+static void cycle_counter_init(void);
+static void tx_lock(void);
+static void tx_unlock(void);
+static usize tx_enqueue(const u8 *bytes, usize sz);
+static usize tx_make_room(usize sz);
+static void tx_start(void);
+static _Bool tx_wait_flag(u32 flag, u32 start);
+static void ring_move(u32 dst, u32 src, usize n);
+
+RC serial_init() {
+    cycle_counter_init();
+    TX.head = TX.next = TX.sent = 0;
+    TX.busy = 0;
+    TX.policy = SERIAL_FULL_BLOCK;
+    serial_reset_stats();
+    if (dma_init() != RC_OK || rx_dma_init() != RC_OK) {
+        return RC_OPEN_FAILED;
+    }
+    RC rc = uart2_init(115200);
+    if (rc == RC_OK) {
+        rx_start();
+    }
+    return rc;
+}
+
+RC serial_set_full_policy(SerialFullPolicy policy) {
+    if (policy != SERIAL_FULL_BLOCK && policy != SERIAL_FULL_DROP &&
+        policy != SERIAL_FULL_OVERWRITE) {
+        return RC_INVALID_OPT;
+    }
+    TX.policy = policy;
+    return RC_OK;
+}
+
+RC serial_set_baud(u32 baud) {
+    u32 pclk1 = HAL_RCC_GetPCLK1Freq();
+    if (baud == 0 || baud > pclk1 / 8) {
+        return RC_INVALID_OPT;
+    }
+    RC rc = serial_flush();
+    if (rc != RC_OK) {
+        return rc;
+    }
+    HAL_UART_AbortReceive(&huart2);
+    rc = uart2_init(baud);
+    if (rc == RC_OK) {
+        rx_start();
+    }
+    return rc;
+}
+
+usize serial_room(void) { return SERIAL_TX_SZ - (TX.head - TX.sent); }
+
+RC serial_flush(void) {
+    u32 start = HAL_GetTick();
+    while (TX.sent != TX.head || TX.busy) {
+        if (HAL_GetTick() - start > SERIAL_FLUSH_TIMEOUT_MS) {
+            return RC_TIMEOUT;
+        }
+        // bytes put back by a transfer error or a failed start wait for
+        // the next write, which may never come, so send them from here
+        if (!TX.busy) {
+            tx_lock();
+            tx_start();
+            tx_unlock();
+        }
+    }
+    return RC_OK;
+}
+
+void serial_drain(void) {
+    u32 start = DWT->CYCCNT;
+    if (TX.busy) {
+        // let the transfer under way run out, or stop it if it doesn't, and
+        // carry on from the first byte it didn't take from the ring
+        while ((hdma_usart2_tx.Instance->CR & DMA_SxCR_EN) &&
+               DWT->CYCCNT - start < SERIAL_DRAIN_TIMEOUT_CYCLES) {
+        }
+        HAL_UART_AbortTransmit(&huart2);
+        TX.sent = TX.next - __HAL_DMA_GET_COUNTER(&hdma_usart2_tx);
+        TX.busy = 0;
+    } else if (TX.sent == TX.head) {
+        // nothing queued, and on an error from serial_init the UART may not
+        // even be up
+        return;
+    }
+    while (TX.sent != TX.head) {
+        if (!tx_wait_flag(UART_FLAG_TXE, start)) {
+            return;
+        }
+        huart2.Instance->DR = TX_RING[TX.sent % SERIAL_TX_SZ];
+        TX.sent = TX.sent + 1;
+    }
+    TX.next = TX.sent;
+    tx_wait_flag(UART_FLAG_TC, start);
+}
+
+usize serial_read(u8 *bytes, usize sz) {
+    // the DMA may already be up to half a ring past `received`, over the
+    // oldest half, so anything older than the newest half is given up on
+    u32 received = RX.received;
+    u32 unread = received - RX.read;
+    if (unread > SERIAL_RX_SZ / 2) {
+        STATS.overrun += unread - SERIAL_RX_SZ / 2;
+        RX.read = received - SERIAL_RX_SZ / 2;
+        unread = SERIAL_RX_SZ / 2;
+    }
+    usize n = unread < sz ? unread : sz;
+    for (usize i = 0; i < n; ++i) {
+        bytes[i] = RX_RING[(RX.read + i) % SERIAL_RX_SZ];
+    }
+    RX.read += n;
+    STATS.received += n;
+    return n;
+}
+
+void serial_stats(SerialStats *stats) { *stats = STATS; }
+
+void serial_reset_stats(void) { STATS = (SerialStats){0}; }
+
+static RC uart2_init(u32 baud) {
     huart2.Instance = USART2;
-    huart2.Init.BaudRate = 115200;
+    huart2.Init.BaudRate = baud;
     huart2.Init.WordLength = UART_WORDLENGTH_8B;
     huart2.Init.StopBits = UART_STOPBITS_1;
     huart2.Init.Parity = UART_PARITY_NONE;
     huart2.Init.Mode = UART_MODE_TX_RX;
     huart2.Init.HwFlowCtl = UART_HWCONTROL_NONE;
-    huart2.Init.OverSampling = UART_OVERSAMPLING_16;
+    // 16x oversampling tolerates more clock error, so only drop to 8x when
+    // the rate needs it
+    huart2.Init.OverSampling = baud > HAL_RCC_GetPCLK1Freq() / 16
+                                   ? UART_OVERSAMPLING_8
+                                   : UART_OVERSAMPLING_16;
     if (HAL_UART_Init(&huart2) != HAL_OK) {
         return RC_OPEN_FAILED;
     }
+    // a transfer ends on transmission complete, raised by USART2 itself
+    HAL_NVIC_SetPriority(USART2_IRQn, 3, 0);
+    HAL_NVIC_EnableIRQ(USART2_IRQn);
+    return RC_OK;
+}
+
+static RC dma_init(void) {
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    hdma_usart2_tx.Instance = DMA1_Stream6;
+    hdma_usart2_tx.Init.Channel = DMA_CHANNEL_4;
+    hdma_usart2_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    hdma_usart2_tx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_usart2_tx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_usart2_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_usart2_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_usart2_tx.Init.Mode = DMA_NORMAL;
+    hdma_usart2_tx.Init.Priority = DMA_PRIORITY_LOW;
+    hdma_usart2_tx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    if (HAL_DMA_Init(&hdma_usart2_tx) != HAL_OK) {
+        return RC_OPEN_FAILED;
+    }
+    __HAL_LINKDMA(&huart2, hdmatx, hdma_usart2_tx);
+
+    // output is the least urgent thing on the board
+    HAL_NVIC_SetPriority(DMA1_Stream6_IRQn, 3, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Stream6_IRQn);
     return RC_OK;
 }
 
+static RC rx_dma_init(void) {
+    hdma_usart2_rx.Instance = DMA1_Stream5;
+    hdma_usart2_rx.Init.Channel = DMA_CHANNEL_4;
+    hdma_usart2_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma_usart2_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_usart2_rx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_usart2_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_usart2_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_usart2_rx.Init.Mode = DMA_CIRCULAR;
+    hdma_usart2_rx.Init.Priority = DMA_PRIORITY_LOW;
+    hdma_usart2_rx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    if (HAL_DMA_Init(&hdma_usart2_rx) != HAL_OK) {
+        return RC_OPEN_FAILED;
+    }
+    __HAL_LINKDMA(&huart2, hdmarx, hdma_usart2_rx);
+
+    HAL_NVIC_SetPriority(DMA1_Stream5_IRQn, 3, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Stream5_IRQn);
+    return RC_OK;
+}
+
+static void rx_start(void) {
+    // a failure leaves input off, output carries on regardless. The counts
+    // are left alone too, since a reception that refused to start may still
+    // be running
+    if (HAL_UARTEx_ReceiveToIdle_DMA(&huart2, RX_RING, SERIAL_RX_SZ) !=
+        HAL_OK) {
+        return;
+    }
+    // the DMA starts again at the front of the ring, so the counts move on
+    // to match, giving up anything unread
+    u32 start = (RX.received + SERIAL_RX_SZ - 1) / SERIAL_RX_SZ * SERIAL_RX_SZ;
+    RX.received = RX.read = start;
+    RX.pos = 0;
+}
+
+static void cycle_counter_init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
 int _write(int file, char *ptr, int len) {
-    HAL_UART_Transmit(&huart2, (uint8_t *)ptr, len, HAL_MAX_DELAY);
+    serial_write((const u8 *)ptr, len);
     return len;
 }
+
+void serial_write(const u8 *bytes, usize sz) {
+    u32 start = DWT->CYCCNT;
+#if SERIAL_TX_DMA
+    usize left = sz;
+    while (left > 0) {
+        usize n = tx_enqueue(bytes, left);
+        bytes += n;
+        left -= n;
+        if (left == 0) {
+            break;
+        }
+        if (TX.policy == SERIAL_FULL_DROP) {
+            STATS.dropped += left;
+            break;
+        }
+        if (TX.policy == SERIAL_FULL_OVERWRITE) {
+            // at most a chunk is ever being sent, so only the newest output
+            // that fits in the rest of the ring can be kept
+            usize room = SERIAL_TX_SZ - SERIAL_TX_CHUNK;
+            if (left > room) {
+                STATS.dropped += left - room;
+                bytes += left - room;
+                left = room;
+            }
+            STATS.dropped += tx_make_room(left);
+            continue;
+        }
+        // blocking: transfers free up room as they complete, unless
+        // interrupts are masked and they can't, when waiting would hang
+        if (__get_PRIMASK()) {
+            STATS.dropped += left;
+            break;
+        }
+    }
+#else
+    HAL_UART_Transmit(&huart2, (uint8_t *)bytes, sz, HAL_MAX_DELAY);
+    STATS.queued += sz;
+#endif
+    STATS.write_cycles += DWT->CYCCNT - start;
+}
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart) {
+    if (huart->Instance == USART2) {
+        TX.sent = TX.next;
+        TX.busy = 0;
+        tx_start();
+    }
+}
+
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, u16 pos) {
+    if (huart->Instance != USART2) {
+        return;
+    }
+    // `pos` is how far into the ring the DMA is, SERIAL_RX_SZ once it fills.
+    // Half transfer is reported too, so it never laps the last position
+    RX.received += (pos + SERIAL_RX_SZ - RX.pos) % SERIAL_RX_SZ;
+    RX.pos = pos % SERIAL_RX_SZ;
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart) {
+    if (huart->Instance != USART2) {
+        return;
+    }
+    // a DMA error ends a transfer without TxCpltCallback, from the DMA
+    // stream's interrupt rather than USART2's. Its bytes go back on the
+    // queue for the next write or serial_flush to send, rather than
+    // retrying from the interrupt
+    if (TX.busy && huart->gState == HAL_UART_STATE_READY) {
+        TX.next = TX.sent;
+        TX.busy = 0;
+    }
+    // noise, framing, overrun and receive DMA errors stop reception, so pick
+    // it back up. The callback also comes for transmit errors, when
+    // reception is still running and must be left alone
+    if (huart->RxState == HAL_UART_STATE_READY &&
+        (huart->ErrorCode & SERIAL_RX_ERRORS)) {
+        ++STATS.rx_errors;
+        rx_start();
+    }
+}
+
+static void tx_lock(void) {
+    // besides here, the transfer state is changed by TxCpltCallback from
+    // the USART2 interrupt and by ErrorCallback from either USART2 DMA
+    // stream's. Masking just those leaves the ADC and LCD interrupts running
+    HAL_NVIC_DisableIRQ(USART2_IRQn);
+    HAL_NVIC_DisableIRQ(DMA1_Stream6_IRQn);
+    HAL_NVIC_DisableIRQ(DMA1_Stream5_IRQn);
+}
+
+static void tx_unlock(void) {
+    HAL_NVIC_EnableIRQ(DMA1_Stream5_IRQn);
+    HAL_NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+    HAL_NVIC_EnableIRQ(USART2_IRQn);
+}
+
+static usize tx_enqueue(const u8 *bytes, usize sz) {
+    // the free space is never read by a transfer, so it is filled without
+    // the lock. `sent` only moves forward, so a stale value just
+    // underestimates the room
+    u32 head = TX.head;
+    usize room = SERIAL_TX_SZ - (head - TX.sent);
+    usize n = sz < room ? sz : room;
+    usize at = head % SERIAL_TX_SZ;
+    usize first = n < SERIAL_TX_SZ - at ? n : SERIAL_TX_SZ - at;
+    memcpy(TX_RING + at, bytes, first);
+    memcpy(TX_RING, bytes + first, n - first);
+
+    tx_lock();
+    TX.head = head + n;
+    tx_start();
+    tx_unlock();
+    STATS.queued += n;
+    return n;
+}
+
+static usize tx_make_room(usize sz) {
+    // drop the oldest queued bytes by moving the rest back over them. The
+    // ones being sent are left alone, so this frees at most what's queued
+    tx_lock();
+    usize room = SERIAL_TX_SZ - (TX.head - TX.sent);
+    usize queued = TX.head - TX.next;
+    usize n = sz > room ? sz - room : 0;
+    n = n < queued ? n : queued;
+    ring_move(TX.next, TX.next + n, queued - n);
+    TX.head -= n;
+    tx_unlock();
+    return n;
+}
+
+static void tx_start(void) {
+    // called with the lock held or from the interrupt. Sends the oldest
+    // queued run up to the end of the ring or a chunk, whichever is first
+    if (TX.busy || TX.head == TX.next) {
+        return;
+    }
+    usize at = TX.next % SERIAL_TX_SZ;
+    usize n = TX.head - TX.next;
+    n = n < SERIAL_TX_SZ - at ? n : SERIAL_TX_SZ - at;
+    n = n < SERIAL_TX_CHUNK ? n : SERIAL_TX_CHUNK;
+    if (HAL_UART_Transmit_DMA(&huart2, TX_RING + at, n) != HAL_OK) {
+        // left queued for the next write to try again
+        return;
+    }
+    TX.busy = 1;
+    TX.next += n;
+    ++STATS.transfers;
+}
+
+static _Bool tx_wait_flag(u32 flag, u32 start) {
+    while (!__HAL_UART_GET_FLAG(&huart2, flag)) {
+        if (DWT->CYCCNT - start > SERIAL_DRAIN_TIMEOUT_CYCLES) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void ring_move(u32 dst, u32 src, usize n) {
+    // copy forward in pieces that wrap neither index. `dst` is behind
+    // `src`, so going forward never overwrites bytes still to be copied
+    while (n > 0) {
+        usize d = dst % SERIAL_TX_SZ;
+        usize s = src % SERIAL_TX_SZ;
+        usize piece = n;
+        piece = piece < SERIAL_TX_SZ - d ? piece : SERIAL_TX_SZ - d;
+        piece = piece < SERIAL_TX_SZ - s ? piece : SERIAL_TX_SZ - s;
+        memmove(TX_RING + d, TX_RING + s, piece);
+        dst += piece;
+        src += piece;
+        n -= piece;
+    }
+}
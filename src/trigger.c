@@ -0,0 +1,22 @@
+#include "trigger.h"
+
+RC trigger_find(const Trigger *trig, const u16 *samples, usize sz,
+                usize *idx) {
+    _Bool armed = 0;
+    i32 level = trig->level;
+    i32 hysteresis = trig->hysteresis;
+    for (usize i = 0; i < sz; ++i) {
+        i32 x = samples[i];
+        // flip falling edges so one comparison path handles both
+        if (trig->edge == TRIGGER_FALLING) {
+            x = 2 * level - x;
+        }
+        if (x < level - hysteresis) {
+            armed = 1;
+        } else if (armed && x >= level) {
+            *idx = i;
+            return RC_OK;
+        }
+    }
+    return RC_NO_TRIGGER;
+}